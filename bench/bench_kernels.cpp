@@ -0,0 +1,158 @@
+/**
+ * @file bench_kernels.cpp
+ * @brief Замер пропускной способности ядер редукции
+ *
+ * @details Для каждой реализации, поддерживаемой процессором, измеряется
+ * скорость на массиве, умещающемся в L1 (чистые вычисления), и на большом
+ * массиве (упор в пропускную способность памяти). Для сравнения замеряется
+ * прежний последовательный цикл с одним аккумулятором.
+ *
+ * Режимы накопления (float, double, kahan, pairwise) замеряются так же,
+ * как их считает сервер - блоками SQUARE_BLOCK, - вместе с относительной
+ * ошибкой на большом массиве.
+ *
+ * Совместная редукция операций (ops.hpp) замеряется для нескольких
+ * наборов операций на каждой реализации; для сравнения тот же набор
+ * mean+variance+max считается тремя отдельными проходами. Для каждого
+ * типа элементов на проводе замеряется сумма квадратов в миллиардах
+ * элементов в секунду: узкие типы дают больше элементов на байт сети.
+ *
+ * Затем большой массив считается блочной редукцией ChunkedSum на пулах
+ * разного размера (по умолчанию 1, 2, 4 ... до числа ядер) - так видно
+ * масштабирование и то, что результат от числа потоков не зависит.
+ *
+ * Пример: ./bench/bench_kernels
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include "../kernels.hpp"
+#include "../pool.hpp"
+#include "../reduction.hpp"
+#include "../ops.hpp"
+
+using namespace std;
+
+/// Прежний цикл сервера: один аккумулятор, последовательное сложение
+__attribute__((noinline))
+static float serialLoop(const float *x, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; i++) sum += x[i] * x[i];
+    return sum;
+}
+
+/**
+ * @brief Прогоняет ядро над массивом, пока не наберётся около 0.3 с
+ * @return Пропускная способность в ГБ/с
+ */
+template<class Fn>
+static double measure(Fn fn, const vector<float> &data) {
+    volatile double sink = 0.0;
+    size_t reps = 0;
+    auto start = chrono::steady_clock::now();
+    double secs;
+    do {
+        for (int r = 0; r < 16; r++) sink = sink + fn(data.data(), data.size());
+        reps += 16;
+        secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (secs < 0.3);
+    return reps * data.size() * sizeof(float) / secs / 1e9;
+}
+
+int main() {
+    vector<float> small(4 * 1024), large(32 * 1024 * 1024);
+    for (size_t i = 0; i < small.size(); i++) small[i] = sin(i * 0.1f);
+    for (size_t i = 0; i < large.size(); i++) large[i] = sin(i * 0.1f);
+
+    cout << "Выбрана реализация: " << sumOfSquaresImpl() << endl;
+    cout << "ядро, ГБ/с: L1 (16 КиБ) / память (128 МиБ)" << endl;
+
+    cout << left << fixed << setprecision(2);
+    cout << setw(12) << "serial" << setw(10) << measure(serialLoop, small) << measure(serialLoop, large) << endl;
+    for (const auto &k : sumOfSquaresKernels()) {
+        if (!k.supported()) continue;
+        cout << setw(12) << k.name << setw(10) << measure(k.fn, small) << measure(k.fn, large) << endl;
+    }
+
+    cout << endl << "режим, ГБ/с: L1 / память, относительная ошибка" << endl;
+    // Эталон: компенсированная сумма в long double (простая сумма long
+    // double на 32М слагаемых сама ошибается на ~1e-14)
+    long double exact = 0.0L, comp = 0.0L;
+    for (float v : large) {
+        long double y = (long double)v * v, t = exact + y;
+        comp += fabsl(exact) >= fabsl(y) ? (exact - t) + y : (y - t) + exact;
+        exact = t;
+    }
+    exact += comp;
+    for (unsigned m = 0; m < ACCUM_MODES; m++) {
+        AccumMode mode = (AccumMode)m;
+        auto fn = [mode](const float *x, size_t n) { return sumOfSquares(mode, x, n); };
+        double err = fabs((double)((sumOfSquares(mode, large.data(), large.size()) - exact) / exact));
+        cout << setw(12) << accumModeName(mode) << setw(10) << measure(fn, small) << setw(10)
+             << measure(fn, large) << scientific << setprecision(1) << err << fixed << setprecision(2) << endl;
+    }
+
+    cout << endl << "операции, ГБ/с: L1 / память" << endl;
+    const uint16_t opSets[] = {OP_SUMSQ, OP_MEAN | OP_VARIANCE | OP_MAX, OP_ALL & ~OP_DOT};
+    for (const auto &set : fusedKernelSets()) {
+        if (!set.supported()) continue;
+        for (uint16_t ops : opSets) {
+            auto fn = [&set, ops](const float *x, size_t n) {
+                FusedReduction fused(ops, ElemType::F32, 1.0, &set);
+                for (size_t i = 0; i < n; i += SQUARE_BLOCK) fused.add(x + i, nullptr, min(SQUARE_BLOCK, n - i));
+                double r[MAX_VECTOR_RESULTS];
+                fused.results(r);
+                return r[0];
+            };
+            cout << setw(12) << set.name << setw(10) << measure(fn, small) << setw(10) << measure(fn, large)
+                 << opNames(ops) << endl;
+        }
+    }
+    auto separate = [](const float *x, size_t n) {
+        return reduceOps(OP_MEAN, x, nullptr, n)[0] + reduceOps(OP_VARIANCE, x, nullptr, n)[0] +
+               reduceOps(OP_MAX, x, nullptr, n)[0];
+    };
+    // setw считает байты, а не буквы: выравниваем кириллицу вручную
+    cout << "3 прохода   " << setw(10) << measure(separate, small) << setw(10)
+         << measure(separate, large) << "mean,variance,max" << endl;
+
+    cout << endl << "тип элементов, Гэлем/с: L1 / память (sumsq, " << fusedKernelImpl() << ")" << endl;
+    for (unsigned t = 0; t < ELEM_TYPES; t++) {
+        ElemType type = (ElemType)t;
+        size_t width = elemTypeSize(type);
+        // Содержимое не важно для скорости: нули во всех типах
+        vector<uint8_t> rawSmall(small.size() * width), rawLarge(large.size() * width);
+        auto over = [type, width](const vector<uint8_t> &raw) {
+            return [&raw, type, width](const float *, size_t n) {
+                FusedReduction fused(OP_SUMSQ, type);
+                for (size_t i = 0; i < n; i += SQUARE_BLOCK)
+                    fused.add(raw.data() + i * width, nullptr, min(SQUARE_BLOCK, n - i));
+                double r;
+                fused.results(&r);
+                return r;
+            };
+        };
+        // measure() считает байты float: делим на 4, получая элементы
+        cout << setw(12) << elemTypeName(type) << setw(10) << measure(over(rawSmall), small) / 4
+             << measure(over(rawLarge), large) / 4 << endl;
+    }
+
+    cout << endl << "ChunkedSum, 128 МиБ: потоки, мс, сумма" << endl;
+    unsigned cores = max(1u, thread::hardware_concurrency());
+    for (unsigned threads = 1; ; threads *= 2) {
+        threads = min(threads, cores);
+        WorkPool pool(threads);
+        ChunkedSum chunked(pool);
+        auto start = chrono::steady_clock::now();
+        chunked.appendAll((const uint8_t*)large.data(), large.size());
+        float sum = chunked.finish();
+        double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << setw(12) << threads << setw(10) << ms << setprecision(6) << sum << setprecision(2) << endl;
+        if (threads == cores) break;
+    }
+    return 0;
+}
@@ -0,0 +1,221 @@
+/**
+ * @file bench_users.cpp
+ * @brief Замер поиска пользователя: хэш-индекс UserStore против линейного поиска
+ *
+ * @details Для баз из 1 тыс., 100 тыс. и 1 млн пользователей замеряется
+ * среднее время поиска логина в UserStore и прежним линейным проходом
+ * по вектору пар (логин, пароль), как это делал checkAuth. Логины
+ * выбираются случайно, половина поисков - несуществующие пользователи.
+ * Хэш SHA-256 не считается: замеряется только поиск.
+ *
+ * Кроме того, замеряется запуск: загрузка текстового файла логин:пароль
+ * и отображение двоичного образа того же размера (файлы пишутся во
+ * временный каталог).
+ *
+ * В конце замеряется полная проверка checkAuth (поиск и SHA-256 соли
+ * и пароля) - путь каждого входа в систему, и SHA-256 каждой
+ * поддерживаемой процессором реализацией: короткое сообщение, как
+ * при входе, и поток в 1 МиБ. Затем - многобуферные реализации
+ * и проверка пачкой checkAuthBatch(), как при массовом переподключении,
+ * и проверка текстового хэша против двоичного рукопожатия.
+ *
+ * Пример: ./bench/bench_users
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cstdio>
+#include <fstream>
+#include "../users.hpp"
+#include "../sha256.hpp"
+
+using namespace std;
+
+/// Прежний поиск checkAuth: первое совпадение логина
+static const string *linearFind(const vector<pair<string,string>> &users, const string &login) {
+    for (const auto &[l, p] : users) {
+        if (l == login) return &p;
+    }
+    return nullptr;
+}
+
+/// Результат поисков, чтобы компилятор их не выбросил
+static volatile size_t sink;
+
+static string makeLogin(size_t i) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "user%07zu", i);
+    return buf;
+}
+
+int main() {
+    cout << setw(10) << "Users" << setw(16) << "Build, ms" << setw(18) << "Hash, ns/find"
+         << setw(20) << "Linear, ns/find" << setw(16) << "Text load, ms" << setw(16) << "Image open, ms" << endl;
+    string textPath = "/tmp/bench_users.txt", imagePath = "/tmp/bench_users.db";
+
+    mt19937_64 rng(42);
+    for (size_t count : {1000, 100000, 1000000}) {
+        vector<pair<string,string>> pairs;
+        pairs.reserve(count);
+        for (size_t i = 0; i < count; i++) pairs.push_back({makeLogin(i), "P@ssW0rd" + to_string(i)});
+
+        auto start = chrono::steady_clock::now();
+        UserStore store;
+        store.reserve(count);
+        for (const auto &[l, p] : pairs) store.add(l, p);
+        double buildMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        // Логины запросов: половина есть в базе, половина - нет
+        vector<string> queries;
+        for (int i = 0; i < 4096; i++) queries.push_back(makeLogin(rng() % (2 * count)));
+
+        size_t hashFinds = 4000000;
+        size_t found = 0;
+        string_view pass;
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < hashFinds; i++) found += store.find(queries[i % queries.size()], pass);
+        double hashNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / hashFinds;
+
+        // Линейный поиск стоит O(n): число поисков уменьшается с размером базы
+        size_t linearFinds = max<size_t>(64, 200000000 / count);
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < linearFinds; i++) found += linearFind(pairs, queries[i % queries.size()]) != nullptr;
+        double linearNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / linearFinds;
+
+        // Запуск сервера: текстовый файл против двоичного образа
+        {
+            ofstream f(textPath);
+            for (const auto &[l, p] : pairs) f << l << ':' << p << '\n';
+        }
+        store.save(imagePath);
+        start = chrono::steady_clock::now();
+        UserStore text = loadUsers(textPath);
+        double textMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        UserStore image = loadUsers(imagePath);
+        double imageMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        found += text.size() + image.size();
+
+        cout << setw(10) << count << setw(16) << fixed << setprecision(1) << buildMs
+             << setw(18) << setprecision(1) << hashNs << setw(20) << setprecision(0) << linearNs
+             << setw(16) << setprecision(1) << textMs << setw(16) << setprecision(3) << imageMs << endl;
+        sink = found;
+    }
+    // Полная проверка пароля, как при каждом подключении клиента
+    UserStore users = {{"user", "P@ssW0rd"}};
+    string salt = "0123456789ABCDEF", hash(64, '0');
+    size_t checks = 1000000, accepted = 0;
+    auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < checks; i++) accepted += checkAuth("user", salt, hash, users);
+    double checkNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / checks;
+    cout << "checkAuth: " << setprecision(1) << checkNs << " ns (SHA-256: " << sha256Impl() << ")" << endl;
+    sink = accepted;
+
+    vector<uint8_t> stream(1 << 20, 0x5A);
+    for (const auto &backend : sha256Backends()) {
+        if (!backend.supported()) continue;
+        uint8_t out[32];
+        Sha256Context ctx;
+        size_t hashes = 1000000;
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < hashes; i++) {
+            sha256Init(ctx, backend);
+            sha256Update(ctx, (const uint8_t*)salt.data(), salt.size());
+            sha256Update(ctx, (const uint8_t*)"P@ssW0rd", 8);
+            sha256Final(ctx, out);
+            accepted += out[0];
+        }
+        double shortNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / hashes;
+        size_t rounds = 64;
+        start = chrono::steady_clock::now();
+        for (size_t i = 0; i < rounds; i++) {
+            sha256Init(ctx, backend);
+            sha256Update(ctx, stream.data(), stream.size());
+            sha256Final(ctx, out);
+            accepted += out[0];
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "SHA-256 " << setw(14) << left << backend.name << right << setw(10) << setprecision(1)
+             << shortNs << " ns/24 B" << setw(10) << setprecision(0) << rounds / seconds << " MiB/s" << endl;
+    }
+
+    // Многобуферный SHA-256: короткие сообщения соль + пароль пачками
+    vector<string> messages;
+    for (int i = 0; i < 1024; i++) messages.push_back(salt + "P@ssW0rd" + to_string(i));
+    vector<const uint8_t*> data;
+    vector<size_t> lengths;
+    for (const auto &m : messages) {
+        data.push_back((const uint8_t*)m.data());
+        lengths.push_back(m.size());
+    }
+    vector<uint8_t> digests(32 * messages.size());
+    for (const auto &backend : sha256ManyBackends()) {
+        if (!backend.supported()) continue;
+        size_t rounds = 1000;
+        start = chrono::steady_clock::now();
+        for (size_t r = 0; r < rounds; r++) {
+            for (size_t i = 0; i < messages.size(); i += backend.lanes) {
+                size_t n = min(backend.lanes, messages.size() - i);
+                backend.hash(&data[i], &lengths[i], n, (uint8_t(*)[32])&digests[32 * i]);
+            }
+            accepted += digests[0];
+        }
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (rounds * messages.size());
+        cout << "SHA-256 many " << setw(12) << left << backend.name << right << setw(6) << backend.lanes
+             << " lanes" << setw(10) << setprecision(1) << ns << " ns/message" << endl;
+    }
+
+    // Вход 1024 клиентов: по одному против пачек из цикла событий
+    UserStore fleet;
+    vector<string> logins, hashes(messages.size(), string(64, '0'));
+    for (size_t i = 0; i < messages.size(); i++) {
+        logins.push_back("user" + to_string(i));
+        fleet.add(logins.back(), "P@ssW0rd" + to_string(i));
+    }
+    size_t rounds = 200;
+    start = chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++)
+        for (size_t i = 0; i < logins.size(); i++) accepted += checkAuth(logins[i], salt, hashes[i], fleet);
+    double singleNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (rounds * logins.size());
+    vector<AuthRequest> requests(logins.size());
+    vector<AuthRequest*> pointers;
+    for (size_t i = 0; i < logins.size(); i++) {
+        requests[i] = {logins[i], salt, hashes[i]};
+        pointers.push_back(&requests[i]);
+    }
+    start = chrono::steady_clock::now();
+    for (size_t r = 0; r < rounds; r++) {
+        checkAuthBatch(pointers.data(), pointers.size(), fleet);
+        accepted += requests[0].accepted;
+    }
+    double batchNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / (rounds * logins.size());
+    cout << "1024 logins: checkAuth " << setprecision(1) << singleNs << " ns/login, checkAuthBatch "
+         << batchNs << " ns/login (" << sha256ManyImpl() << ")" << endl;
+
+    // Рукопожатие: строка логин:соль:хэш (без разбора) против двоичного кадра v2
+    string authStr = "user:" + salt + ":" + hash;
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < checks; i++) accepted += checkAuth("user", salt, hash, users);
+    double textNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / checks;
+    vector<uint8_t> frame = {AUTH_BINARY, AUTH_VERSION, 4, 'u', 's', 'e', 'r'};
+    frame.resize(authFrameSize(frame.data()));
+    start = chrono::steady_clock::now();
+    for (size_t i = 0; i < checks; i++) {
+        AuthRequest request = parseAuthFrame(frame.data());
+        AuthRequest *r = &request;
+        checkAuthBatch(&r, 1, users);
+        accepted += request.accepted;
+    }
+    double binaryNs = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / checks;
+    cout << "Handshake: text " << authStr.size() << " B, " << setprecision(1) << textNs << " ns; binary v2 "
+         << frame.size() << " B, " << binaryNs << " ns" << endl;
+    sink = accepted;
+
+    remove(textPath.c_str());
+    remove(imagePath.c_str());
+    return 0;
+}
@@ -0,0 +1,336 @@
+/**
+ * @file vcalc_load.cpp
+ * @brief Генератор нагрузки для сервера vcalc: измеряет число сессий в секунду
+ *
+ * @details Запускает заданное число параллельных клиентов. Каждый клиент
+ * в цикле подключается, проходит аутентификацию, отправляет пачку векторов
+ * (заданное число раз на одном соединении), читает результаты и закрывает
+ * сессию. По завершении печатается пропускная способность (сессий/с
+ * и векторов/с).
+ *
+ * С опцией --local клиенты подключаются к Unix-сокету сервера и передают
+ * векторы через кольца в общей памяти. С --binary-auth вместо строки
+ * логин:соль:хэш отправляется двоичное рукопожатие v2. С --resume первая
+ * сессия входит по паролю и запрашивает билет возобновления (по TCP),
+ * а все сессии нагрузки предъявляют этот билет.
+ *
+ * Пример: ./bench/vcalc_load -p 33333 -u user -w P@ssW0rd -c 200 -n 20000
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <boost/program_options.hpp>
+#include "../sha256.hpp"
+#include "../shm.hpp"
+#include "../users.hpp"
+
+namespace po = boost::program_options;
+using namespace std;
+
+struct LoadConfig {
+    string host;
+    int port;
+    string user;
+    string password;
+    uint32_t vectors;
+    uint32_t size;
+    bool batch;
+    int jobs;
+    string local;
+    bool binaryAuth;
+    bool resume;
+};
+
+static bool readAll(int sock, void *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(sock, (char*)buf + got, len - got);
+        if (n <= 0) return false;
+        got += n;
+    }
+    return true;
+}
+
+static bool writeAll(int sock, const void *buf, size_t len) {
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = write(sock, (const char*)buf + sent, len - sent);
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+/**
+ * @brief Формирует строку аутентификации логин:соль:хэш или двоичное рукопожатие
+ */
+static string makeAuth(const LoadConfig &cfg) {
+    if (cfg.binaryAuth) {
+        string salt = "\x01\x23\x45\x67\x89\xAB\xCD\xEF";
+        string data = salt + cfg.password;
+        uint8_t digest[AUTH_DIGEST_SIZE];
+        sha256((const uint8_t*)data.data(), data.size(), digest);
+        string frame = {(char)AUTH_BINARY, (char)AUTH_VERSION, (char)cfg.user.size()};
+        return frame + cfg.user + salt + string((const char*)digest, sizeof(digest));
+    }
+    string salt = "0123456789ABCDEF";
+    string data = salt + cfg.password;
+    uint8_t digest[32];
+    sha256((const uint8_t*)data.data(), data.size(), digest);
+    char hex[65];
+    for (int i = 0; i < 32; i++) sprintf(hex + i*2, "%02X", digest[i]);
+    return cfg.user + ":" + salt + ":" + string(hex, 64);
+}
+
+/**
+ * @brief Входит по паролю, запрашивает билет и возвращает кадр возобновления
+ * @return Пустая строка, если сервер не выдал билет
+ */
+static string fetchTicket(const LoadConfig &cfg, const string &auth) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return "";
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg.port);
+    inet_pton(AF_INET, cfg.host.c_str(), &addr.sin_addr);
+
+    // Запрос билета: 0xFFFFFFFC вместо числа векторов, ответ uint8 len | ticket
+    const uint8_t request[] = {0xFC, 0xFF, 0xFF, 0xFF};
+    const uint8_t closeJob[] = {0xFE, 0xFF, 0xFF, 0xFF};
+    char reply[2];
+    uint8_t len = 0;
+    string ticket(255, '\0');
+    bool ok = connect(sock, (sockaddr*)&addr, sizeof(addr)) == 0 &&
+              writeAll(sock, auth.data(), auth.size()) &&
+              readAll(sock, reply, 2) && memcmp(reply, "OK", 2) == 0 &&
+              writeAll(sock, request, sizeof(request)) && readAll(sock, &len, 1) &&
+              len > 0 && readAll(sock, ticket.data(), len);
+    if (ok) writeAll(sock, closeJob, sizeof(closeJob));
+    close(sock);
+    if (!ok) return "";
+    string frame = {(char)AUTH_BINARY, (char)AUTH_TICKET, (char)len};
+    return frame + ticket.substr(0, len);
+}
+
+/**
+ * @brief Одна полная сессия: подключение, аутентификация, задания, закрытие
+ */
+static bool runSession(const LoadConfig &cfg, const string &auth, const vector<uint8_t> &payload) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock < 0) return false;
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg.port);
+    inet_pton(AF_INET, cfg.host.c_str(), &addr.sin_addr);
+
+    bool ok = connect(sock, (sockaddr*)&addr, sizeof(addr)) == 0 &&
+              writeAll(sock, auth.data(), auth.size());
+    char reply[2];
+    ok = ok && readAll(sock, reply, 2) && memcmp(reply, "OK", 2) == 0;
+    vector<uint8_t> results(cfg.vectors * (cfg.batch ? 8 : 4));
+    for (int j = 0; j < cfg.jobs; j++) {
+        ok = ok && writeAll(sock, payload.data(), payload.size());
+        ok = ok && readAll(sock, results.data(), results.size());
+    }
+    // Явное завершение сессии: значение 0xFFFFFFFE вместо числа векторов
+    const uint8_t closeJob[] = {0xFE, 0xFF, 0xFF, 0xFF};
+    ok = ok && writeAll(sock, closeJob, sizeof(closeJob));
+    close(sock);
+    return ok;
+}
+
+/**
+ * @brief Ждёт ответы в кольце; спит на eventfd, если их нет
+ * @return Число полученных ответов
+ */
+static uint32_t collectLocal(ShmChannel &shm, int serverWake, int clientWake) {
+    ShmControl *ctl = shm.control();
+    ShmRing &responses = shm.responses();
+    while (true) {
+        uint32_t got = 0, tag, len;
+        const uint8_t *data;
+        while (responses.peek(tag, data, len) == ShmRing::Status::Ready) {
+            responses.pop();
+            got++;
+        }
+        if (got) {
+            // Освободилось место для ответов: сервер мог уснуть, ожидая его
+            shmWake(ctl->serverSleeping, serverWake);
+            return got;
+        }
+        ctl->clientSleeping.store(1);
+        if (!responses.readable()) {
+            uint64_t count;
+            read(clientWake, &count, sizeof(count));
+        }
+        ctl->clientSleeping.store(0);
+    }
+}
+
+/**
+ * @brief Сессия через Unix-сокет: векторы идут записями кольца запросов
+ * @param frame Один вектор: размер, затем данные
+ */
+static bool runLocalSession(const LoadConfig &cfg, const string &auth, const vector<uint8_t> &frame) {
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0) return false;
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, cfg.local.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(sock, (sockaddr*)&addr, sizeof(addr)) < 0 || !writeAll(sock, auth.data(), auth.size())) {
+        close(sock);
+        return false;
+    }
+
+    // "OK" приходит вместе с memfd колец и двумя eventfd
+    char reply[2];
+    int fds[3] = {-1, -1, -1};
+    iovec iov = {reply, sizeof(reply)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))];
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    bool ok = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC) == 2 && memcmp(reply, "OK", 2) == 0;
+    cmsghdr *cm = ok ? CMSG_FIRSTHDR(&msg) : nullptr;
+    ok = cm && cm->cmsg_type == SCM_RIGHTS && cm->cmsg_len == CMSG_LEN(sizeof(fds));
+    if (!ok) {
+        close(sock);
+        return false;
+    }
+    memcpy(fds, CMSG_DATA(cm), sizeof(fds));
+
+    ShmChannel shm;
+    ok = shm.attach(fds[0]);
+    ShmRing &requests = shm.requests();
+    for (int j = 0; ok && j < cfg.jobs; j++) {
+        uint32_t answered = 0;
+        for (uint32_t i = 0; i < cfg.vectors; i++) {
+            uint8_t *p;
+            while (!(p = requests.reserve(frame.size()))) answered += collectLocal(shm, fds[1], fds[2]);
+            memcpy(p, frame.data(), frame.size());
+            requests.commit(i, frame.size());
+            shmWake(shm.control()->serverSleeping, fds[1]);
+        }
+        while (answered < cfg.vectors) answered += collectLocal(shm, fds[1], fds[2]);
+    }
+    close(fds[1]);
+    close(fds[2]);
+    close(sock);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    LoadConfig cfg;
+    int concurrency;
+    int total;
+
+    po::options_description desc("Генератор нагрузки vcalc\n\nДоступные опции");
+    desc.add_options()
+        ("help,h", "Показать справку")
+        ("host,H", po::value<string>(&cfg.host)->default_value("127.0.0.1"), "Адрес сервера")
+        ("port,p", po::value<int>(&cfg.port)->default_value(33333), "Порт сервера")
+        ("user,u", po::value<string>(&cfg.user)->default_value("user"), "Логин")
+        ("password,w", po::value<string>(&cfg.password)->default_value("P@ssW0rd"), "Пароль")
+        ("clients,c", po::value<int>(&concurrency)->default_value(100), "Параллельных клиентов")
+        ("sessions,n", po::value<int>(&total)->default_value(10000), "Всего сессий")
+        ("vectors,v", po::value<uint32_t>(&cfg.vectors)->default_value(4), "Векторов в сессии")
+        ("size,s", po::value<uint32_t>(&cfg.size)->default_value(16), "Элементов в векторе")
+        ("batch,b", po::bool_switch(&cfg.batch), "Передавать векторы одним пакетом")
+        ("jobs,j", po::value<int>(&cfg.jobs)->default_value(1), "Заданий в сессии (на одном соединении)")
+        ("local,L", po::value<string>(&cfg.local), "Unix-сокет сервера: векторы через общую память")
+        ("binary-auth", po::bool_switch(&cfg.binaryAuth), "Двоичное рукопожатие (протокол v2)")
+        ("resume", po::bool_switch(&cfg.resume), "Вход по билету возобновления, полученному в первой сессии");
+
+    po::variables_map vm;
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        po::notify(vm);
+    } catch (exception &e) {
+        cerr << "Ошибка: " << e.what() << endl << desc << endl;
+        return 1;
+    }
+    if (vm.count("help")) {
+        cout << desc << endl;
+        return 0;
+    }
+    if (cfg.user.empty() || cfg.user.size() > 255) {
+        cerr << "Ошибка: логин должен быть от 1 до 255 символов" << endl;
+        return 1;
+    }
+    if (cfg.batch && !cfg.local.empty()) {
+        cerr << "Ошибка: пакет векторов передаётся только по TCP" << endl;
+        return 1;
+    }
+
+    // Тело запроса одинаково для всех сессий: количество, затем векторы,
+    // или пакет - размеры всех векторов в одном заголовке, затем данные
+    vector<uint8_t> payload;
+    auto put32 = [&payload](uint32_t v) {
+        for (int i = 0; i < 4; i++) payload.push_back((v >> (8*i)) & 0xFF);
+    };
+    if (cfg.batch) {
+        put32(0xFFFFFFFF);
+        put32(1 + 4 * cfg.vectors);
+        payload.push_back(0);
+        for (uint32_t i = 0; i < cfg.vectors; i++) put32(cfg.size);
+    } else {
+        put32(cfg.vectors);
+    }
+    for (uint32_t i = 0; i < cfg.vectors; i++) {
+        if (!cfg.batch) put32(cfg.size);
+        for (uint32_t j = 0; j < cfg.size; j++) {
+            float f = 0.5f * j;
+            uint32_t bits;
+            memcpy(&bits, &f, 4);
+            put32(bits);
+        }
+    }
+    string auth = makeAuth(cfg);
+    if (cfg.resume) {
+        auth = fetchTicket(cfg, auth);
+        if (auth.empty()) {
+            cerr << "Ошибка: сервер не выдал билет возобновления" << endl;
+            return 1;
+        }
+    }
+
+    // Для локальной сессии - один вектор без числа векторов в начале
+    vector<uint8_t> frame(payload.begin() + 4, payload.begin() + 8 + 4 * (size_t)cfg.size);
+
+    atomic<int> next{0}, ok{0}, failed{0};
+    auto start = chrono::steady_clock::now();
+    vector<thread> threads;
+    for (int t = 0; t < concurrency; t++) {
+        threads.emplace_back([&]() {
+            while (next.fetch_add(1) < total) {
+                bool done = cfg.local.empty() ? runSession(cfg, auth, payload)
+                                              : runLocalSession(cfg, auth, frame);
+                if (done) ok++;
+                else failed++;
+            }
+        });
+    }
+    for (auto &t : threads) t.join();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    cout << "Сессий: " << ok << " успешно, " << failed << " с ошибкой за " << secs << " с" << endl;
+    cout << "Сессий/с: " << ok / secs << ", векторов/с: " << ok * (double)cfg.vectors * cfg.jobs / secs << endl;
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+/**
+ * @file buffer.cpp
+ * @brief Реализация приёмного буфера соединения
+ */
+
+#include "buffer.hpp"
+#include <cstring>
+#include <unistd.h>
+
+RecvBuffer::RecvBuffer(size_t capacity) : buf(capacity) {
+}
+
+void RecvBuffer::consume(size_t n) {
+    head += n;
+    if (head == tail) head = tail = 0;
+}
+
+uint8_t *RecvBuffer::reserve(size_t &room, size_t limit) {
+    // Недочитанный хвост переносится в начало, чтобы освободить место
+    if (tail == buf.size() && head > 0) {
+        memmove(buf.data(), buf.data() + head, tail - head);
+        tail -= head;
+        head = 0;
+    }
+    room = buf.size() - tail;
+    if (room > limit) room = limit;
+    return buf.data() + tail;
+}
+
+ssize_t RecvBuffer::fill(int sock, size_t limit) {
+    size_t room;
+    uint8_t *p = reserve(room, limit);
+    ssize_t n = read(sock, p, room);
+    if (n > 0) commit(n);
+    return n;
+}
+
+void decodeLittleEndianFloats(const uint8_t *bytes, size_t count, float *out) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    memcpy(out, bytes, count * sizeof(float));
+#else
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *b = bytes + i * 4;
+        uint32_t v = (uint32_t)b[0] | ((uint32_t)b[1] << 8) | ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+        memcpy(&out[i], &v, sizeof(float));
+    }
+#endif
+}
+
+/**
+ * @brief Разделение пар элементов фиксированной ширины W
+ */
+template<size_t W>
+static void splitPairs(const uint8_t *bytes, size_t count, uint8_t *x, uint8_t *y) {
+    for (size_t i = 0; i < count; i++) {
+        memcpy(x + i * W, bytes + 2 * i * W, W);
+        memcpy(y + i * W, bytes + (2 * i + 1) * W, W);
+    }
+}
+
+void splitLittleEndianPairs(const uint8_t *bytes, size_t count, size_t width, uint8_t *x, uint8_t *y) {
+    switch (width) {
+    case 1: splitPairs<1>(bytes, count, x, y); break;
+    case 2: splitPairs<2>(bytes, count, x, y); break;
+    case 4: splitPairs<4>(bytes, count, x, y); break;
+    default: splitPairs<8>(bytes, count, x, y); break;
+    }
+#if !(defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    decodeLittleEndianElements(x, count, width, x);
+    decodeLittleEndianElements(y, count, width, y);
+#endif
+}
+
+void decodeLittleEndianElements(const uint8_t *bytes, size_t count, size_t width, uint8_t *out) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (out != bytes) memcpy(out, bytes, count * width);
+#else
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *b = bytes + i * width;
+        uint8_t *o = out + i * width;
+        for (size_t k = 0; k < width / 2; k++) {
+            uint8_t t = b[k];
+            o[k] = b[width - 1 - k];
+            o[width - 1 - k] = t;
+        }
+        if (width % 2) o[width / 2] = b[width / 2];
+    }
+#endif
+}
@@ -0,0 +1,90 @@
+/**
+ * @file buffer.hpp
+ * @brief Приёмный буфер соединения: чтение из сокета крупными порциями
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <sys/types.h>
+
+/**
+ * @brief Буфер входящих данных со сдвигом недочитанного хвоста к началу
+ *
+ * @details Один вызов read() забирает из сокета столько, сколько помещается
+ * в свободное место буфера, а разбор протокола затем потребляет данные
+ * из памяти. Так вектор из миллиона элементов читается за сотни
+ * системных вызовов вместо миллиона.
+ */
+class RecvBuffer {
+public:
+    /// Ёмкость по умолчанию (байт)
+    static const size_t DEFAULT_CAPACITY = 16 * 1024;
+
+    explicit RecvBuffer(size_t capacity = DEFAULT_CAPACITY);
+
+    /// Начало непрочитанных данных
+    const uint8_t *data() const { return buf.data() + head; }
+
+    /// Количество непрочитанных байт
+    size_t size() const { return tail - head; }
+
+    /// Отмечает n байт как обработанные
+    void consume(size_t n);
+
+    /**
+     * @brief Дочитывает данные из сокета в свободное место буфера
+     * @param sock Сокет
+     * @param limit Максимум байт за вызов
+     * @return Как у read(): число байт, 0 при закрытии соединения,
+     * -1 при ошибке (errno сохраняется, в т.ч. EAGAIN)
+     */
+    ssize_t fill(int sock, size_t limit = SIZE_MAX);
+
+    /**
+     * @brief Готовит свободное место для приёма данных
+     * @param room [out] Сколько байт можно записать (не больше limit)
+     * @return Указатель на свободное место; после приёма нужно вызвать commit()
+     */
+    uint8_t *reserve(size_t &room, size_t limit = SIZE_MAX);
+
+    /// Добавляет n байт, записанных по указателю из reserve()
+    void commit(size_t n) { tail += n; }
+
+private:
+    std::vector<uint8_t> buf;
+    size_t head = 0;
+    size_t tail = 0;
+};
+
+/**
+ * @brief Декодирует серию чисел float в порядке little-endian
+ * @param bytes Входные байты (4 * count), выравнивание не требуется
+ * @param count Число элементов
+ * @param out Выходной массив
+ *
+ * @details На little-endian платформе сводится к одному memcpy.
+ */
+void decodeLittleEndianFloats(const uint8_t *bytes, size_t count, float *out);
+
+/**
+ * @brief Разделяет серию пар (x_i, y_i) little-endian на два массива
+ * @param bytes Входные байты (2 * width * count), выравнивание не требуется
+ * @param count Число пар
+ * @param width Размер элемента в байтах (1, 2, 4 или 8)
+ * @param x Первые элементы пар в порядке байтов процессора
+ * @param y Вторые элементы пар
+ *
+ * @details Элементы копируются в своём типе, без расширения.
+ */
+void splitLittleEndianPairs(const uint8_t *bytes, size_t count, size_t width, uint8_t *x, uint8_t *y);
+
+/**
+ * @brief Переводит серию элементов little-endian в порядок байтов процессора
+ * @param width Размер элемента в байтах
+ *
+ * @details Нужна только на big-endian платформе: на little-endian
+ * байты с провода уже годятся для ядер как есть.
+ */
+void decodeLittleEndianElements(const uint8_t *bytes, size_t count, size_t width, uint8_t *out);
@@ -0,0 +1,162 @@
+/**
+ * @file jobs.cpp
+ * @brief Реализация заданий с номерами запроса
+ */
+
+#include "jobs.hpp"
+#include "pool.hpp"
+#include "reduction.hpp"
+#include "kernels.hpp"
+#include "ops.hpp"
+#include <cstring>
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+/// Буфер кадра длиннее этого освобождается после задания, а не переиспользуется
+static const size_t KEEP_FRAME = 1 << 20;
+
+unsigned computeFrame(const uint8_t *p, size_t len, VectorHeader &hdr, double *results) {
+    hdr = VectorHeader();
+    if (len < 4) return 0;
+
+    hdr.size = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    if (!vectorSizeValid(hdr.size)) return 0;
+    size_t pos = 4;
+    if (hdr.size == EXT_VECTOR) {
+        // Кадр может лежать в кольце общей памяти, которое клиент меняет
+        // и во время разбора: длина и поля заголовка копируются один раз,
+        // проверяется и используется только копия
+        if (len < 5) return 0;
+        uint8_t hdrLen = p[4];
+        if (len < 5 + (size_t)hdrLen) return 0;
+        uint8_t header[255];
+        memcpy(header, p + 5, hdrLen);
+        if (!parseVectorHeader(header, hdrLen, hdr)) return 0;
+        pos = 5 + hdrLen;
+    }
+    const uint8_t *data = p + pos;
+    size_t dataLen = len - pos;
+
+    if (!hdr.fused()) {
+        if (dataLen != (size_t)hdr.size * 4) return 0;
+        AnySquareSum acc = makeSquareSum(hdr.mode);
+        accumulateSquares(acc, data, hdr.size);
+        results[0] = visit([](auto &s) { return s.result(); }, acc);
+        return 1;
+    }
+
+    FusedReduction fused(hdr.ops, hdr.dtype, hdr.scale);
+    if (!fused.valid()) return 0;
+    size_t width = fused.elemSize();
+    if (hdr.sparse) {
+        SparseDecoder sparse(hdr.size, hdr.nnz, width, fused.paired());
+        uint8_t x[8 * SQUARE_BLOCK], y[8 * SQUARE_BLOCK];
+        while (sparse.remaining() > 0) {
+            size_t used, filled = 0;
+            if (!sparse.decode(data, dataLen, used, x, y, filled, SQUARE_BLOCK)) return 0;
+            if (filled == 0) return 0;  // кадр кончился раньше записей
+            fused.add(x, fused.paired() ? y : nullptr, filled);
+            data += used;
+            dataLen -= used;
+        }
+        if (dataLen != 0) return 0;
+        fused.addZeros(hdr.size - hdr.nnz);
+    } else {
+        if (dataLen != (size_t)hdr.size * width * (fused.paired() ? 2 : 1)) return 0;
+        accumulateOps(fused, data, hdr.size);
+    }
+    return fused.results(results);
+}
+
+void computeJob(Job &job) {
+    job.resultCount = computeFrame(job.frame.data(), job.frame.size(), job.hdr, job.results);
+}
+
+JobQueue::JobQueue(WorkPool *pool, int wakeFd) : pool(pool), wakeFd(wakeFd) {
+}
+
+JobQueue::~JobQueue() {
+    // Задачи пула ссылаются на задания: дожидаемся их, даже если соединение закрыто
+    while (running.load() > 0) {
+        if (!pool->runOne()) this_thread::yield();
+    }
+}
+
+bool JobQueue::hasRoom(size_t len) const {
+    if (active.size() == MAX_JOBS) return false;
+    return active.empty() || bytes + len <= MAX_BYTES;
+}
+
+Job &JobQueue::start(uint32_t id, size_t len) {
+    if (spare.empty()) {
+        jobs.push_back(make_unique<Job>());
+        jobs.back()->owner = this;
+        spare.push_back(jobs.back().get());
+    }
+    Job *job = spare.back();
+    spare.pop_back();
+    job->id = id;
+    job->frame.resize(len);
+    job->resultCount = 0;
+    job->done.store(false, memory_order_relaxed);
+    active.push_back(job);
+    bytes += len;
+    return *job;
+}
+
+void JobQueue::runJob(void *arg) {
+    Job *job = static_cast<Job*>(arg);
+    JobQueue *owner = job->owner;
+    computeJob(*job);
+    job->done.store(true);
+
+    // Та же пара store(done) / exchange(parked), что в ChunkedSum::reduceSlot
+    if (owner->parked.exchange(false)) {
+        uint64_t one = 1;
+        write(owner->wakeFd, &one, sizeof(one));
+    }
+    owner->running.fetch_sub(1);
+}
+
+void JobQueue::submit(Job &job) {
+    if (!pool) {
+        computeJob(job);
+        job.done.store(true);
+        return;
+    }
+    running.fetch_add(1);
+    pool->submit({runJob, &job});
+}
+
+void JobQueue::release(size_t i) {
+    Job *job = active[i];
+    bytes -= job->frame.size();
+    if (job->frame.capacity() > KEEP_FRAME) vector<uint8_t>().swap(job->frame);
+    active[i] = active.back();
+    active.pop_back();
+    spare.push_back(job);
+}
+
+bool JobQueue::arm() {
+    if (active.empty() || wakeFd < 0) return false;
+    parked.store(true);
+    for (Job *job : active) {
+        if (job->done.load()) {
+            // Задание успело завершиться: уведомление, если оно уже ушло, будет лишним
+            parked.store(false);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobQueue::waitOne() {
+    while (!active.empty()) {
+        for (Job *job : active) {
+            if (job->done.load(memory_order_acquire)) return;
+        }
+        if (!pool || !pool->runOne()) this_thread::yield();
+    }
+}
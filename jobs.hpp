@@ -0,0 +1,136 @@
+/**
+ * @file jobs.hpp
+ * @brief Задания с номерами запроса: расчёт на пуле и ответы по готовности
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "protocol.hpp"
+
+class WorkPool;
+class JobQueue;
+
+/**
+ * @brief Задание: один вектор с номером запроса
+ */
+struct Job {
+    uint32_t id = 0;                        ///< Номер запроса клиента
+    std::vector<uint8_t> frame;             ///< Вектор целиком: размер или расширенный заголовок, затем данные
+    VectorHeader hdr;                       ///< Заголовок вектора (заполняет computeJob())
+    double results[MAX_VECTOR_RESULTS];     ///< Результаты операций
+    unsigned resultCount = 0;               ///< Число результатов; 0 - вектор неверен
+    JobQueue *owner = nullptr;
+    std::atomic<bool> done{false};
+};
+
+/**
+ * @brief Считает вектор, целиком лежащий в памяти
+ *
+ * @details Вектор разбирается так же, как в потоке сессии, и считается
+ * тем же путём: сумма квадратов float - ядром режима, остальное -
+ * совместной редукцией, блоками SQUARE_BLOCK. Поэтому результат
+ * совпадает с заданием без номера. Каждое поле кадра читается один раз,
+ * так что кадр может лежать и в памяти, которую меняет клиент.
+ * @param frame Вектор: размер или расширенный заголовок, затем данные
+ * @param len Длина кадра
+ * @param hdr [out] Заголовок вектора
+ * @param results [out] Не меньше MAX_VECTOR_RESULTS результатов
+ * @return Число результатов; 0 - кадр не является ровно одним верным вектором
+ */
+unsigned computeFrame(const uint8_t *frame, size_t len, VectorHeader &hdr, double *results);
+
+/// Считает вектор кадра задания (computeFrame() над job.frame)
+void computeJob(Job &job);
+
+/**
+ * @brief Задания с номерами одного соединения
+ *
+ * @details Сессия принимает кадр задания целиком в буфер задания
+ * (start()), отдаёт его пулу (submit()) и сразу читает следующий, так
+ * что длинный вектор не задерживает короткие за ним. Готовые задания
+ * забираются в любом порядке через collect(). Число заданий и байт
+ * в работе ограничено: без места сессия перестаёт читать сокет.
+ *
+ * О завершении задания пул сообщает так же, как ChunkedSum: если
+ * владелец взвёл уведомление (arm()), поток пула записывает 1 в eventfd
+ * транспорта.
+ */
+class JobQueue {
+public:
+    /// Наибольшее число заданий в работе на соединение
+    static const size_t MAX_JOBS = 64;
+
+    /// Наибольший объём кадров в работе на соединение (одно задание допускается любой длины)
+    static const size_t MAX_BYTES = 64 << 20;
+
+    /**
+     * @param pool Пул потоков; nullptr - задание считается сразу в submit()
+     * @param wakeFd eventfd транспорта; -1 - уведомления не нужны
+     */
+    JobQueue(WorkPool *pool, int wakeFd);
+    ~JobQueue();
+
+    JobQueue(const JobQueue &) = delete;
+    JobQueue &operator=(const JobQueue &) = delete;
+
+    /// Есть ли место для задания с кадром длиной len байт
+    bool hasRoom(size_t len) const;
+
+    /// Заданий, ещё не отданных через collect()
+    size_t pending() const { return active.size(); }
+
+    /**
+     * @brief Занимает место под задание
+     * @return Задание с буфером frame длиной len; его заполняет владелец
+     */
+    Job &start(uint32_t id, size_t len);
+
+    /// Отдаёт заполненное задание пулу
+    void submit(Job &job);
+
+    /**
+     * @brief Передаёт готовые задания в done(job) и освобождает их места
+     */
+    template<class F>
+    void collect(F &&done) {
+        for (size_t i = 0; i < active.size(); ) {
+            Job *job = active[i];
+            if (!job->done.load(std::memory_order_acquire)) {
+                i++;
+                continue;
+            }
+            done(*job);
+            release(i);
+        }
+    }
+
+    /**
+     * @brief Просит пул отметить eventfd по завершении любого задания
+     * @return true если готовое задание уже есть: уведомления может не
+     * быть, забрать его нужно сразу
+     */
+    bool arm();
+
+    /**
+     * @brief Дожидается хотя бы одного готового задания, выполняя задачи пула
+     */
+    void waitOne();
+
+private:
+    static void runJob(void *arg);
+    void release(size_t i);
+
+    WorkPool *pool;
+    int wakeFd;
+    std::vector<std::unique_ptr<Job>> jobs;     ///< Все задания; свободные перечислены в spare
+    std::vector<Job*> spare;                    ///< Свободные задания (буферы переиспользуются)
+    std::vector<Job*> active;                   ///< Задания в работе и готовые, ещё не забранные
+    size_t bytes = 0;                           ///< Объём кадров в active
+
+    std::atomic<bool> parked{false};            ///< Владелец ждёт уведомления
+    std::atomic<size_t> running{0};             ///< Задачи пула, ещё не вышедшие из runJob
+};
@@ -0,0 +1,392 @@
+/**
+ * @file kernels.cpp
+ * @brief Реализации ядер редукции: скалярная, SSE, AVX2+FMA и AVX-512
+ *
+ * @details Варианты для x86 компилируются с атрибутом target, поэтому
+ * весь файл собирается с обычными флагами, а нужная реализация
+ * выбирается во время работы по cpuid (__builtin_cpu_supports).
+ */
+
+#include "kernels.hpp"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VCALC_X86 1
+#endif
+
+using namespace std;
+
+/**
+ * @brief Скалярная реализация с четырьмя независимыми аккумуляторами
+ */
+static float sumSquaresScalar(const float *x, size_t n) {
+    float a0 = 0.0f, a1 = 0.0f, a2 = 0.0f, a3 = 0.0f;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 += x[i] * x[i];
+        a1 += x[i+1] * x[i+1];
+        a2 += x[i+2] * x[i+2];
+        a3 += x[i+3] * x[i+3];
+    }
+    for (; i < n; i++) a0 += x[i] * x[i];
+    return (a0 + a1) + (a2 + a3);
+}
+
+/**
+ * @brief Скалярная сумма квадратов в double
+ */
+static double sumSquaresDoubleScalar(const float *x, size_t n) {
+    double a0 = 0.0, a1 = 0.0, a2 = 0.0, a3 = 0.0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        a0 += (double)x[i] * x[i];
+        a1 += (double)x[i+1] * x[i+1];
+        a2 += (double)x[i+2] * x[i+2];
+        a3 += (double)x[i+3] * x[i+3];
+    }
+    for (; i < n; i++) a0 += (double)x[i] * x[i];
+    return (a0 + a1) + (a2 + a3);
+}
+
+/**
+ * @brief Добавляет y к сумме sum, копя ошибку сложения в comp (TwoSum)
+ *
+ * @details Вариант Кнута без ветвлений: точен при любом соотношении
+ * величин, как и сравнение модулей у Ноймайера.
+ */
+static inline void twoSumAdd(double &sum, double &comp, double y) {
+    double t = sum + y;
+    double z = t - sum;
+    comp += (sum - (t - z)) + (y - z);
+    sum = t;
+}
+
+/**
+ * @brief Скалярная компенсированная сумма квадратов
+ */
+static void sumSquaresCompensatedScalar(const float *x, size_t n, double &sum, double &comp) {
+    for (size_t i = 0; i < n; i++) twoSumAdd(sum, comp, (double)x[i] * x[i]);
+}
+
+#ifdef VCALC_X86
+
+/**
+ * @brief SSE: четыре аккумулятора по 4 элемента
+ */
+__attribute__((target("sse2")))
+static float sumSquaresSse(const float *x, size_t n) {
+    __m128 a0 = _mm_setzero_ps(), a1 = _mm_setzero_ps();
+    __m128 a2 = _mm_setzero_ps(), a3 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128 v0 = _mm_loadu_ps(x + i);
+        __m128 v1 = _mm_loadu_ps(x + i + 4);
+        __m128 v2 = _mm_loadu_ps(x + i + 8);
+        __m128 v3 = _mm_loadu_ps(x + i + 12);
+        a0 = _mm_add_ps(a0, _mm_mul_ps(v0, v0));
+        a1 = _mm_add_ps(a1, _mm_mul_ps(v1, v1));
+        a2 = _mm_add_ps(a2, _mm_mul_ps(v2, v2));
+        a3 = _mm_add_ps(a3, _mm_mul_ps(v3, v3));
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m128 v = _mm_loadu_ps(x + i);
+        a0 = _mm_add_ps(a0, _mm_mul_ps(v, v));
+    }
+    a0 = _mm_add_ps(_mm_add_ps(a0, a1), _mm_add_ps(a2, a3));
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, a0);
+    float sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) sum += x[i] * x[i];
+    return sum;
+}
+
+/**
+ * @brief AVX2+FMA: четыре аккумулятора по 8 элементов
+ */
+__attribute__((target("avx2,fma")))
+static float sumSquaresAvx2(const float *x, size_t n) {
+    __m256 a0 = _mm256_setzero_ps(), a1 = _mm256_setzero_ps();
+    __m256 a2 = _mm256_setzero_ps(), a3 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256 v0 = _mm256_loadu_ps(x + i);
+        __m256 v1 = _mm256_loadu_ps(x + i + 8);
+        __m256 v2 = _mm256_loadu_ps(x + i + 16);
+        __m256 v3 = _mm256_loadu_ps(x + i + 24);
+        a0 = _mm256_fmadd_ps(v0, v0, a0);
+        a1 = _mm256_fmadd_ps(v1, v1, a1);
+        a2 = _mm256_fmadd_ps(v2, v2, a2);
+        a3 = _mm256_fmadd_ps(v3, v3, a3);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256 v = _mm256_loadu_ps(x + i);
+        a0 = _mm256_fmadd_ps(v, v, a0);
+    }
+    a0 = _mm256_add_ps(_mm256_add_ps(a0, a1), _mm256_add_ps(a2, a3));
+
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(a0), _mm256_extractf128_ps(a0, 1));
+    float lanes[4];
+    _mm_storeu_ps(lanes, s);
+    float sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < n; i++) sum += x[i] * x[i];
+    return sum;
+}
+
+/**
+ * @brief AVX-512: четыре аккумулятора по 16 элементов, хвост - маскированной загрузкой
+ */
+__attribute__((target("avx512f")))
+static float sumSquaresAvx512(const float *x, size_t n) {
+    __m512 a0 = _mm512_setzero_ps(), a1 = _mm512_setzero_ps();
+    __m512 a2 = _mm512_setzero_ps(), a3 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 64 <= n; i += 64) {
+        __m512 v0 = _mm512_loadu_ps(x + i);
+        __m512 v1 = _mm512_loadu_ps(x + i + 16);
+        __m512 v2 = _mm512_loadu_ps(x + i + 32);
+        __m512 v3 = _mm512_loadu_ps(x + i + 48);
+        a0 = _mm512_fmadd_ps(v0, v0, a0);
+        a1 = _mm512_fmadd_ps(v1, v1, a1);
+        a2 = _mm512_fmadd_ps(v2, v2, a2);
+        a3 = _mm512_fmadd_ps(v3, v3, a3);
+    }
+    for (; i + 16 <= n; i += 16) {
+        __m512 v = _mm512_loadu_ps(x + i);
+        a0 = _mm512_fmadd_ps(v, v, a0);
+    }
+    if (i < n) {
+        __mmask16 m = (__mmask16)((1u << (n - i)) - 1);
+        __m512 v = _mm512_maskz_loadu_ps(m, x + i);
+        a1 = _mm512_fmadd_ps(v, v, a1);
+    }
+    a0 = _mm512_add_ps(_mm512_add_ps(a0, a1), _mm512_add_ps(a2, a3));
+
+    // Свёртка через память: _mm512_reduce_add_ps и _mm512_extractf64x4_pd
+    // в заголовках GCC 12 дают ложное предупреждение -Wuninitialized
+    float lanes[16];
+    _mm512_storeu_ps(lanes, a0);
+    for (int w = 8; w > 0; w /= 2)
+        for (int k = 0; k < w; k++) lanes[k] += lanes[k + w];
+    return lanes[0];
+}
+
+/**
+ * @brief Складывает дорожки вектора double попарно
+ */
+static inline double sumLanes(double *lanes, int count) {
+    for (int w = count / 2; w > 0; w /= 2)
+        for (int k = 0; k < w; k++) lanes[k] += lanes[k + w];
+    return lanes[0];
+}
+
+/**
+ * @brief AVX2+FMA, накопление в double: четыре аккумулятора по 4 элемента
+ */
+__attribute__((target("avx2,fma")))
+static double sumSquaresDoubleAvx2(const float *x, size_t n) {
+    __m256d a0 = _mm256_setzero_pd(), a1 = _mm256_setzero_pd();
+    __m256d a2 = _mm256_setzero_pd(), a3 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256d v0 = _mm256_cvtps_pd(_mm_loadu_ps(x + i));
+        __m256d v1 = _mm256_cvtps_pd(_mm_loadu_ps(x + i + 4));
+        __m256d v2 = _mm256_cvtps_pd(_mm_loadu_ps(x + i + 8));
+        __m256d v3 = _mm256_cvtps_pd(_mm_loadu_ps(x + i + 12));
+        a0 = _mm256_fmadd_pd(v0, v0, a0);
+        a1 = _mm256_fmadd_pd(v1, v1, a1);
+        a2 = _mm256_fmadd_pd(v2, v2, a2);
+        a3 = _mm256_fmadd_pd(v3, v3, a3);
+    }
+    a0 = _mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3));
+    double lanes[4];
+    _mm256_storeu_pd(lanes, a0);
+    double sum = sumLanes(lanes, 4);
+    for (; i < n; i++) sum += (double)x[i] * x[i];
+    return sum;
+}
+
+/**
+ * @brief AVX2, компенсированное накопление: TwoSum в каждой дорожке
+ */
+__attribute__((target("avx2,fma")))
+static void sumSquaresCompensatedAvx2(const float *x, size_t n, double &sum, double &comp) {
+    __m256d s0 = _mm256_setzero_pd(), c0 = _mm256_setzero_pd();
+    __m256d s1 = _mm256_setzero_pd(), c1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d v0 = _mm256_cvtps_pd(_mm_loadu_ps(x + i));
+        __m256d v1 = _mm256_cvtps_pd(_mm_loadu_ps(x + i + 4));
+        __m256d y0 = _mm256_mul_pd(v0, v0);
+        __m256d y1 = _mm256_mul_pd(v1, v1);
+        __m256d t0 = _mm256_add_pd(s0, y0);
+        __m256d t1 = _mm256_add_pd(s1, y1);
+        __m256d z0 = _mm256_sub_pd(t0, s0);
+        __m256d z1 = _mm256_sub_pd(t1, s1);
+        c0 = _mm256_add_pd(c0, _mm256_add_pd(_mm256_sub_pd(s0, _mm256_sub_pd(t0, z0)), _mm256_sub_pd(y0, z0)));
+        c1 = _mm256_add_pd(c1, _mm256_add_pd(_mm256_sub_pd(s1, _mm256_sub_pd(t1, z1)), _mm256_sub_pd(y1, z1)));
+        s0 = t0;
+        s1 = t1;
+    }
+    double ls[8], lc[8];
+    _mm256_storeu_pd(ls, s0);
+    _mm256_storeu_pd(ls + 4, s1);
+    _mm256_storeu_pd(lc, c0);
+    _mm256_storeu_pd(lc + 4, c1);
+    for (int k = 0; k < 8; k++) {
+        twoSumAdd(sum, comp, ls[k]);
+        comp += lc[k];
+    }
+    sumSquaresCompensatedScalar(x + i, n - i, sum, comp);
+}
+
+/**
+ * @brief Расширяет 8 float до double
+ *
+ * @details Вариант с нулевой маской: _mm512_cvtps_pd в заголовках GCC 12
+ * даёт то же ложное предупреждение -Wmaybe-uninitialized.
+ */
+__attribute__((target("avx512f")))
+static inline __m512d widenPs(const float *x) {
+    return _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(x));
+}
+
+/**
+ * @brief AVX-512, накопление в double: четыре аккумулятора по 8 элементов
+ */
+__attribute__((target("avx512f")))
+static double sumSquaresDoubleAvx512(const float *x, size_t n) {
+    __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd();
+    __m512d a2 = _mm512_setzero_pd(), a3 = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512d v0 = widenPs(x + i);
+        __m512d v1 = widenPs(x + i + 8);
+        __m512d v2 = widenPs(x + i + 16);
+        __m512d v3 = widenPs(x + i + 24);
+        a0 = _mm512_fmadd_pd(v0, v0, a0);
+        a1 = _mm512_fmadd_pd(v1, v1, a1);
+        a2 = _mm512_fmadd_pd(v2, v2, a2);
+        a3 = _mm512_fmadd_pd(v3, v3, a3);
+    }
+    a0 = _mm512_add_pd(_mm512_add_pd(a0, a1), _mm512_add_pd(a2, a3));
+    double lanes[8];
+    _mm512_storeu_pd(lanes, a0);
+    double sum = sumLanes(lanes, 8);
+    for (; i < n; i++) sum += (double)x[i] * x[i];
+    return sum;
+}
+
+/**
+ * @brief AVX-512, компенсированное накопление: TwoSum в каждой дорожке
+ */
+__attribute__((target("avx512f")))
+static void sumSquaresCompensatedAvx512(const float *x, size_t n, double &sum, double &comp) {
+    __m512d s0 = _mm512_setzero_pd(), c0 = _mm512_setzero_pd();
+    __m512d s1 = _mm512_setzero_pd(), c1 = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512d v0 = widenPs(x + i);
+        __m512d v1 = widenPs(x + i + 8);
+        __m512d y0 = _mm512_mul_pd(v0, v0);
+        __m512d y1 = _mm512_mul_pd(v1, v1);
+        __m512d t0 = _mm512_add_pd(s0, y0);
+        __m512d t1 = _mm512_add_pd(s1, y1);
+        __m512d z0 = _mm512_sub_pd(t0, s0);
+        __m512d z1 = _mm512_sub_pd(t1, s1);
+        c0 = _mm512_add_pd(c0, _mm512_add_pd(_mm512_sub_pd(s0, _mm512_sub_pd(t0, z0)), _mm512_sub_pd(y0, z0)));
+        c1 = _mm512_add_pd(c1, _mm512_add_pd(_mm512_sub_pd(s1, _mm512_sub_pd(t1, z1)), _mm512_sub_pd(y1, z1)));
+        s0 = t0;
+        s1 = t1;
+    }
+    double ls[16], lc[16];
+    _mm512_storeu_pd(ls, s0);
+    _mm512_storeu_pd(ls + 8, s1);
+    _mm512_storeu_pd(lc, c0);
+    _mm512_storeu_pd(lc + 8, c1);
+    for (int k = 0; k < 16; k++) {
+        twoSumAdd(sum, comp, ls[k]);
+        comp += lc[k];
+    }
+    sumSquaresCompensatedScalar(x + i, n - i, sum, comp);
+}
+
+static bool hasSse2() { return __builtin_cpu_supports("sse2"); }
+static bool hasAvx2() { return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"); }
+static bool hasAvx512() { return __builtin_cpu_supports("avx512f"); }
+
+#endif
+
+static bool always() { return true; }
+
+const vector<SumOfSquaresKernel> &sumOfSquaresKernels() {
+    static const vector<SumOfSquaresKernel> kernels = {
+#ifdef VCALC_X86
+        {"avx512", sumSquaresAvx512, sumSquaresDoubleAvx512, sumSquaresCompensatedAvx512, hasAvx512},
+        {"avx2+fma", sumSquaresAvx2, sumSquaresDoubleAvx2, sumSquaresCompensatedAvx2, hasAvx2},
+        // Для режимов double у SSE2 нет выигрыша перед скалярным кодом
+        {"sse2", sumSquaresSse, sumSquaresDoubleScalar, sumSquaresCompensatedScalar, hasSse2},
+#endif
+        {"scalar", sumSquaresScalar, sumSquaresDoubleScalar, sumSquaresCompensatedScalar, always},
+    };
+    return kernels;
+}
+
+/**
+ * @brief Выбирает первую поддерживаемую процессором реализацию
+ */
+static const SumOfSquaresKernel &selectedKernel() {
+    static const SumOfSquaresKernel &kernel = []() -> const SumOfSquaresKernel & {
+#ifdef VCALC_X86
+        __builtin_cpu_init();
+#endif
+        for (const auto &k : sumOfSquaresKernels())
+            if (k.supported()) return k;
+        return sumOfSquaresKernels().back();
+    }();
+    return kernel;
+}
+
+float sumOfSquares(const float *data, size_t n) {
+    return selectedKernel().fn(data, n);
+}
+
+const char *sumOfSquaresImpl() {
+    return selectedKernel().name;
+}
+
+double sumOfSquaresDouble(const float *data, size_t n) {
+    return selectedKernel().fnDouble(data, n);
+}
+
+void sumOfSquaresCompensated(const float *data, size_t n, double &sum, double &comp) {
+    selectedKernel().fnCompensated(data, n, sum, comp);
+}
+
+const char *accumModeName(AccumMode mode) {
+    switch (mode) {
+    case AccumMode::Float: return "float";
+    case AccumMode::Double: return "double";
+    case AccumMode::Compensated: return "kahan";
+    case AccumMode::Pairwise: return "pairwise";
+    }
+    return "?";
+}
+
+AnySquareSum makeSquareSum(AccumMode mode) {
+    switch (mode) {
+    case AccumMode::Double: return SquareSum<AccumMode::Double>();
+    case AccumMode::Compensated: return SquareSum<AccumMode::Compensated>();
+    case AccumMode::Pairwise: return SquareSum<AccumMode::Pairwise>();
+    default: return SquareSum<AccumMode::Float>();
+    }
+}
+
+double sumOfSquares(AccumMode mode, const float *data, size_t n) {
+    AnySquareSum acc = makeSquareSum(mode);
+    return visit([&](auto &s) {
+        for (size_t i = 0; i < n; i += SQUARE_BLOCK) s.add(data + i, min(SQUARE_BLOCK, n - i));
+        return s.result();
+    }, acc);
+}
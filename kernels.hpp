@@ -0,0 +1,149 @@
+/**
+ * @file kernels.hpp
+ * @brief Вычислительные ядра редукции векторов с выбором реализации по CPU
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <variant>
+#include <vector>
+
+/**
+ * @brief Реализация ядра суммы квадратов под конкретный набор инструкций
+ */
+struct SumOfSquaresKernel {
+    const char *name;                               ///< Имя для журнала и тестов
+    float (*fn)(const float *data, size_t n);       ///< Накопление во float
+    double (*fnDouble)(const float *data, size_t n);    ///< Накопление в double
+    /// Компенсированное накопление в double: продолжает сумму sum с поправкой comp
+    void (*fnCompensated)(const float *data, size_t n, double &sum, double &comp);
+    bool (*supported)();                            ///< Поддерживает ли её текущий процессор
+};
+
+/**
+ * @brief Все реализации ядра, от самой быстрой к скалярной
+ *
+ * @details Используется тестами и замерами, чтобы сверить варианты между собой.
+ */
+const std::vector<SumOfSquaresKernel> &sumOfSquaresKernels();
+
+/**
+ * @brief Сумма квадратов элементов непрерывного массива
+ *
+ * @details Вызывает лучшую реализацию для текущего процессора (AVX-512,
+ * AVX2+FMA, SSE или скалярную), выбранную один раз при первом вызове.
+ * Все реализации ведут несколько независимых аккумуляторов, поэтому
+ * порядок сложения отличается от последовательного цикла, и результат
+ * может расходиться с ним в последних разрядах.
+ */
+float sumOfSquares(const float *data, size_t n);
+
+/**
+ * @brief Имя реализации, которую использует sumOfSquares()
+ */
+const char *sumOfSquaresImpl();
+
+/**
+ * @brief Сумма квадратов с накоплением в double
+ *
+ * @details Квадрат float точно представим в double, поэтому ошибка
+ * возникает только при сложении.
+ */
+double sumOfSquaresDouble(const float *data, size_t n);
+
+/**
+ * @brief Компенсированная (Кэхэн-Ноймайер) сумма квадратов
+ *
+ * @details Продолжает сумму sum: ошибка каждого сложения (TwoSum)
+ * копится в comp, итог - sum + comp.
+ */
+void sumOfSquaresCompensated(const float *data, size_t n, double &sum, double &comp);
+
+/// Режим накопления суммы, выбираемый клиентом
+enum class AccumMode : uint8_t {
+    Float = 0,          ///< float, как в исходном протоколе (самый быстрый)
+    Double = 1,         ///< Аккумулятор double
+    Compensated = 2,    ///< Кэхэн-Ноймайер поверх double
+    Pairwise = 3,       ///< Попарное сложение сумм блоков во float
+};
+
+/// Число режимов накопления
+const unsigned ACCUM_MODES = 4;
+
+/// Имя режима для журнала
+const char *accumModeName(AccumMode mode);
+
+/**
+ * @brief Длина блока, которыми элементы подаются накопителю
+ *
+ * @details Сессия передаёт накопителю только целые блоки (кроме
+ * последнего), поэтому результат не зависит от того, какими порциями
+ * данные пришли из сети.
+ */
+const size_t SQUARE_BLOCK = 1024;
+
+/**
+ * @brief Накопитель суммы квадратов, специализированный режимом при компиляции
+ *
+ * @details add() получает очередной блок элементов, result() - итог.
+ * Специализации не проверяют режим во внутреннем цикле, так что режим
+ * Float не платит за остальные.
+ */
+template<AccumMode M> struct SquareSum;
+
+template<> struct SquareSum<AccumMode::Float> {
+    float sum = 0.0f;
+    void add(const float *x, size_t n) { sum += sumOfSquares(x, n); }
+    double result() const { return sum; }
+};
+
+template<> struct SquareSum<AccumMode::Double> {
+    double sum = 0.0;
+    void add(const float *x, size_t n) { sum += sumOfSquaresDouble(x, n); }
+    double result() const { return sum; }
+};
+
+template<> struct SquareSum<AccumMode::Compensated> {
+    double sum = 0.0;
+    double comp = 0.0;
+    void add(const float *x, size_t n) { sumOfSquaresCompensated(x, n, sum, comp); }
+    double result() const { return sum + comp; }
+};
+
+/**
+ * @brief Попарное сложение: суммы блоков складываются деревом
+ *
+ * @details levels[k] - сумма 2^k блоков; состояние как у двоичного
+ * счётчика блоков, поэтому ошибка растёт как log(n), а не n.
+ */
+template<> struct SquareSum<AccumMode::Pairwise> {
+    float levels[64] = {};
+    uint64_t blocks = 0;
+    void add(const float *x, size_t n) {
+        float v = sumOfSquares(x, n);
+        unsigned level = 0;
+        for (uint64_t b = blocks; b & 1; b >>= 1, level++) v = levels[level] + v;
+        levels[level] = v;
+        blocks++;
+    }
+    double result() const {
+        float sum = 0.0f;
+        unsigned level = 0;
+        for (uint64_t b = blocks; b; b >>= 1, level++)
+            if (b & 1) sum = levels[level] + sum;
+        return sum;
+    }
+};
+
+/// Накопитель любого режима; индекс варианта совпадает со значением AccumMode
+using AnySquareSum = std::variant<SquareSum<AccumMode::Float>, SquareSum<AccumMode::Double>,
+                                  SquareSum<AccumMode::Compensated>, SquareSum<AccumMode::Pairwise>>;
+
+/// Создаёт накопитель режима mode
+AnySquareSum makeSquareSum(AccumMode mode);
+
+/**
+ * @brief Сумма квадратов массива в режиме mode (блоками по SQUARE_BLOCK)
+ */
+double sumOfSquares(AccumMode mode, const float *data, size_t n);
@@ -0,0 +1,305 @@
+/**
+ * @file local.cpp
+ * @brief Реализация локального транспорта
+ */
+
+#include "local.hpp"
+#include "shm.hpp"
+#include "jobs.hpp"
+#include "session.hpp"
+#include "server.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+/// Максимальное число событий, забираемых одним вызовом epoll_wait
+static const int MAX_EVENTS = 64;
+
+/// Сообщение аутентификации - первая порция данных клиента, как и по TCP
+static const size_t AUTH_MAX = 255;
+
+/// Наибольшая длина записи ответа
+static const uint32_t RESPONSE_MAX = MAX_VECTOR_RESULTS * 8;
+
+/// Источник события хранится в младшем бите указателя на соединение
+enum : uint64_t { EV_SOCKET = 0, EV_WAKE = 1 };
+
+/**
+ * @brief Локальный клиент
+ */
+struct LocalServer::Conn {
+    int sock = -1;
+    int serverWake = -1;            ///< Клиент пишет сюда, когда сервер спит
+    int clientWake = -1;            ///< Сервер пишет сюда, когда спит клиент
+    unique_ptr<ShmChannel> shm;     ///< Кольца (после аутентификации)
+    string login;
+    uint64_t vectors = 0;           ///< Обработано векторов
+};
+
+LocalServer::LocalServer(int listenSock, const ServerContext &ctx)
+    : epfd(epoll_create1(EPOLL_CLOEXEC)), listenSock(listenSock), ctx(ctx) {
+}
+
+LocalServer::~LocalServer() {
+    while (!conns.empty()) closeConn(*conns.begin());
+    for (Conn *c : closed) delete c;
+    if (epfd >= 0) close(epfd);
+}
+
+int createLocalListener(const string &path) {
+    sockaddr_un addr = {};
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Ошибка: путь Unix-сокета пуст или длиннее %zu символов\n", sizeof(addr.sun_path) - 1);
+        return -1;
+    }
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) {
+        perror("Ошибка Unix-сокета");
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.c_str(), path.size());
+    unlink(path.c_str());
+
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("Ошибка привязки Unix-сокета");
+        close(sock);
+        return -1;
+    }
+    if (listen(sock, SOMAXCONN) < 0) {
+        perror("Ошибка прослушивания Unix-сокета");
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+void LocalServer::acceptClients() {
+    while (true) {
+        int sock = accept4(listenSock, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (sock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE)
+                logMsg(LogLevel::Error, "Ошибка: исчерпан лимит дескрипторов");
+            return;
+        }
+        Conn *c = new Conn;
+        c->sock = sock;
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.u64 = (uintptr_t)c | EV_SOCKET;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, sock, &ev) < 0) {
+            close(sock);
+            delete c;
+            continue;
+        }
+        conns.insert(c);
+        logMsg("Локальный клиент подключен");
+    }
+}
+
+/**
+ * @brief Проверяет сообщение аутентификации и передаёт клиенту кольца
+ * @return false если соединение нужно закрыть
+ */
+bool LocalServer::authenticate(Conn *c) {
+    char buf[AUTH_BINARY_MAX];
+    ssize_t n = recv(c->sock, buf, sizeof(buf), 0);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) return true;
+    if (n <= 0) {
+        logMsg(LogLevel::Error, "Ошибка чтения аутентификации");
+        return false;
+    }
+
+    // Двоичное рукопожатие должно прийти целиком, как и текстовое сообщение
+    string login, salt, hash;
+    AuthRequest request;
+    const uint8_t *frame = (const uint8_t*)buf;
+    if (frame[0] == AUTH_BINARY) {
+        size_t frameLen = n >= (ssize_t)AUTH_BINARY_PREFIX ? authFrameSize(frame) : 0;
+        if (frameLen == 0 || (size_t)n < frameLen) {
+            send(c->sock, "ERR", 3, MSG_NOSIGNAL);
+            logMsg(LogLevel::Error, "Неверное двоичное рукопожатие");
+            return false;
+        }
+        if (frame[1] == AUTH_TICKET) {
+            string_view ticketLogin;
+            request.accepted = ctx.tickets.verify(frame + AUTH_BINARY_PREFIX, frameLen - AUTH_BINARY_PREFIX,
+                                                  time(nullptr), ticketLogin);
+            login.assign(request.accepted ? ticketLogin : "(билет)");
+        } else {
+            request = parseAuthFrame(frame);
+            login.assign(request.login);
+        }
+    } else {
+        string authStr(buf, strnlen(buf, min<size_t>(n, AUTH_MAX)));
+        if (!parseAuthString(authStr, login, salt, hash)) {
+            send(c->sock, "ERR", 3, MSG_NOSIGNAL);
+            logMsg(LogLevel::Error, "Неверный формат аутентификации: " +
+                            (authStr.length() > 50 ? authStr.substr(0, 50) + "..." : authStr));
+            return false;
+        }
+        request.login = login;
+        request.salt = salt;
+        request.hash = hash;
+    }
+    if (frame[0] != AUTH_BINARY || frame[1] != AUTH_TICKET) {
+        AuthRequest *r = &request;
+        checkAuthBatch(&r, 1, *ctx.users.read());
+    }
+    if (!request.accepted) {
+        send(c->sock, "ERR", 3, MSG_NOSIGNAL);
+        logMsg("Аутентификация отклонена: " + login);
+        return false;
+    }
+
+    c->shm = make_unique<ShmChannel>();
+    c->serverWake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    c->clientWake = eventfd(0, EFD_CLOEXEC);
+    if (!c->shm->create(LOCAL_REQUEST_RING, LOCAL_RESPONSE_RING) || c->serverWake < 0 || c->clientWake < 0) {
+        send(c->sock, "ERR", 3, MSG_NOSIGNAL);
+        logMsg(LogLevel::Error, "Ошибка создания общей памяти для " + login);
+        return false;
+    }
+
+    // "OK" и три дескриптора одним сообщением
+    int fds[3] = {c->shm->fd(), c->serverWake, c->clientWake};
+    char ok[2] = {'O', 'K'};
+    iovec iov = {ok, sizeof(ok)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(fds))] = {};
+    msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    cmsghdr *cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cm), fds, sizeof(fds));
+    if (sendmsg(c->sock, &msg, MSG_NOSIGNAL) != sizeof(ok)) {
+        logMsg(LogLevel::Error, "Ошибка отправки колец клиенту " + login);
+        return false;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = (uintptr_t)c | EV_WAKE;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, c->serverWake, &ev) < 0) return false;
+    c->login = login;
+    logMsg("Локальный клиент аутентифицирован: " + login);
+    return true;
+}
+
+/**
+ * @brief Обрабатывает запросы из кольца, пока есть запросы и место для ответов
+ *
+ * @details Перед сном сервер поднимает флаг serverSleeping и ещё раз
+ * проверяет кольца: запрос, опубликованный до подъёма флага, будет
+ * замечен здесь, а после - разбудит сервер через eventfd.
+ * @return false если клиент испортил кольцо запросов
+ */
+bool LocalServer::drain(Conn *c) {
+    ShmControl *ctl = c->shm->control();
+    ShmRing &requests = c->shm->requests();
+    ShmRing &responses = c->shm->responses();
+    while (true) {
+        ctl->serverSleeping.store(0);
+        ShmRing::Status status;
+        uint32_t id, len;
+        const uint8_t *frame;
+        while ((status = requests.peek(id, frame, len)) == ShmRing::Status::Ready) {
+            uint8_t *out = responses.reserve(RESPONSE_MAX);
+            if (!out) break;
+
+            // Вектор считается прямо в общей памяти и освобождается после расчёта
+            VectorHeader hdr;
+            double results[MAX_VECTOR_RESULTS];
+            unsigned count = computeFrame(frame, len, hdr, results);
+            requests.pop();
+            for (unsigned i = 0; i < count; i++) writeLittleEndianDouble(results[i], out + 8 * i);
+            responses.commit(id, count * 8);
+            shmWake(ctl->clientSleeping, c->clientWake);
+            c->vectors++;
+        }
+        if (status == ShmRing::Status::Corrupt) {
+            logMsg(LogLevel::Error, "Испорчено кольцо запросов клиента " + c->login);
+            return false;
+        }
+
+        ctl->serverSleeping.store(1);
+        if (!requests.readable() || !responses.hasRoom(RESPONSE_MAX)) return true;
+    }
+}
+
+void LocalServer::closeConn(Conn *c) {
+    if (c->shm) {
+        logMsg("Локальный клиент отключен: " + c->login + ", векторов: " + to_string(c->vectors));
+    }
+    // Закрытие дескрипторов удаляет их из epoll
+    close(c->sock);
+    if (c->serverWake >= 0) close(c->serverWake);
+    if (c->clientWake >= 0) close(c->clientWake);
+    c->sock = -1;
+    c->shm.reset();
+    conns.erase(c);
+    closed.push_back(c);
+}
+
+bool LocalServer::run() {
+    if (epfd < 0) {
+        perror("Ошибка epoll");
+        return false;
+    }
+    epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u64 = 0;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, listenSock, &ev) < 0) {
+        perror("Ошибка epoll");
+        return false;
+    }
+
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Ошибка epoll");
+            return false;
+        }
+        for (int i = 0; i < n; i++) {
+            uint64_t data = events[i].data.u64;
+            if (data == 0) {
+                acceptClients();
+                continue;
+            }
+            Conn *c = (Conn*)(uintptr_t)(data & ~(uint64_t)1);
+            // Соединение могло быть закрыто событием раньше в этой же пачке
+            if (c->sock < 0) continue;
+
+            bool keep;
+            if ((data & 1) == EV_WAKE) {
+                uint64_t count;
+                read(c->serverWake, &count, sizeof(count));
+                keep = drain(c);
+            } else if (!c->shm) {
+                keep = authenticate(c) && (!c->shm || drain(c));
+            } else {
+                // После аутентификации клиент в сокет не пишет: данные или
+                // обрыв означают конец сессии
+                keep = false;
+            }
+            if (!keep) closeConn(c);
+        }
+        for (Conn *c : closed) delete c;
+        closed.clear();
+    }
+}
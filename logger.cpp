@@ -0,0 +1,246 @@
+/**
+ * @file logger.cpp
+ * @brief Реализация асинхронного журнала
+ */
+
+#include "logger.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <csignal>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+
+using namespace std;
+
+/// Текст в одной записи кольца
+static const size_t LOG_RECORD_TEXT = LOG_RECORD_SIZE - 11;
+
+/// Запись кольца: часть сообщения и его время
+struct LogRecord {
+    int64_t second;         ///< Время сообщения, секунды от эпохи
+    uint16_t len;           ///< Байт в text
+    uint8_t more;           ///< Сообщение продолжается в следующей записи
+    char text[LOG_RECORD_TEXT];
+};
+
+static_assert(sizeof(LogRecord) == LOG_RECORD_SIZE, "запись журнала - ровно LOG_RECORD_SIZE байт");
+
+/**
+ * @brief Кольцо сообщений одного потока
+ *
+ * @details Позиции растут без ограничения, запись с позицией i лежит
+ * в records[i % LOG_RING_RECORDS], как в кольцах общей памяти (shm.hpp).
+ */
+struct LogRing {
+    alignas(64) std::atomic<uint64_t> head{0};      ///< Поток записи прочитал до этой позиции
+    alignas(64) std::atomic<uint64_t> tail{0};      ///< Владелец записал до этой позиции
+    std::atomic<uint64_t> dropped{0};               ///< Отброшено сообщений (пишет владелец)
+    alignas(64) std::atomic<bool> owned{false};     ///< Кольцо занято потоком
+    uint64_t reported = 0;                          ///< Сколько отброшенных уже отмечено в журнале
+    LogRing *next = nullptr;                        ///< Следующее кольцо списка (не меняется)
+    LogRecord records[LOG_RING_RECORDS];
+};
+
+/// Все кольца процесса: только добавляются, освобождённые переходят к новым потокам
+static atomic<LogRing*> rings{nullptr};
+
+static atomic<Logger*> active{nullptr};
+static atomic<uint8_t> maxLevel{(uint8_t)LogLevel::Debug};
+static atomic<uint8_t> overflowPolicy{(uint8_t)LogOverflow::Drop};
+
+/**
+ * @brief Кольцо текущего потока; при завершении потока возвращается в список
+ */
+struct RingOwner {
+    LogRing *ring = nullptr;
+    ~RingOwner() {
+        if (ring) ring->owned.store(false, memory_order_release);
+    }
+};
+
+static thread_local RingOwner owner;
+
+/**
+ * @brief Занимает свободное кольцо или добавляет новое
+ */
+static LogRing *acquireRing() {
+    for (LogRing *r = rings.load(memory_order_acquire); r; r = r->next) {
+        bool expected = false;
+        if (!r->owned.load(memory_order_relaxed) &&
+            r->owned.compare_exchange_strong(expected, true, memory_order_acquire)) return r;
+    }
+    LogRing *r = new LogRing;
+    r->owned.store(true, memory_order_relaxed);
+    r->next = rings.load(memory_order_relaxed);
+    while (!rings.compare_exchange_weak(r->next, r, memory_order_release, memory_order_relaxed)) {}
+    return r;
+}
+
+Logger::Logger(const string &file, LogLevel level, LogOverflow overflow) {
+    fd = open(file.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) return;
+    maxLevel.store((uint8_t)level, memory_order_relaxed);
+    overflowPolicy.store((uint8_t)overflow, memory_order_relaxed);
+    writer = thread([this]() { writerLoop(); });
+    active.store(this, memory_order_release);
+}
+
+Logger::~Logger() {
+    if (fd < 0) return;
+    Logger *self = this;
+    active.compare_exchange_strong(self, nullptr);
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    writer.join();
+    close(fd);
+}
+
+void Logger::flush() {
+    if (fd < 0) return;
+    unique_lock<mutex> lock(sleepMutex);
+    // Проход, идущий сейчас, мог начаться до вызова: ждём ещё один
+    uint64_t target = passes + 2;
+    flushTarget = max(flushTarget, target);
+    wake.notify_one();
+    written.wait(lock, [&]() { return passes >= target || stopping; });
+}
+
+void Logger::writerLoop() {
+    // Сигналы принимают потоки сервера: поток записи создаётся раньше,
+    // чем они блокируются, и не должен завершать процесс вместо них
+    sigset_t all;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, nullptr);
+
+    string out;
+    out.reserve(1 << 16);
+    unique_lock<mutex> lock(sleepMutex);
+    while (true) {
+        bool stop = stopping;
+        lock.unlock();
+        size_t lines = drain(out);
+        lock.lock();
+        passes++;
+        written.notify_all();
+        // Остановка замечена до прохода: он дописал всё, что было отправлено
+        if (stop) break;
+        if (lines == 0 && !stopping && passes >= flushTarget) wake.wait_for(lock, chrono::milliseconds(10));
+    }
+}
+
+/**
+ * @brief Переносит сообщения из всех колец в файл
+ * @return Число записанных строк
+ */
+size_t Logger::drain(string &out) {
+    size_t lines = 0;
+    for (LogRing *r = rings.load(memory_order_acquire); r; r = r->next) {
+        uint64_t dropped = r->dropped.load(memory_order_relaxed);
+        if (dropped != r->reported) {
+            appendStamp(time(nullptr), out);
+            out += "Журнал переполнен: пропущено сообщений: " + to_string(dropped - r->reported) + "\n";
+            r->reported = dropped;
+            lines++;
+        }
+        uint64_t head = r->head.load(memory_order_relaxed);
+        uint64_t tail = r->tail.load(memory_order_acquire);
+        while (head < tail) {
+            const LogRecord *rec = &r->records[head++ % LOG_RING_RECORDS];
+            appendStamp(rec->second, out);
+            out.append(rec->text, rec->len);
+            // Продолжения опубликованы вместе с началом сообщения
+            while (rec->more && head < tail) {
+                rec = &r->records[head++ % LOG_RING_RECORDS];
+                out.append(rec->text, rec->len);
+            }
+            out += '\n';
+            lines++;
+            if (out.size() >= (1 << 16)) writeOut(out);
+        }
+        r->head.store(head, memory_order_release);
+    }
+    writeOut(out);
+    return lines;
+}
+
+void Logger::appendStamp(int64_t second, string &out) {
+    if (second != stampSecond) {
+        time_t t = second;
+        tm tmBuf;
+        localtime_r(&t, &tmBuf);
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S | ", &tmBuf);
+        stampSecond = second;
+    }
+    out += stamp;
+}
+
+void Logger::writeOut(string &out) {
+    size_t sent = 0;
+    while (sent < out.size()) {
+        ssize_t n = write(fd, out.data() + sent, out.size() - sent);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;      // Диск заполнен или файл недоступен: строки теряются
+        sent += n;
+    }
+    out.clear();
+}
+
+void logMsg(string_view msg) {
+    logMsg(LogLevel::Info, msg);
+}
+
+void logMsg(LogLevel level, string_view msg) {
+    Logger *logger = active.load(memory_order_acquire);
+    if (!logger || (uint8_t)level > maxLevel.load(memory_order_relaxed)) return;
+    if (!owner.ring) owner.ring = acquireRing();
+    LogRing &r = *owner.ring;
+
+    size_t count = min(LOG_MESSAGE_RECORDS, max<size_t>(1, (msg.size() + LOG_RECORD_TEXT - 1) / LOG_RECORD_TEXT));
+    uint64_t tail = r.tail.load(memory_order_relaxed);
+    while (tail + count - r.head.load(memory_order_acquire) > LOG_RING_RECORDS) {
+        if (overflowPolicy.load(memory_order_relaxed) == (uint8_t)LogOverflow::Drop) {
+            r.dropped.store(r.dropped.load(memory_order_relaxed) + 1, memory_order_relaxed);
+            return;
+        }
+        logger->wake.notify_one();
+        this_thread::sleep_for(chrono::microseconds(100));
+    }
+
+    // Грубые часы читаются без системного вызова; точнее секунды не нужно
+    timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    for (size_t i = 0; i < count; i++) {
+        LogRecord &rec = r.records[(tail + i) % LOG_RING_RECORDS];
+        size_t offset = i * LOG_RECORD_TEXT;
+        size_t len = min(LOG_RECORD_TEXT, msg.size() - min(offset, msg.size()));
+        rec.second = now.tv_sec;
+        rec.len = (uint16_t)len;
+        rec.more = i + 1 < count;
+        memcpy(rec.text, msg.data() + offset, len);
+    }
+    r.tail.store(tail + count, memory_order_release);
+}
+
+bool logEnabled(LogLevel level) {
+    return active.load(memory_order_relaxed) && (uint8_t)level <= maxLevel.load(memory_order_relaxed);
+}
+
+void logFlush() {
+    Logger *logger = active.load(memory_order_acquire);
+    if (logger) logger->flush();
+}
+
+bool parseLogLevel(const string &name, LogLevel &level) {
+    if (name == "error") level = LogLevel::Error;
+    else if (name == "info") level = LogLevel::Info;
+    else if (name == "debug") level = LogLevel::Debug;
+    else return false;
+    return true;
+}
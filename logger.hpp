@@ -0,0 +1,136 @@
+/**
+ * @file logger.hpp
+ * @brief Асинхронный журнал сервера: кольца потоков и поток записи
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+
+/// Уровень сообщения журнала: пишутся сообщения не выше заданного уровня
+enum class LogLevel : uint8_t {
+    Error = 0,      ///< Ошибки
+    Info = 1,       ///< Подключения, аутентификация, задания
+    Debug = 2,      ///< Результат каждого вектора и задания с номером
+};
+
+/// Что делать, если кольцо потока заполнено
+enum class LogOverflow : uint8_t {
+    Drop,           ///< Отбросить сообщение (число пропущенных попадёт в журнал)
+    Block,          ///< Ждать, пока поток записи освободит место
+};
+
+/// Длина записи кольца журнала, байт
+const size_t LOG_RECORD_SIZE = 256;
+
+/// Записей в кольце одного потока
+const size_t LOG_RING_RECORDS = 1024;
+
+/// Наибольшее число записей на одно сообщение (длиннее - обрезается)
+const size_t LOG_MESSAGE_RECORDS = 16;
+
+/**
+ * @brief Журнал сервера с записью в отдельном потоке
+ *
+ * @details logMsg() не открывает файл и не форматирует время: сообщение
+ * копируется в записи фиксированной длины в кольцо вызывающего потока
+ * (один писатель и один читатель, без блокировок), с временем в секундах
+ * (CLOCK_REALTIME_COARSE). Длинное сообщение занимает несколько записей
+ * подряд. Кольцо выдаётся потоку при первом сообщении и возвращается
+ * в общий список, когда поток завершается.
+ *
+ * Поток записи обходит кольца, форматирует строки
+ * "ГГГГ-ММ-ДД чч:мм:сс | сообщение" (localtime_r - раз в секунду,
+ * отметка времени кэшируется) и пишет их пачкой одним write() в файл,
+ * открытый с O_APPEND. Простаивая, он спит до 10 мс. Сообщения одного
+ * потока идут в журнал по порядку; сообщения разных потоков - в порядке
+ * обхода колец.
+ *
+ * Если кольцо заполнено, сообщение отбрасывается (LogOverflow::Drop,
+ * поток записи потом отметит в журнале, сколько пропущено) или поток
+ * ждёт места (LogOverflow::Block). Уровень LogLevel::Info выключает
+ * строки о каждом векторе.
+ *
+ * В процессе одновременно существует не больше одного журнала; без него
+ * (или если файл не открылся) logMsg() ничего не делает. Деструктор
+ * дописывает всё, что успели отправить; вызывать его после остановки
+ * потоков, которые пишут в журнал.
+ */
+class Logger {
+public:
+    /**
+     * @param file Путь к файлу журнала (дописывается)
+     * @param level Наибольший записываемый уровень
+     * @param overflow Поведение при заполненном кольце
+     */
+    Logger(const std::string &file, LogLevel level = LogLevel::Debug, LogOverflow overflow = LogOverflow::Drop);
+    ~Logger();
+
+    Logger(const Logger &) = delete;
+    Logger &operator=(const Logger &) = delete;
+
+    /// Файл журнала открыт
+    bool opened() const { return fd >= 0; }
+
+    /**
+     * @brief Ждёт, пока всё отправленное до вызова будет записано в файл
+     */
+    void flush();
+
+private:
+    friend void logMsg(LogLevel level, std::string_view msg);
+
+    void writerLoop();
+    size_t drain(std::string &out);
+    void appendStamp(int64_t second, std::string &out);
+    void writeOut(std::string &out);
+
+    int fd;
+    std::thread writer;
+    std::mutex sleepMutex;
+    std::condition_variable wake;           ///< Будит поток записи (flush, заполненное кольцо)
+    std::condition_variable written;        ///< Поток записи закончил проход
+    uint64_t passes = 0;                    ///< Законченных проходов по кольцам
+    uint64_t flushTarget = 0;               ///< Не спать, пока passes меньше
+    bool stopping = false;
+
+    // Кэш отметки времени: localtime_r вызывается раз в секунду
+    int64_t stampSecond = -1;
+    char stamp[32];
+};
+
+/**
+ * @brief Пишет сообщение уровня LogLevel::Info в журнал
+ * @param msg Текст сообщения
+ */
+void logMsg(std::string_view msg);
+
+/**
+ * @brief Пишет сообщение заданного уровня в журнал
+ */
+void logMsg(LogLevel level, std::string_view msg);
+
+/**
+ * @brief Будет ли записано сообщение уровня level
+ *
+ * @details Проверяется перед тем, как собирать частое сообщение, чтобы
+ * не форматировать то, что не попадёт в журнал.
+ */
+bool logEnabled(LogLevel level);
+
+/**
+ * @brief Дописывает журнал процесса (перед завершением по сигналу)
+ */
+void logFlush();
+
+/**
+ * @brief Разбирает имя уровня: error, info или debug
+ * @return false если имя неизвестно
+ */
+bool parseLogLevel(const std::string &name, LogLevel &level);
@@ -0,0 +1,484 @@
+/**
+ * @file ops.cpp
+ * @brief Реестр операций и совместное ядро редукции
+ *
+ * @details Ядро написано один раз на векторных расширениях GCC
+ * (vector_size) и шаблонно по ширине регистра и набору статистик.
+ * Обёртки с атрибутом target встраивают его под AVX-512 и AVX2, а
+ * обобщённый вариант (ширина 4) компилятор переводит в SSE2 или в
+ * инструкции другой архитектуры. Вариант, как и в kernels.cpp,
+ * выбирается по cpuid один раз.
+ */
+
+#include "ops.hpp"
+#include "kernels.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VCALC_X86 1
+#endif
+
+using namespace std;
+
+/// Тип ядра одной комбинации статистик
+typedef void (*FusedFn)(const uint8_t *x, const uint8_t *y, size_t n, Moments &m, bool m2);
+
+typedef float Float2 __attribute__((vector_size(8)));
+typedef double Double2 __attribute__((vector_size(16)));
+typedef double Double4 __attribute__((vector_size(32)));
+typedef double Double8 __attribute__((vector_size(64)));
+
+/**
+ * @brief Число половинной точности (IEEE binary16) в float
+ */
+static inline float halfToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exp = (h >> 10) & 0x1F, mant = h & 0x3FF;
+    uint32_t bits;
+    if (exp == 0x1F) {
+        bits = sign | 0x7F800000 | (mant << 13);
+    } else if (exp != 0) {
+        bits = sign | ((exp + 112) << 23) | (mant << 13);
+    } else {
+        // Ноль или денормализованное: mant * 2^-24 точно представимо во float
+        float f = mant * 0x1p-24f;
+        return sign ? -f : f;
+    }
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+/**
+ * @brief Хранение элемента типа E и его значение (без масштаба)
+ */
+template<ElemType E> struct Elem;
+template<> struct Elem<ElemType::F32> { typedef float T; static double value(T v) { return v; } };
+template<> struct Elem<ElemType::F64> { typedef double T; static double value(T v) { return v; } };
+template<> struct Elem<ElemType::F16> { typedef uint16_t T; static double value(T v) { return halfToFloat(v); } };
+template<> struct Elem<ElemType::BF16> {
+    typedef uint16_t T;
+    static double value(T v) {
+        uint32_t bits = (uint32_t)v << 16;
+        float f;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+    }
+};
+template<> struct Elem<ElemType::I8> { typedef int8_t T; static double value(T v) { return v; } };
+template<> struct Elem<ElemType::I16> { typedef int16_t T; static double value(T v) { return v; } };
+template<> struct Elem<ElemType::I32> { typedef int32_t T; static double value(T v) { return v; } };
+
+/// i-й элемент типа E из невыровненных байтов, в double
+template<ElemType E>
+static inline double elemAt(const uint8_t *p, size_t i) {
+    typename Elem<E>::T v;
+    memcpy(&v, p + i * sizeof(v), sizeof(v));
+    return Elem<E>::value(v);
+}
+
+/**
+ * @brief Регистры ширины W: D - W/2 элементов в double
+ *
+ * @details За итерацию ядро берёт W элементов и переводит их в две
+ * половины D прямо из байтов сообщения (half()): узкие типы
+ * расширяются в регистрах, и расширенная копия вектора в памяти не
+ * создаётся. На x86 это одна-две инструкции на половину, чего GCC
+ * не делает сам для __builtin_convertvector.
+ */
+template<int W> struct Lanes;
+
+template<> struct Lanes<4> {
+    typedef Double2 D;
+    template<ElemType E>
+    static inline void half(const uint8_t *p, D &out) {
+        if constexpr (E == ElemType::F32) {
+            Float2 a;
+            memcpy(&a, p, sizeof(a));
+            out = __builtin_convertvector(a, D);
+        } else if constexpr (E == ElemType::F64) {
+            memcpy(&out, p, sizeof(out));
+        } else {
+            out = D{elemAt<E>(p, 0), elemAt<E>(p, 1)};
+        }
+    }
+};
+
+#ifdef VCALC_X86
+
+template<> struct Lanes<8> {
+    typedef Double4 D;
+    template<ElemType E>
+    __attribute__((target("avx2,fma,f16c")))
+    static inline void half(const uint8_t *p, D &out) {
+        const __m128i *q = (const __m128i*)p;
+        if constexpr (E == ElemType::F32) {
+            out = (D)_mm256_cvtps_pd(_mm_loadu_ps((const float*)p));
+        } else if constexpr (E == ElemType::F64) {
+            out = (D)_mm256_loadu_pd((const double*)p);
+        } else if constexpr (E == ElemType::F16) {
+            out = (D)_mm256_cvtps_pd(_mm_cvtph_ps(_mm_loadl_epi64(q)));
+        } else if constexpr (E == ElemType::BF16) {
+            __m128i bits = _mm_slli_epi32(_mm_cvtepu16_epi32(_mm_loadl_epi64(q)), 16);
+            out = (D)_mm256_cvtps_pd(_mm_castsi128_ps(bits));
+        } else if constexpr (E == ElemType::I8) {
+            int32_t raw;
+            memcpy(&raw, p, sizeof(raw));
+            out = (D)_mm256_cvtepi32_pd(_mm_cvtepi8_epi32(_mm_cvtsi32_si128(raw)));
+        } else if constexpr (E == ElemType::I16) {
+            out = (D)_mm256_cvtepi32_pd(_mm_cvtepi16_epi32(_mm_loadl_epi64(q)));
+        } else {
+            out = (D)_mm256_cvtepi32_pd(_mm_loadu_si128(q));
+        }
+    }
+};
+
+template<> struct Lanes<16> {
+    typedef Double8 D;
+    // maskz-варианты: у _mm512_cvtps_pd в GCC 12 ложное -Wmaybe-uninitialized
+    template<ElemType E>
+    __attribute__((target("avx512f,f16c")))
+    static inline void half(const uint8_t *p, D &out) {
+        const __m128i *q = (const __m128i*)p;
+        if constexpr (E == ElemType::F32) {
+            out = (D)_mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps((const float*)p));
+        } else if constexpr (E == ElemType::F64) {
+            out = (D)_mm512_loadu_pd(p);
+        } else if constexpr (E == ElemType::F16) {
+            out = (D)_mm512_maskz_cvtps_pd(0xFF, _mm256_cvtph_ps(_mm_loadu_si128(q)));
+        } else if constexpr (E == ElemType::BF16) {
+            __m256i bits = _mm256_slli_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128(q)), 16);
+            out = (D)_mm512_maskz_cvtps_pd(0xFF, _mm256_castsi256_ps(bits));
+        } else if constexpr (E == ElemType::I8) {
+            out = (D)_mm512_maskz_cvtepi32_pd(0xFF, _mm256_cvtepi8_epi32(_mm_loadl_epi64(q)));
+        } else if constexpr (E == ElemType::I16) {
+            out = (D)_mm512_maskz_cvtepi32_pd(0xFF, _mm256_cvtepi16_epi32(_mm_loadu_si128(q)));
+        } else {
+            out = (D)_mm512_maskz_cvtepi32_pd(0xFF, _mm256_loadu_si256((const __m256i*)p));
+        }
+    }
+};
+
+#endif
+
+/**
+ * @brief Совместное ядро: статистики Need блока x (и y) типа E за один проход
+ *
+ * @details Значения копятся в дорожках double, по регистру на каждую
+ * половину W элементов; хвост короче W считается скалярно. Сумма
+ * квадратов отклонений требует среднего блока, поэтому для NEED_M2
+ * блок читается второй раз, но уже из кэша (флаг withM2, а не
+ * специализация: второй проход - отдельный цикл). Обёртки с атрибутом
+ * flatten встраивают его вместе с half() под свой target, который и
+ * определяет набор инструкций.
+ */
+template<ElemType E, int W, unsigned Need>
+static inline void fusedBody(const uint8_t *x, const uint8_t *y, size_t n, Moments &m, bool withM2) {
+    typedef typename Lanes<W>::D D;
+    const int HW = W / 2;
+    const size_t size = sizeof(typename Elem<E>::T);
+    const double inf = numeric_limits<double>::infinity();
+    if (n == 0) return;
+
+    D sumsq0 = {}, sumsq1 = {}, sumabs0 = {}, sumabs1 = {};
+    D sum0 = {}, sum1 = {}, dot0 = {}, dot1 = {};
+    D min0 = D{} + inf, min1 = min0, max0 = D{} - inf, max1 = max0, maxabs0 = {}, maxabs1 = {};
+    size_t i = 0;
+    for (; i + W <= n; i += W) {
+        D lo, hi;
+        Lanes<W>::template half<E>(x + i * size, lo);
+        Lanes<W>::template half<E>(x + (i + HW) * size, hi);
+        if constexpr (Need & NEED_SUMSQ) {
+            sumsq0 += lo * lo;
+            sumsq1 += hi * hi;
+        }
+        if constexpr (Need & NEED_MAGNITUDE) {
+            D alo = lo < 0 ? -lo : lo, ahi = hi < 0 ? -hi : hi;
+            sumabs0 += alo;
+            sumabs1 += ahi;
+            min0 = lo < min0 ? lo : min0;
+            min1 = hi < min1 ? hi : min1;
+            max0 = lo > max0 ? lo : max0;
+            max1 = hi > max1 ? hi : max1;
+            maxabs0 = alo > maxabs0 ? alo : maxabs0;
+            maxabs1 = ahi > maxabs1 ? ahi : maxabs1;
+        }
+        if constexpr (Need & NEED_MEAN) {
+            sum0 += lo;
+            sum1 += hi;
+        }
+        if constexpr (Need & NEED_DOT) {
+            D ylo, yhi;
+            Lanes<W>::template half<E>(y + i * size, ylo);
+            Lanes<W>::template half<E>(y + (i + HW) * size, yhi);
+            dot0 += lo * ylo;
+            dot1 += hi * yhi;
+        }
+    }
+
+    double sumsq = 0.0, sumabs = 0.0, sum = 0.0, dot = 0.0;
+    double lo = inf, hi = -inf, amax = 0.0;
+    for (int k = 0; k < HW; k++) {
+        sumsq += sumsq0[k] + sumsq1[k];
+        sumabs += sumabs0[k] + sumabs1[k];
+        sum += sum0[k] + sum1[k];
+        dot += dot0[k] + dot1[k];
+        lo = min(lo, min(min0[k], min1[k]));
+        hi = max(hi, max(max0[k], max1[k]));
+        amax = max(amax, max(maxabs0[k], maxabs1[k]));
+    }
+    for (; i < n; i++) {
+        double d = elemAt<E>(x, i), a = fabs(d);
+        sumsq += d * d;
+        sumabs += a;
+        sum += d;
+        if (d < lo) lo = d;
+        if (d > hi) hi = d;
+        if (a > amax) amax = a;
+        if constexpr (Need & NEED_DOT) dot += d * elemAt<E>(y, i);
+    }
+
+    if constexpr (Need & NEED_SUMSQ) m.sumsq += sumsq;
+    if constexpr (Need & NEED_DOT) m.dot += dot;
+    if constexpr (Need & NEED_MAGNITUDE) {
+        m.sumabs += sumabs;
+        m.min = min(m.min, lo);
+        m.max = max(m.max, hi);
+        m.maxabs = max(m.maxabs, amax);
+    }
+    if constexpr (Need & NEED_MEAN) {
+        double mean = sum / n;
+        double m2 = 0.0;
+        if (withM2) {
+            D vmean = D{} + mean, m2a = {}, m2b = {};
+            size_t j = 0;
+            for (; j + W <= n; j += W) {
+                D lo, hi;
+                Lanes<W>::template half<E>(x + j * size, lo);
+                Lanes<W>::template half<E>(x + (j + HW) * size, hi);
+                lo -= vmean;
+                hi -= vmean;
+                m2a += lo * lo;
+                m2b += hi * hi;
+            }
+            for (int k = 0; k < HW; k++) m2 += m2a[k] + m2b[k];
+            for (; j < n; j++) {
+                double d = elemAt<E>(x, j) - mean;
+                m2 += d * d;
+            }
+        }
+        // Объединение со статистиками предыдущих блоков (Чан и др.)
+        double total = (double)(m.count + n);
+        double delta = mean - m.mean;
+        m.mean += delta * (n / total);
+        m.m2 += m2 + delta * delta * (m.count * (n / total));
+    }
+    m.count += n;
+}
+
+/// Номер ядра в таблице: тип элементов и набор статистик
+static inline unsigned kernelIndex(ElemType type, unsigned needs) {
+    return (unsigned)type * OP_NEED_COMBINATIONS + needs;
+}
+
+/**
+ * @brief Обобщённая реализация: ширина 4 (SSE2 на x86)
+ */
+struct FusedGeneric {
+    template<unsigned K>
+    __attribute__((flatten))
+    static void run(const uint8_t *x, const uint8_t *y, size_t n, Moments &m, bool m2) {
+        fusedBody<(ElemType)(K / OP_NEED_COMBINATIONS), 4, K % OP_NEED_COMBINATIONS>(x, y, n, m, m2);
+    }
+};
+
+#ifdef VCALC_X86
+
+struct FusedAvx2 {
+    template<unsigned K>
+    __attribute__((target("avx2,fma,f16c"), flatten))
+    static void run(const uint8_t *x, const uint8_t *y, size_t n, Moments &m, bool m2) {
+        fusedBody<(ElemType)(K / OP_NEED_COMBINATIONS), 8, K % OP_NEED_COMBINATIONS>(x, y, n, m, m2);
+    }
+};
+
+struct FusedAvx512 {
+    template<unsigned K>
+    __attribute__((target("avx512f,f16c"), flatten))
+    static void run(const uint8_t *x, const uint8_t *y, size_t n, Moments &m, bool m2) {
+        fusedBody<(ElemType)(K / OP_NEED_COMBINATIONS), 16, K % OP_NEED_COMBINATIONS>(x, y, n, m, m2);
+    }
+};
+
+static bool hasAvx2() {
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c");
+}
+static bool hasAvx512() { return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("f16c"); }
+
+#endif
+
+static bool always() { return true; }
+
+/// Таблица специализаций ядра по всем типам элементов и комбинациям статистик
+template<class Impl, size_t... K>
+static constexpr array<FusedFn, sizeof...(K)> makeTable(index_sequence<K...>) {
+    return {{&Impl::template run<K>...}};
+}
+
+template<class Impl>
+static const FusedFn *fusedTable() {
+    static constexpr auto table = makeTable<Impl>(make_index_sequence<ELEM_TYPES * OP_NEED_COMBINATIONS>());
+    return table.data();
+}
+
+const vector<FusedKernelSet> &fusedKernelSets() {
+    static const vector<FusedKernelSet> sets = {
+#ifdef VCALC_X86
+        {"avx512", fusedTable<FusedAvx512>(), hasAvx512},
+        {"avx2+fma", fusedTable<FusedAvx2>(), hasAvx2},
+#endif
+        {"generic", fusedTable<FusedGeneric>(), always},
+    };
+    return sets;
+}
+
+/**
+ * @brief Выбирает первую поддерживаемую процессором реализацию
+ */
+static const FusedKernelSet &selectedSet() {
+    static const FusedKernelSet &set = []() -> const FusedKernelSet & {
+#ifdef VCALC_X86
+        __builtin_cpu_init();
+#endif
+        for (const auto &s : fusedKernelSets())
+            if (s.supported()) return s;
+        return fusedKernelSets().back();
+    }();
+    return set;
+}
+
+const char *fusedKernelImpl() {
+    return selectedSet().name;
+}
+
+/// Значение операции, не определённой для пустого вектора
+static double undefinedIfEmpty(const Moments &m, double value) {
+    return m.count ? value : numeric_limits<double>::quiet_NaN();
+}
+
+const vector<VectorOpInfo> &vectorOps() {
+    static const vector<VectorOpInfo> ops = {
+        {OP_SUMSQ, "sumsq", NEED_SUMSQ, [](const Moments &m) { return m.sumsq; }},
+        {OP_L1, "l1", NEED_MAGNITUDE, [](const Moments &m) { return m.sumabs; }},
+        {OP_L2, "l2", NEED_SUMSQ, [](const Moments &m) { return sqrt(m.sumsq); }},
+        {OP_LINF, "linf", NEED_MAGNITUDE, [](const Moments &m) { return m.maxabs; }},
+        {OP_MEAN, "mean", NEED_MEAN, [](const Moments &m) { return undefinedIfEmpty(m, m.mean); }},
+        {OP_VARIANCE, "variance", NEED_MEAN | NEED_M2,
+            [](const Moments &m) { return undefinedIfEmpty(m, m.m2 / m.count); }},
+        {OP_MIN, "min", NEED_MAGNITUDE, [](const Moments &m) { return undefinedIfEmpty(m, m.min); }},
+        {OP_MAX, "max", NEED_MAGNITUDE, [](const Moments &m) { return undefinedIfEmpty(m, m.max); }},
+        {OP_DOT, "dot", NEED_DOT, [](const Moments &m) { return m.dot; }},
+    };
+    return ops;
+}
+
+unsigned opCount(uint16_t ops) {
+    return __builtin_popcount(ops & OP_ALL);
+}
+
+string opNames(uint16_t ops) {
+    string names;
+    for (const auto &op : vectorOps()) {
+        if (!(ops & op.op)) continue;
+        if (!names.empty()) names += ",";
+        names += op.name;
+    }
+    return names;
+}
+
+size_t elemTypeSize(ElemType type) {
+    switch (type) {
+    case ElemType::F64: return 8;
+    case ElemType::F16: case ElemType::BF16: case ElemType::I16: return 2;
+    case ElemType::I8: return 1;
+    default: return 4;
+    }
+}
+
+const char *elemTypeName(ElemType type) {
+    switch (type) {
+    case ElemType::F32: return "f32";
+    case ElemType::F64: return "f64";
+    case ElemType::F16: return "f16";
+    case ElemType::BF16: return "bf16";
+    case ElemType::I8: return "i8";
+    case ElemType::I16: return "i16";
+    case ElemType::I32: return "i32";
+    }
+    return "?";
+}
+
+/// Ядро для неизвестного типа элементов: ничего не накапливает
+static void skipElements(const uint8_t *, const uint8_t *, size_t, Moments &, bool) {
+}
+
+FusedReduction::FusedReduction(uint16_t ops, ElemType type, double scale, const FusedKernelSet *set)
+    : ops(ops & OP_ALL), size(elemTypeSize(type)), scale(scale) {
+    // Тип мог прийти с провода: номер вне таблицы ядер не используется как индекс
+    if ((unsigned)type >= ELEM_TYPES) {
+        this->ops = 0;
+        m2 = false;
+        kernel = skipElements;
+        return;
+    }
+    unsigned needs = 0;
+    for (const auto &op : vectorOps())
+        if (this->ops & op.op) needs |= op.needs;
+    m2 = needs & NEED_M2;
+    kernel = (set ? *set : selectedSet()).kernels[kernelIndex(type, needs & ~NEED_M2)];
+}
+
+void FusedReduction::addZeros(uint64_t count) {
+    if (count == 0) return;
+    // Блок нулей: среднее 0 и нулевой разброс (формула Чана, как в ядре)
+    double total = (double)(m.count + count);
+    double delta = -m.mean;
+    m.mean += delta * (count / total);
+    m.m2 += delta * delta * (m.count * (count / total));
+    m.count += count;
+    m.min = min(m.min, 0.0);
+    m.max = max(m.max, 0.0);
+}
+
+unsigned FusedReduction::results(double *out) const {
+    // Статистики копились без масштаба: переводим их в значения элементов
+    Moments s = m;
+    double a = fabs(scale);
+    s.sumsq *= scale * scale;
+    s.sumabs *= a;
+    s.dot *= scale * scale;
+    s.mean *= scale;
+    s.m2 *= scale * scale;
+    s.maxabs *= a;
+    s.min = (scale < 0 ? m.max : m.min) * scale;
+    s.max = (scale < 0 ? m.min : m.max) * scale;
+
+    unsigned k = 0;
+    for (const auto &op : vectorOps())
+        if (ops & op.op) out[k++] = op.result(s);
+    return k;
+}
+
+vector<double> reduceOps(uint16_t ops, const float *x, const float *y, size_t n) {
+    FusedReduction fused(ops);
+    for (size_t i = 0; i < n; i += SQUARE_BLOCK)
+        fused.add(x + i, y ? y + i : nullptr, min(SQUARE_BLOCK, n - i));
+    vector<double> out(opCount(ops));
+    fused.results(out.data());
+    return out;
+}
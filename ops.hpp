@@ -0,0 +1,225 @@
+/**
+ * @file ops.hpp
+ * @brief Реестр операций над вектором и их совместная редукция за один проход
+ *
+ * @details Клиент выбирает операции битовой маской (поле ops расширенного
+ * заголовка). Каждой операции нужны одни и те же немногие статистики
+ * (сумма квадратов, сумма модулей, экстремумы, среднее и сумма квадратов
+ * отклонений, скалярное произведение), поэтому все выбранные операции
+ * считаются одним ядром за один проход по данным: ядро - шаблон,
+ * специализированный типом элементов и набором нужных групп
+ * статистик, так что неиспользуемые группы не стоят ничего во
+ * внутреннем цикле.
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+/// Операции над вектором; значение - бит в маске ops
+enum VectorOp : uint16_t {
+    OP_SUMSQ = 1 << 0,      ///< Сумма квадратов (операция исходного протокола)
+    OP_L1 = 1 << 1,         ///< Сумма модулей
+    OP_L2 = 1 << 2,         ///< Евклидова норма
+    OP_LINF = 1 << 3,       ///< Максимум модуля
+    OP_MEAN = 1 << 4,       ///< Среднее
+    OP_VARIANCE = 1 << 5,   ///< Дисперсия (генеральная, делитель n)
+    OP_MIN = 1 << 6,        ///< Минимум
+    OP_MAX = 1 << 7,        ///< Максимум
+    OP_DOT = 1 << 8,        ///< Скалярное произведение со вторым вектором
+};
+
+/// Маска всех известных операций
+const uint16_t OP_ALL = 0x1FF;
+
+/// Наибольшее число результатов одного вектора (по биту маски на операцию)
+const unsigned MAX_VECTOR_RESULTS = 16;
+
+/**
+ * @brief Тип элементов вектора на проводе (little-endian)
+ *
+ * @details Целые типы и половинная точность вместе с масштабом вектора
+ * сокращают трафик в 2-4 раза: значение элемента - raw * scale.
+ */
+enum class ElemType : uint8_t {
+    F32 = 0,    ///< float, как в исходном протоколе
+    F64 = 1,    ///< double
+    F16 = 2,    ///< IEEE binary16
+    BF16 = 3,   ///< bfloat16 (старшие 16 бит float)
+    I8 = 4,     ///< int8
+    I16 = 5,    ///< int16
+    I32 = 6,    ///< int32
+};
+
+/// Число типов элементов
+const unsigned ELEM_TYPES = 7;
+
+/// Размер элемента в байтах
+size_t elemTypeSize(ElemType type);
+
+/// Имя типа для журнала
+const char *elemTypeName(ElemType type);
+
+/**
+ * @brief Статистики, которые ядро накапливает за проход
+ */
+enum OpNeed : unsigned {
+    NEED_SUMSQ = 1 << 0,        ///< Сумма квадратов
+    NEED_MAGNITUDE = 1 << 1,    ///< Сумма модулей, минимум, максимум и максимум модуля
+    NEED_MEAN = 1 << 2,         ///< Число элементов и среднее
+    NEED_DOT = 1 << 3,          ///< Сумма попарных произведений
+    /// Сумма квадратов отклонений от среднего (второй проход по блоку;
+    /// выбирается флагом ядра, а не специализацией)
+    NEED_M2 = 1 << 4,
+};
+
+/**
+ * @brief Число комбинаций статистик первого прохода (специализаций ядра на тип)
+ *
+ * @details Модули и экстремумы - одна группа: они дешевы рядом друг
+ * с другом, а каждая отдельная группа удваивает число специализаций
+ * (типы x наборы инструкций x комбинации).
+ */
+const unsigned OP_NEED_COMBINATIONS = 1 << 4;
+
+/**
+ * @brief Накопленные статистики вектора
+ *
+ * @details Всё ведётся в double над значениями без масштаба (масштаб
+ * применяется к итогу). Среднее и сумма квадратов отклонений считаются
+ * по блокам (в блоке - два прохода по кэшу, между блоками - формула
+ * Чана), что не теряет точности, в отличие от разности sumsq/n - mean^2.
+ */
+struct Moments {
+    uint64_t count = 0;
+    double sumsq = 0.0;
+    double sumabs = 0.0;
+    double dot = 0.0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+    double maxabs = 0.0;
+};
+
+/**
+ * @brief Описание операции в реестре
+ */
+struct VectorOpInfo {
+    VectorOp op;                            ///< Бит операции
+    const char *name;                       ///< Имя для журнала
+    unsigned needs;                         ///< Нужные статистики (OpNeed)
+    double (*result)(const Moments &m);     ///< Итог по статистикам
+};
+
+/**
+ * @brief Все операции в порядке битов
+ *
+ * @details В этом же порядке сервер возвращает результаты.
+ */
+const std::vector<VectorOpInfo> &vectorOps();
+
+/// Число операций в маске (и результатов в ответе)
+unsigned opCount(uint16_t ops);
+
+/// Имена операций маски через запятую, для журнала
+std::string opNames(uint16_t ops);
+
+/**
+ * @brief Реализация совместного ядра под конкретный набор инструкций
+ */
+struct FusedKernelSet {
+    const char *name;                       ///< Имя для журнала и тестов
+    /**
+     * Ядра по типу элементов и комбинации статистик (type * OP_NEED_COMBINATIONS + needs):
+     * x - байты блока элементов, y - байты второго вектора (для NEED_DOT),
+     * m2 - считать ли сумму квадратов отклонений (требует NEED_MEAN)
+     */
+    void (*const *kernels)(const uint8_t *x, const uint8_t *y, size_t n, Moments &m, bool m2);
+    bool (*supported)();                    ///< Поддерживает ли её текущий процессор
+};
+
+/**
+ * @brief Все реализации совместного ядра, от самой быстрой к обобщённой
+ */
+const std::vector<FusedKernelSet> &fusedKernelSets();
+
+/**
+ * @brief Имя реализации, которую FusedReduction выбирает по умолчанию
+ */
+const char *fusedKernelImpl();
+
+/**
+ * @brief Совместная редукция набора операций
+ *
+ * @details add() получает очередной блок (не длиннее SQUARE_BLOCK:
+ * среднее блока считается вторым проходом по нему) в типе элементов
+ * с провода, results() выдаёт по одному double на операцию в порядке
+ * битов. Пустой вектор даёт NaN для среднего, дисперсии, минимума и
+ * максимума и 0 для остальных.
+ */
+class FusedReduction {
+public:
+    /**
+     * @param ops Маска операций (непустая, только биты OP_ALL)
+     * @param type Тип элементов
+     * @param scale Масштаб: значение элемента - raw * scale (для обоих векторов OP_DOT)
+     * @param set Реализация ядра; nullptr - лучшая для процессора
+     */
+    explicit FusedReduction(uint16_t ops, ElemType type = ElemType::F32, double scale = 1.0,
+                            const FusedKernelSet *set = nullptr);
+
+    /// Тип элементов известен; иначе add() ничего не делает, а results() ничего не пишет
+    bool valid() const { return ops != 0; }
+
+    /// Нужен ли второй вектор (операция OP_DOT)
+    bool paired() const { return ops & OP_DOT; }
+
+    /// Размер элемента в байтах
+    size_t elemSize() const { return size; }
+
+    /**
+     * @brief Добавляет блок элементов
+     * @param x Элементы вектора в порядке байтов процессора, выравнивание не требуется
+     * @param y Элементы второго вектора (только если paired())
+     * @param n Число элементов
+     */
+    void add(const void *x, const void *y, size_t n) {
+        kernel((const uint8_t*)x, (const uint8_t*)y, n, m, m2);
+    }
+
+    /**
+     * @brief Учитывает count нулевых элементов (пропущенных в разреженном векторе)
+     *
+     * @details Нули не меняют сумм, но входят в число элементов, среднее,
+     * дисперсию и экстремумы.
+     */
+    void addZeros(uint64_t count);
+
+    /**
+     * @brief Записывает результаты операций
+     * @param out Не меньше opCount(ops) элементов
+     * @return Число записанных результатов
+     */
+    unsigned results(double *out) const;
+
+    /// Накопленные статистики (без масштаба)
+    const Moments &moments() const { return m; }
+
+private:
+    uint16_t ops;
+    size_t size;
+    double scale;
+    bool m2;
+    void (*kernel)(const uint8_t *x, const uint8_t *y, size_t n, Moments &m, bool m2);
+    Moments m;
+};
+
+/**
+ * @brief Результаты операций ops над массивом (блоками по SQUARE_BLOCK)
+ * @param y Второй вектор той же длины, если в ops есть OP_DOT
+ */
+std::vector<double> reduceOps(uint16_t ops, const float *x, const float *y, size_t n);
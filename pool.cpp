@@ -0,0 +1,82 @@
+/**
+ * @file pool.cpp
+ * @brief Реализация пула потоков с перехватом задач
+ */
+
+#include "pool.hpp"
+
+using namespace std;
+
+WorkPool::WorkPool(unsigned threads) {
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    for (unsigned i = 0; i < threads; i++) queues.push_back(make_unique<Queue>());
+    for (unsigned i = 0; i < threads; i++) workers.emplace_back(&WorkPool::workerLoop, this, i);
+}
+
+WorkPool::~WorkPool() {
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto &t : workers) t.join();
+}
+
+void WorkPool::submit(Task task) {
+    Queue &q = *queues[nextQueue.fetch_add(1, memory_order_relaxed) % queues.size()];
+    {
+        lock_guard<mutex> lock(q.m);
+        q.tasks.push_back(task);
+    }
+    pending.fetch_add(1);
+    {
+        // Пустая критическая секция: поток, проверивший pending перед
+        // засыпанием, либо увидит новую задачу, либо получит уведомление
+        lock_guard<mutex> lock(sleepMutex);
+    }
+    wake.notify_one();
+}
+
+/**
+ * @brief Берёт задачу: сначала с конца своей очереди, затем из начала чужих
+ * @param self Номер своей очереди (для внешнего потока - любой)
+ */
+bool WorkPool::take(size_t self, Task &task) {
+    if (pending.load() == 0) return false;
+    for (size_t k = 0; k < queues.size(); k++) {
+        Queue &q = *queues[(self + k) % queues.size()];
+        lock_guard<mutex> lock(q.m);
+        if (q.tasks.empty()) continue;
+        if (k == 0) {
+            task = q.tasks.back();
+            q.tasks.pop_back();
+        } else {
+            task = q.tasks.front();
+            q.tasks.pop_front();
+        }
+        pending.fetch_sub(1);
+        return true;
+    }
+    return false;
+}
+
+bool WorkPool::runOne() {
+    Task task;
+    // Внешний поток ничем не отличается от вора: начинает с произвольной очереди
+    if (!take(nextQueue.load(memory_order_relaxed) % queues.size() + 1, task)) return false;
+    task.fn(task.arg);
+    return true;
+}
+
+void WorkPool::workerLoop(size_t self) {
+    for (;;) {
+        Task task;
+        if (take(self, task)) {
+            task.fn(task.arg);
+            continue;
+        }
+        unique_lock<mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || pending.load() > 0; });
+        if (stopping) return;
+    }
+}
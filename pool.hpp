@@ -0,0 +1,77 @@
+/**
+ * @file pool.hpp
+ * @brief Общий пул потоков с перехватом задач (work stealing)
+ */
+
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Пул вычислительных потоков, общий для всех рабочих потоков сервера
+ *
+ * @details У каждого потока пула своя очередь задач. Поток берёт задачи
+ * из своей очереди, а опустев - перехватывает их из начала чужих очередей.
+ * Внешние потоки (реакторы) раскладывают задачи по очередям по кругу и,
+ * ожидая результата, могут сами выполнять задачи пула через runOne(),
+ * а не простаивать.
+ *
+ * Задача - это указатель на функцию и её аргумент: пул ничего не
+ * выделяет на одну задачу, время жизни аргумента обеспечивает вызывающий.
+ */
+class WorkPool {
+public:
+    /// Задача пула
+    struct Task {
+        void (*fn)(void *arg);
+        void *arg;
+    };
+
+    /**
+     * @param threads Число потоков; 0 - по числу ядер процессора
+     */
+    explicit WorkPool(unsigned threads = 0);
+    ~WorkPool();
+
+    WorkPool(const WorkPool &) = delete;
+    WorkPool &operator=(const WorkPool &) = delete;
+
+    /// Число потоков пула
+    unsigned size() const { return (unsigned)workers.size(); }
+
+    /**
+     * @brief Ставит задачу в очередь (из любого потока)
+     */
+    void submit(Task task);
+
+    /**
+     * @brief Выполняет одну задачу пула в вызывающем потоке
+     * @return false если очереди пусты
+     */
+    bool runOne();
+
+private:
+    /// Очередь одного потока: владелец берёт с конца, остальные - с начала
+    struct Queue {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+
+    bool take(size_t self, Task &task);
+    void workerLoop(size_t self);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<size_t> nextQueue{0};   ///< Очередь для следующей внешней задачи
+    std::atomic<size_t> pending{0};     ///< Задач во всех очередях
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
@@ -0,0 +1,117 @@
+/**
+ * @file protocol.cpp
+ * @brief Разбор расширенного заголовка вектора и пакета векторов
+ */
+
+#include "protocol.hpp"
+#include "buffer.hpp"
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+bool parseVectorHeader(const uint8_t *body, size_t len, VectorHeader &h) {
+    if (len < EXT_HEADER_MIN) return false;
+    h = VectorHeader();
+    h.extended = true;
+    h.size = body[0] | (body[1] << 8) | (body[2] << 16) | ((uint32_t)body[3] << 24);
+
+    if (len > 4) {
+        if (body[4] >= ACCUM_MODES) return false;
+        h.mode = (AccumMode)body[4];
+    }
+    if (len > 6) {
+        h.ops = body[5] | (body[6] << 8);
+        if (h.ops == 0 || (h.ops & ~OP_ALL)) return false;
+    }
+    if (len > 7) {
+        if (body[7] >= ELEM_TYPES) return false;
+        h.dtype = (ElemType)body[7];
+    }
+    if (len > 11) {
+        uint32_t bits = body[8] | (body[9] << 8) | (body[10] << 16) | ((uint32_t)body[11] << 24);
+        memcpy(&h.scale, &bits, sizeof(h.scale));
+        if (!isfinite(h.scale)) return false;
+    }
+    if (len > 12) {
+        if (body[12] > ENCODING_SPARSE) return false;
+        h.sparse = body[12] == ENCODING_SPARSE;
+        if (h.sparse) {
+            // Без числа записей разреженный вектор не разобрать
+            if (len < 17) return false;
+            h.nnz = body[13] | (body[14] << 8) | (body[15] << 16) | ((uint32_t)body[16] << 24);
+            if (h.nnz > h.size) return false;
+        }
+    }
+    return true;
+}
+
+SparseDecoder::SparseDecoder(uint32_t size, uint32_t nnz, size_t width, bool paired)
+    : size(size), left(nnz), width(width), paired(paired) {
+}
+
+bool SparseDecoder::decode(const uint8_t *data, size_t len, size_t &used,
+                           uint8_t *x, uint8_t *y, size_t &filled, size_t cap) {
+    size_t valueBytes = width * (paired ? 2 : 1);
+    used = 0;
+    while (left > 0 && filled < cap) {
+        uint64_t delta = 0;
+        size_t k = 0;
+        bool complete = false;
+        while (k < VARINT_MAX && used + k < len) {
+            uint8_t b = data[used + k];
+            delta |= (uint64_t)(b & 0x7F) << (7 * k);
+            k++;
+            if (!(b & 0x80)) {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete) {
+            if (k == VARINT_MAX) return false;
+            break;  // varint пришёл не полностью
+        }
+        if (len - used - k < valueBytes) break;
+
+        uint64_t index = started ? last + delta : delta;
+        if ((started && delta == 0) || index >= size) return false;
+
+        const uint8_t *value = data + used + k;
+        if (paired) {
+            decodeLittleEndianElements(value, 1, width, x + filled * width);
+            decodeLittleEndianElements(value + width, 1, width, y + filled * width);
+        } else {
+            decodeLittleEndianElements(value, 1, width, x + filled * width);
+        }
+        last = index;
+        started = true;
+        used += k + valueBytes;
+        filled++;
+        left--;
+    }
+    return true;
+}
+
+bool vectorSizeValid(uint32_t size) {
+    return size <= LEGACY_MAX || size == EXT_VECTOR;
+}
+
+bool vectorCountValid(uint32_t count) {
+    return count <= LEGACY_MAX || count == BATCH_FRAME || count == SESSION_CLOSE ||
+           count == JOB_FRAME || count == TICKET_REQUEST;
+}
+
+bool parseBatchHeader(const uint8_t *prefix, uint32_t &count, AccumMode &mode) {
+    uint32_t hdrLen = prefix[0] | (prefix[1] << 8) | (prefix[2] << 16) | ((uint32_t)prefix[3] << 24);
+    if (hdrLen < 1 + 4 || (hdrLen - 1) % 4 != 0) return false;
+    count = (hdrLen - 1) / 4;
+    if (count > BATCH_MAX_VECTORS || prefix[4] >= ACCUM_MODES) return false;
+    mode = (AccumMode)prefix[4];
+    return true;
+}
+
+void writeLittleEndianDouble(double value, uint8_t *bytes) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    for (int i = 0; i < 8; i++) bytes[i] = (bits >> (8 * i)) & 0xFF;
+}
@@ -0,0 +1,225 @@
+/**
+ * @file protocol.hpp
+ * @brief Расширенный заголовок вектора и кодирование результатов
+ *
+ * @details Исходный протокол передаёт перед данными вектора только его
+ * длину (uint32 LE), а в ответ получает float. Расширенный вектор
+ * начинается со значения EXT_VECTOR вместо длины, за которым идут байт
+ * длины заголовка и сам заголовок:
+ *
+ *     uint32 0xFFFFFFFF | uint8 hdrLen | uint32 size | uint8 mode | uint16 ops |
+ *     uint8 dtype | float32 scale | uint8 encoding | uint32 nnz | ...
+ *
+ * Поля, не уместившиеся в hdrLen, принимают значения по умолчанию, а
+ * лишние байты в конце заголовка пропускаются, так что заголовок можно
+ * дополнять, не ломая старых клиентов. Обычные векторы обрабатываются
+ * как раньше, но их длина и число векторов не больше LEGACY_MAX:
+ * значения от PROTOCOL_RESERVED отведены под метки (EXT_VECTOR,
+ * BATCH_FRAME и другие ниже), а неизвестное значение из этого диапазона
+ * сессия отклоняет ответом "ERR" и закрывается, а не разбирает как
+ * данные. Вектор длиннее LEGACY_MAX передаётся с расширенным заголовком.
+ *
+ * ops - маска операций (VectorOp), по умолчанию только сумма квадратов.
+ * Ответ на расширенный вектор - по одному double (8 байт LE) на
+ * операцию в порядке битов. Режим mode относится к сумме квадратов,
+ * запрошенной одна; совместная редукция нескольких операций всегда
+ * копит в double. С OP_DOT вектор несёт size пар (x_i, y_i) - элементы
+ * двух векторов вперемешку, остальные операции считаются по x.
+ *
+ * dtype - тип элементов (ElemType), по умолчанию float. Значение
+ * элемента - raw * scale (по умолчанию 1), так что int8/int16 и
+ * половинная точность передают вектор в 2-4 раза короче. Векторы не
+ * во float считаются совместной редукцией (в double), как и наборы
+ * операций.
+ *
+ * encoding = ENCODING_SPARSE задаёт разреженный вектор: вместо size
+ * элементов идут nnz записей "varint-приращение индекса | значение"
+ * (с OP_DOT - пара значений). Приращение - беззнаковый LEB128: первое
+ * равно индексу, следующие - разности с предыдущим индексом (не
+ * меньше 1), индексы меньше size. Остальные элементы - нули: операции
+ * считаются только по записям, а нули учитываются в количестве,
+ * среднем и экстремумах, так что результат совпадает с плотным
+ * вектором (с точностью до порядка сложения).
+ *
+ * Пакет векторов избавляет мелкие векторы от обмена на каждый вектор:
+ * вместо числа векторов клиент передаёт BATCH_FRAME, затем заголовок
+ * пакета с размерами всех векторов и данные всех векторов подряд:
+ *
+ *     uint32 0xFFFFFFFF | uint32 hdrLen | uint8 mode | uint32 size[(hdrLen - 1) / 4] |
+ *     float32 данные
+ *
+ * Ответ - по double little-endian на вектор, одним массивом после
+ * последнего вектора пакета.
+ *
+ * Задание с номером запроса (JOB_FRAME вместо числа векторов) несёт
+ * один вектор в кадре известной длины:
+ *
+ *     uint32 0xFFFFFFFD | uint32 id | uint32 len | вектор (len байт: размер
+ *     или расширенный заголовок, затем данные)
+ *
+ * Такие задания считаются на пуле параллельно, пока сессия принимает
+ * следующие, и ответ на каждое уходит, как только оно готово, - не
+ * обязательно в порядке запросов:
+ *
+ *     uint32 id | uint8 n | double результаты[n]
+ *
+ * n = 0 означает неверный вектор. Перед заданием без номера, пакетом
+ * или SESSION_CLOSE сессия дожидается ответов на все задания с номерами.
+ *
+ * После OK сессия принимает задания (число векторов или пакет, затем
+ * векторы) одно за другим. Клиент завершает её значением SESSION_CLOSE
+ * вместо числа векторов или закрытием соединения между заданиями;
+ * сессию, простаивающую дольше --idle-timeout, закрывает сервер.
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include "kernels.hpp"
+#include "ops.hpp"
+
+/// Значение длины вектора, означающее расширенный заголовок
+const uint32_t EXT_VECTOR = 0xFFFFFFFF;
+
+/// Минимальная длина расширенного заголовка (поле size)
+const size_t EXT_HEADER_MIN = 4;
+
+/// Кодирование данных вектора: все элементы подряд
+const uint8_t ENCODING_DENSE = 0;
+
+/// Кодирование данных вектора: индексы и значения ненулевых элементов
+const uint8_t ENCODING_SPARSE = 1;
+
+/// Наибольшая длина varint-приращения индекса (uint32 в LEB128)
+const size_t VARINT_MAX = 5;
+
+/**
+ * @brief Параметры вектора из заголовка
+ */
+struct VectorHeader {
+    uint32_t size = 0;                      ///< Число элементов
+    AccumMode mode = AccumMode::Float;      ///< Режим накопления
+    uint16_t ops = OP_SUMSQ;                ///< Маска операций (VectorOp)
+    ElemType dtype = ElemType::F32;         ///< Тип элементов
+    float scale = 1.0f;                     ///< Масштаб элементов
+    bool sparse = false;                    ///< Разреженный вектор
+    uint32_t nnz = 0;                       ///< Число записей разреженного вектора
+    bool extended = false;                  ///< Вектор пришёл с расширенным заголовком
+
+    /**
+     * @brief Считается ли вектор совместной редукцией (в double)
+     *
+     * @details Только сумма квадратов float без масштаба считается
+     * ядром режима mode (и параллельно на пуле для длинных векторов).
+     */
+    bool fused() const {
+        return ops != OP_SUMSQ || dtype != ElemType::F32 || scale != 1.0f || sparse;
+    }
+};
+
+/**
+ * @brief Разбирает тело расширенного заголовка (байты после hdrLen)
+ * @param body Тело заголовка
+ * @param len Длина тела (значение hdrLen)
+ * @param h [out] Параметры вектора
+ * @return false если заголовок короче обязательных полей или значение
+ * поля недопустимо
+ */
+bool parseVectorHeader(const uint8_t *body, size_t len, VectorHeader &h);
+
+/**
+ * @brief Разбор записей разреженного вектора по мере поступления данных
+ *
+ * @details Значения копируются в своём типе (в порядке байтов
+ * процессора) в блоки, которые затем считает FusedReduction. Запись,
+ * пришедшая не полностью, остаётся в буфере до следующего вызова.
+ */
+class SparseDecoder {
+public:
+    /**
+     * @param size Длина вектора
+     * @param nnz Число записей
+     * @param width Размер значения в байтах
+     * @param paired Запись несёт пару значений (OP_DOT)
+     */
+    SparseDecoder(uint32_t size, uint32_t nnz, size_t width, bool paired);
+
+    /**
+     * @brief Разбирает полные записи из начала data
+     * @param data Принятые байты
+     * @param len Их число
+     * @param used [out] Сколько байт разобрано
+     * @param x Блок значений; запись идёт с позиции filled
+     * @param y Блок вторых значений (только для пар)
+     * @param filled [in,out] Заполнено записей в блоке
+     * @param cap Вместимость блока в записях
+     * @return false если индекс вне вектора, не возрастает или varint длиннее VARINT_MAX
+     */
+    bool decode(const uint8_t *data, size_t len, size_t &used,
+                uint8_t *x, uint8_t *y, size_t &filled, size_t cap);
+
+    /// Сколько записей ещё не разобрано
+    uint32_t remaining() const { return left; }
+
+private:
+    uint32_t size;
+    uint32_t left;
+    size_t width;
+    bool paired;
+    bool started = false;
+    uint64_t last = 0;          ///< Индекс предыдущей записи
+};
+
+/// Значение вместо числа векторов: дальше идёт пакет векторов
+const uint32_t BATCH_FRAME = 0xFFFFFFFF;
+
+/// Значение вместо числа векторов: клиент завершает сессию
+const uint32_t SESSION_CLOSE = 0xFFFFFFFE;
+
+/// Значение вместо числа векторов: дальше идёт задание с номером запроса
+const uint32_t JOB_FRAME = 0xFFFFFFFD;
+
+/// Наибольшая длина кадра задания с номером
+const uint32_t JOB_FRAME_MAX = 64 << 20;
+
+/// Значение вместо числа векторов: клиент просит билет возобновления сессии
+const uint32_t TICKET_REQUEST = 0xFFFFFFFC;
+
+/// Начало диапазона меток вместо числа векторов и длины вектора
+const uint32_t PROTOCOL_RESERVED = 0xFFFFFF00;
+
+/// Наибольшие длина вектора и число векторов без меток
+const uint32_t LEGACY_MAX = PROTOCOL_RESERVED - 1;
+
+/**
+ * @brief Проверяет длину вектора, пришедшую вместо заголовка
+ * @return false если значение из диапазона меток, но не EXT_VECTOR
+ */
+bool vectorSizeValid(uint32_t size);
+
+/**
+ * @brief Проверяет число векторов задания
+ * @return false если значение из диапазона меток, но не известная метка
+ */
+bool vectorCountValid(uint32_t count);
+
+/// Длина начала заголовка пакета (hdrLen и mode), по которой известно число векторов
+const size_t BATCH_PREFIX = 5;
+
+/// Наибольшее число векторов в пакете
+const uint32_t BATCH_MAX_VECTORS = 1 << 16;
+
+/**
+ * @brief Разбирает начало заголовка пакета
+ * @param prefix BATCH_PREFIX байт после BATCH_FRAME
+ * @param count [out] Число векторов; следом идут их размеры, по uint32 LE
+ * @param mode [out] Режим накопления для всех векторов пакета
+ * @return false если длина заголовка не кратна размеру, пакет пуст или
+ * длиннее BATCH_MAX_VECTORS, или неизвестен режим
+ */
+bool parseBatchHeader(const uint8_t *prefix, uint32_t &count, AccumMode &mode);
+
+/**
+ * @brief Записывает double в 8 байт little-endian
+ */
+void writeLittleEndianDouble(double value, uint8_t *bytes);
@@ -0,0 +1,255 @@
+/**
+ * @file reactor.cpp
+ * @brief Реализация цикла событий epoll
+ */
+
+#include "reactor.hpp"
+#include "session.hpp"
+#include "server.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+using namespace std;
+
+/// Максимальное число событий, забираемых одним вызовом epoll_wait
+static const int MAX_EVENTS = 256;
+
+Reactor::Reactor(int listenSock, const ServerContext &ctx)
+    : epfd(epoll_create1(EPOLL_CLOEXEC)), listenSock(listenSock),
+      wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      timerFd(ctx.idleTimeout ? timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC) : -1),
+      ctx(ctx) {
+}
+
+Reactor::~Reactor() {
+    for (Session *s : sessions) delete s;
+    if (timerFd >= 0) close(timerFd);
+    if (wakeFd >= 0) close(wakeFd);
+    if (epfd >= 0) close(epfd);
+}
+
+/**
+ * @brief Отправляет ответы сессии, пока сокет принимает данные
+ */
+static void flushOutput(Session *s) {
+    const char *data;
+    size_t len;
+    while (!s->finished() && s->nextOutput(data, len)) {
+        ssize_t n = send(s->fd(), data, len, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (n <= 0) {
+            s->sendFailed();
+            return;
+        }
+        s->sent(n);
+    }
+}
+
+/**
+ * @brief Читает данные в сессию, пока они нужны протоколу
+ * @return true если сокет исчерпан (EAGAIN или обрыв), false если
+ * сессия перестала ждать данные
+ */
+static bool readInput(Session *s) {
+    while (s->wantsInput()) {
+        s->process();
+        if (!s->wantsInput()) return false;
+
+        ssize_t n = s->input().fill(s->fd(), s->inputLimit());
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+        if (n <= 0) {
+            s->readFailed(n == 0);
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Продвигает сессию после события epoll
+ *
+ * @details В режиме EPOLLET новое событие придёт только после EAGAIN,
+ * поэтому сокет читается до исчерпания. Если сессия ждёт отправки
+ * накопленных ответов, чтение возобновляется, как только отправка
+ * её освободит.
+ */
+static void serve(Session *s) {
+    bool drained = false;
+    while (!s->finished()) {
+        if (!drained) drained = readInput(s);
+        flushOutput(s);
+        if (drained || !s->wantsInput()) return;
+    }
+}
+
+/**
+ * @brief Принимает все ожидающие соединения (в режиме EPOLLET до EAGAIN)
+ */
+void Reactor::acceptClients() {
+    while (true) {
+        sockaddr_in client;
+        socklen_t len = sizeof(client);
+        int clientSock = accept4(listenSock, (sockaddr*)&client, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (clientSock < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno == EMFILE || errno == ENFILE)
+                logMsg(LogLevel::Error, "Ошибка: исчерпан лимит дескрипторов");
+            return;
+        }
+
+        Session *s = new Session(clientSock, ctx, wakeFd, &auth);
+        epoll_event ev = {};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = s;
+        if (epoll_ctl(epfd, EPOLL_CTL_ADD, clientSock, &ev) < 0) {
+            delete s;
+            continue;
+        }
+        sessions.insert(s);
+    }
+}
+
+/**
+ * @brief Запоминает сессию, если она ждёт сигнала пула или проверки пароля
+ */
+void Reactor::track(Session *s) {
+    if (s->wantsWake() && find(computing.begin(), computing.end(), s) == computing.end())
+        computing.push_back(s);
+    if (s->wantsAuth() && find(authenticating.begin(), authenticating.end(), s) == authenticating.end())
+        authenticating.push_back(s);
+}
+
+/**
+ * @brief Продвигает сессии, ждущие пула, после сигнала eventfd
+ *
+ * @details Сигнал общий для всех сессий реактора, поэтому проверяются все
+ * ждущие; неготовые снова подписываются на уведомление в process().
+ */
+void Reactor::resumeComputing() {
+    uint64_t count;
+    while (read(wakeFd, &count, sizeof(count)) > 0) {}
+
+    vector<Session*> waiting;
+    waiting.swap(computing);
+    for (Session *s : waiting) {
+        if (s->finished()) continue;   // уже в списке finished
+        s->process();
+        // Отправляем ответы готовых заданий и, если сессия больше не ждёт
+        // пула, дочитываем сокет, который тем временем не читался
+        serve(s);
+        if (s->finished()) finished.push_back(s);
+        else track(s);
+    }
+}
+
+/**
+ * @brief Проверяет пароли, собранные за итерацию, и продвигает эти сессии
+ */
+void Reactor::checkLogins() {
+    auth.run(ctx.users);
+    vector<Session*> waiting;
+    waiting.swap(authenticating);
+    for (Session *s : waiting) {
+        s->process();
+        serve(s);
+        if (s->finished()) finished.push_back(s);
+        else track(s);
+    }
+}
+
+/**
+ * @brief Отмечает секунду простоя во всех сессиях и закрывает просроченные
+ */
+void Reactor::expireIdle() {
+    uint64_t count;
+    while (read(timerFd, &count, sizeof(count)) > 0) {}
+
+    for (Session *s : sessions) {
+        // Завершённые сессии уже в списке finished
+        if (!s->finished() && s->idleTick()) finished.push_back(s);
+    }
+}
+
+bool Reactor::run() {
+    if (epfd < 0 || wakeFd < 0) {
+        perror("Ошибка epoll");
+        return false;
+    }
+
+    epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLET;
+    ev.data.ptr = nullptr;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, listenSock, &ev) < 0) {
+        perror("Ошибка epoll");
+        return false;
+    }
+    ev.events = EPOLLIN;
+    ev.data.ptr = &wakeFd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, wakeFd, &ev) < 0) {
+        perror("Ошибка epoll");
+        return false;
+    }
+    if (ctx.idleTimeout) {
+        itimerspec tick = {{1, 0}, {1, 0}};
+        ev.data.ptr = &timerFd;
+        if (timerFd < 0 || timerfd_settime(timerFd, 0, &tick, nullptr) < 0 ||
+            epoll_ctl(epfd, EPOLL_CTL_ADD, timerFd, &ev) < 0) {
+            perror("Ошибка таймера простоя");
+            return false;
+        }
+    }
+
+    epoll_event events[MAX_EVENTS];
+    while (true) {
+        int n = epoll_wait(epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Ошибка epoll");
+            return false;
+        }
+
+        for (int i = 0; i < n; i++) {
+            void *ptr = events[i].data.ptr;
+            if (!ptr) {
+                acceptClients();
+                continue;
+            }
+            if (ptr == &wakeFd) {
+                resumeComputing();
+                continue;
+            }
+            if (ptr == &timerFd) {
+                expireIdle();
+                continue;
+            }
+            Session *s = static_cast<Session*>(ptr);
+            if (s->finished()) continue;
+            serve(s);
+            if (s->finished()) finished.push_back(s);
+            else track(s);
+        }
+
+        if (!authenticating.empty()) checkLogins();
+
+        // Закрытие откладывается до конца пачки: в ней могут оставаться
+        // события для тех же сессий
+        for (Session *s : finished) {
+            if (!computing.empty())
+                computing.erase(remove(computing.begin(), computing.end(), s), computing.end());
+            if (!authenticating.empty())
+                authenticating.erase(remove(authenticating.begin(), authenticating.end(), s), authenticating.end());
+            sessions.erase(s);
+            delete s;
+        }
+        finished.clear();
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * @file reactor.hpp
+ * @brief Цикл событий epoll (edge-triggered) для обслуживания множества клиентов
+ */
+
+#pragma once
+#include <unordered_set>
+#include <vector>
+#include "session.hpp"
+
+
+/**
+ * @brief Однопоточный реактор: принимает соединения и ведёт все сессии
+ *
+ * @details Слушающий сокет и сокеты клиентов зарегистрированы в одном
+ * экземпляре epoll в режиме EPOLLET. Медленный клиент больше не блокирует
+ * остальных: сессия, которой не хватает данных, просто ждёт следующего
+ * события, а реактор тем временем обслуживает другие соединения.
+ *
+ * Сессии, ждущие блоков параллельной редукции или заданий с номерами,
+ * реактор держит в списке computing; пул сообщает о готовых блоках
+ * и заданиях через eventfd wakeFd, зарегистрированный в том же epoll.
+ *
+ * Пароли подключений, пришедшие за одну итерацию, проверяются пачкой
+ * (AuthBatch) после разбора всех её событий; ждущие проверки сессии
+ * лежат в списке authenticating.
+ *
+ * Если задан таймаут простоя, раз в секунду срабатывает timerfd timerFd,
+ * и реактор отмечает секунду во всех своих сессиях (Session::idleTick()).
+ */
+class Reactor {
+public:
+    /**
+     * @param listenSock Неблокирующий слушающий сокет
+     * @param ctx Параметры сервера
+     */
+    Reactor(int listenSock, const ServerContext &ctx);
+    ~Reactor();
+
+    Reactor(const Reactor &) = delete;
+    Reactor &operator=(const Reactor &) = delete;
+
+    /**
+     * @brief Запускает бесконечный цикл обработки событий
+     * @return false если epoll не удалось создать или он вернул ошибку
+     */
+    bool run();
+
+private:
+    void acceptClients();
+    void track(Session *s);
+    void resumeComputing();
+    void checkLogins();
+    void expireIdle();
+
+    int epfd;
+    int listenSock;
+    int wakeFd;
+    int timerFd;                      ///< Секундный таймер простоя (-1 - таймаут выключен)
+    const ServerContext &ctx;
+    std::unordered_set<Session*> sessions;  ///< Все открытые сессии
+    std::vector<Session*> finished;   ///< Сессии, удаляемые после обработки пачки событий
+    std::vector<Session*> computing;  ///< Сессии, ждущие пула
+    AuthBatch auth;                   ///< Проверки пароля текущей итерации
+    std::vector<Session*> authenticating;   ///< Сессии, ждущие проверки пароля
+};
@@ -0,0 +1,193 @@
+/**
+ * @file reduction.cpp
+ * @brief Реализация блочной редукции
+ */
+
+#include "reduction.hpp"
+#include "pool.hpp"
+#include "buffer.hpp"
+#include "kernels.hpp"
+#include "ops.hpp"
+#include <thread>
+#include <unistd.h>
+
+using namespace std;
+
+ChunkedSum::ChunkedSum(WorkPool &pool, size_t window) : pool(pool) {
+    // По умолчанию два блока на поток пула и ещё один заполняется,
+    // пока остальные считаются; меньше двух конвейер не работает
+    if (window == 0) window = 2 * pool.size() + 1;
+    window = max<size_t>(window, 2);
+    for (size_t i = 0; i < window; i++) {
+        slots.push_back(make_unique<Slot>());
+        slots.back()->owner = this;
+        slots.back()->data.resize(CHUNK);
+    }
+}
+
+ChunkedSum::~ChunkedSum() {
+    // Задачи пула ссылаются на блоки: дожидаемся их, даже если вектор брошен
+    while (running.load() > 0) {
+        if (!pool.runOne()) this_thread::yield();
+    }
+}
+
+void ChunkedSum::reduceSlot(void *arg) {
+    Slot *slot = static_cast<Slot*>(arg);
+    ChunkedSum *owner = slot->owner;
+    slot->partial = sumOfSquares(owner->mode, slot->data.data(), slot->count);
+    slot->done.store(true);
+
+    // Владелец мог уснуть, не застав done: будим его цикл событий.
+    // Пара store(done) / exchange(parked) здесь и store(parked) /
+    // load(done) в waitAsync() упорядочены (seq_cst), так что хотя бы
+    // одна сторона увидит запись другой
+    if (owner->parked.exchange(false)) {
+        uint64_t one = 1;
+        write(owner->wakeFd.load(), &one, sizeof(one));
+    }
+    owner->running.fetch_sub(1);
+}
+
+size_t ChunkedSum::append(const uint8_t *bytes, size_t count) {
+    size_t taken = 0;
+    while (taken < count) {
+        if (inFlight == slots.size()) {
+            retireDone();
+            if (inFlight == slots.size()) break;
+        }
+
+        Slot &slot = *slots[(oldest + inFlight) % slots.size()];
+        size_t n = min(count - taken, CHUNK - filled);
+        decodeLittleEndianFloats(bytes + taken * 4, n, slot.data.data() + filled);
+        filled += n;
+        taken += n;
+
+        if (filled == CHUNK) {
+            slot.count = CHUNK;
+            slot.done.store(false, memory_order_relaxed);
+            running.fetch_add(1);
+            pool.submit({reduceSlot, &slot});
+            inFlight++;
+            filled = 0;
+        }
+    }
+    return taken;
+}
+
+void ChunkedSum::appendAll(const uint8_t *bytes, size_t count) {
+    while (count > 0) {
+        size_t n = append(bytes, count);
+        bytes += n * 4;
+        count -= n;
+        if (count > 0) wait();
+    }
+}
+
+/**
+ * @brief Забирает суммы готовых блоков по порядку, начиная с самого старого
+ */
+void ChunkedSum::retireDone() {
+    while (inFlight > 0) {
+        Slot &slot = *slots[oldest];
+        if (!slot.done.load(memory_order_acquire)) return;
+        combine(slot.partial);
+        oldest = (oldest + 1) % slots.size();
+        inFlight--;
+    }
+}
+
+bool ChunkedSum::busy() {
+    retireDone();
+    return inFlight > 0;
+}
+
+void ChunkedSum::wait() {
+    while (inFlight > 0 && !slots[oldest]->done.load(memory_order_acquire)) {
+        if (!pool.runOne()) this_thread::yield();
+    }
+    retireDone();
+}
+
+bool ChunkedSum::waitAsync(int fd) {
+    if (!busy()) return false;
+    wakeFd.store(fd);
+    parked.store(true);
+    if (slots[oldest]->done.load()) {
+        // Блок успел завершиться: уведомление, если оно уже ушло, будет лишним
+        parked.store(false);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Добавляет частичную сумму очередного блока в дерево
+ *
+ * @details Две суммы одного уровня складываются в узел следующего уровня,
+ * как переносы в двоичном счётчике, так что форма дерева определяется
+ * только номером блока.
+ */
+void ChunkedSum::combine(double partial) {
+    unsigned level = 0;
+    while (!tree.empty() && tree.back().first == level) {
+        partial = tree.back().second + partial;
+        tree.pop_back();
+        level++;
+    }
+    tree.push_back({level, partial});
+}
+
+double ChunkedSum::finish() {
+    while (busy()) wait();
+    if (filled > 0) {
+        // Неполный последний блок считается на месте: порядок сложения тот же
+        Slot &slot = *slots[oldest];
+        combine(sumOfSquares(mode, slot.data.data(), filled));
+        filled = 0;
+    }
+
+    double sum = 0.0;
+    if (!tree.empty()) {
+        sum = tree.back().second;
+        for (size_t i = tree.size() - 1; i-- > 0; ) sum = tree[i].second + sum;
+    }
+    tree.clear();
+    return sum;
+}
+
+__attribute__((noinline))
+void accumulateSquares(AnySquareSum &acc, const uint8_t *bytes, size_t count) {
+    visit([&](auto &s) {
+        float run[SQUARE_BLOCK];
+        for (size_t done = 0; done < count; ) {
+            size_t n = min(count - done, SQUARE_BLOCK);
+            decodeLittleEndianFloats(bytes + done * 4, n, run);
+            s.add(run, n);
+            done += n;
+        }
+    }, acc);
+}
+
+__attribute__((noinline))
+void accumulateOps(FusedReduction &fused, const uint8_t *bytes, size_t count) {
+    const size_t width = fused.elemSize();
+    const size_t maxWidth = 8;
+    for (size_t done = 0; done < count; ) {
+        size_t n = min(count - done, SQUARE_BLOCK);
+        if (fused.paired()) {
+            uint8_t x[maxWidth * SQUARE_BLOCK], y[maxWidth * SQUARE_BLOCK];
+            splitLittleEndianPairs(bytes + done * 2 * width, n, width, x, y);
+            fused.add(x, y, n);
+        } else {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            fused.add(bytes + done * width, nullptr, n);
+#else
+            uint8_t x[maxWidth * SQUARE_BLOCK];
+            decodeLittleEndianElements(bytes + done * width, n, width, x);
+            fused.add(x, nullptr, n);
+#endif
+        }
+        done += n;
+    }
+}
@@ -0,0 +1,151 @@
+/**
+ * @file reduction.hpp
+ * @brief Блочная редукция: длинные векторы - параллельно на пуле, серии из буфера - на месте
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "kernels.hpp"
+
+class WorkPool;
+class FusedReduction;
+
+/**
+ * @brief Сумма квадратов вектора, считаемая блоками на пуле потоков
+ *
+ * @details Элементы поступают порциями произвольного размера (как их
+ * отдаёт сокет) и раскладываются по блокам фиксированной длины CHUNK.
+ * Заполненный блок уходит в пул, где считается в режиме накопления
+ * вектора, а частичные суммы блоков складываются в double попарно
+ * в порядке номеров блоков (дерево, как у двоичного счётчика).
+ * Границы блоков и порядок сложения зависят только от длины вектора,
+ * поэтому результат не зависит ни от числа потоков, ни от того, какими
+ * порциями пришли данные.
+ *
+ * Это конвейер приёма и вычислений: пока пул считает заполненные блоки,
+ * в следующий свободный блок декодируются новые данные из сокета.
+ * Блоков не больше window() (при window() == 2 - классическая двойная
+ * буферизация), поэтому память на вектор ограничена window() * CHUNK
+ * элементов при любой заявленной длине. Когда все блоки заняты,
+ * append() принимает не всё, и владелец ждёт завершения самого старого
+ * блока: либо блокируясь в wait(), либо асинхронно через waitAsync().
+ */
+class ChunkedSum {
+public:
+    /// Длина блока в элементах (64 КиБ - блок остаётся в кэше L2)
+    static const size_t CHUNK = 16 * 1024;
+
+    /**
+     * @param pool Пул потоков
+     * @param window Число блоков; 0 - два на поток пула и ещё один
+     */
+    explicit ChunkedSum(WorkPool &pool, size_t window = 0);
+    ~ChunkedSum();
+
+    ChunkedSum(const ChunkedSum &) = delete;
+    ChunkedSum &operator=(const ChunkedSum &) = delete;
+
+    /**
+     * @brief Задаёт режим накопления для следующего вектора
+     *
+     * @details Вызывается до первого append() вектора.
+     */
+    void setMode(AccumMode m) { mode = m; }
+
+    /**
+     * @brief Добавляет очередную порцию элементов, не блокируясь
+     * @param bytes Элементы float в формате little-endian
+     * @param count Число элементов
+     * @return Сколько элементов принято; меньше count, если все блоки заняты
+     */
+    size_t append(const uint8_t *bytes, size_t count);
+
+    /**
+     * @brief Добавляет порцию целиком, при необходимости дожидаясь блоков
+     */
+    void appendAll(const uint8_t *bytes, size_t count);
+
+    /// Есть блоки, которые ещё считаются
+    bool busy();
+
+    /**
+     * @brief Дожидается самого старого блока, выполняя задачи пула
+     */
+    void wait();
+
+    /**
+     * @brief Готовит асинхронное ожидание самого старого блока
+     *
+     * @details Если блок ещё считается, поток пула, закончив любой блок
+     * этого вектора, запишет 1 в eventfd wakeFd, и владелец проверит
+     * готовность снова.
+     * @return false если ждать не нужно: блок уже готов или блоков в работе нет
+     */
+    bool waitAsync(int wakeFd);
+
+    /**
+     * @brief Дожидается всех блоков и возвращает сумму
+     *
+     * @details После вызова объект готов к следующему вектору.
+     */
+    double finish();
+
+    /// Сколько блоков может быть в работе одновременно
+    size_t window() const { return slots.size(); }
+
+private:
+    /// Блок элементов и его частичная сумма
+    struct Slot {
+        ChunkedSum *owner = nullptr;
+        std::vector<float> data;
+        size_t count = 0;
+        double partial = 0.0;
+        std::atomic<bool> done{false};
+    };
+
+    static void reduceSlot(void *arg);
+    void retireDone();
+    void combine(double partial);
+
+    WorkPool &pool;
+    AccumMode mode = AccumMode::Float;
+    std::vector<std::unique_ptr<Slot>> slots;   ///< Кольцо блоков
+    size_t oldest = 0;                          ///< Самый старый блок в работе
+    size_t inFlight = 0;                        ///< Блоков в работе
+    size_t filled = 0;                          ///< Заполнено элементов текущего блока
+
+    std::atomic<bool> parked{false};            ///< Владелец ждёт уведомления
+    std::atomic<int> wakeFd{-1};
+    std::atomic<size_t> running{0};             ///< Задачи пула, ещё не вышедшие из reduceSlot
+
+    /// Незавершённые узлы дерева сложения: (уровень, сумма)
+    std::vector<std::pair<unsigned, double>> tree;
+};
+
+/**
+ * @brief Добавляет к накопителю квадраты серии элементов float little-endian
+ *
+ * @details Элементы декодируются блоками SQUARE_BLOCK в непрерывный
+ * массив float, который обрабатывает векторизованное ядро режима.
+ * Режим выбирается один раз на серию (visit), а не на элемент. Функция
+ * не встраивается в вызывающие корутины, чтобы буфер декодирования жил
+ * на стеке, а не в кадре каждой сессии.
+ */
+void accumulateSquares(AnySquareSum &acc, const uint8_t *bytes, size_t count);
+
+/**
+ * @brief Добавляет к совместной редукции серию элементов little-endian
+ *
+ * @details Как accumulateSquares(), но для набора операций и любого
+ * типа элементов. Ядро читает элементы прямо из bytes и расширяет их
+ * в регистрах; копируются (в своём типе) только пары (x_i, y_i)
+ * скалярного произведения, которые разбираются в два массива, чтобы
+ * ядро читало оба вектора подряд.
+ * @param count Число элементов (пар, если fused.paired())
+ */
+void accumulateOps(FusedReduction &fused, const uint8_t *bytes, size_t count);
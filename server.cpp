@@ -4,79 +4,37 @@
  */
 
 #include <iostream>
-#include <fstream>
 #include <vector>
 #include <string>
 #include <cstring>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <sys/socket.h>
-#include <ctime>
-#include <iomanip>
+#include <sys/un.h>
+#include <sys/signalfd.h>
+#include <sys/inotify.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <csignal>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include "server.hpp"
+#include "reactor.hpp"
+#include "uring.hpp"
+#include "local.hpp"
+#include "session.hpp"
+#include "pool.hpp"
+#include "reduction.hpp"
+#include "kernels.hpp"
 #include "sha256.hpp"
 #include <boost/program_options.hpp>
 
 namespace po = boost::program_options;
 using namespace std;
 
-void logMsg(const string &file, const string &msg) {
-    ofstream f(file, ios::app);
-    if (!f) return;
-    time_t t = time(nullptr);
-    tm *tm = localtime(&t);
-    f << put_time(tm, "%Y-%m-%d %H:%M:%S") << " | " << msg << endl;
-}
-
-vector<pair<string,string>> loadUsers(const string &file) {
-    vector<pair<string,string>> users;
-    ifstream f(file);
-    string line;
-    while (getline(f, line)) {
-        size_t p = line.find(':');
-        if (p != string::npos)
-            users.push_back({line.substr(0, p), line.substr(p + 1)});
-    }
-    return users;
-}
-
-bool checkAuth(const string &login, const string &salt, const string &hash, 
-               const vector<pair<string,string>> &users) {
-    for (const auto &[l, p] : users) {
-        if (l == login) {
-            string data = salt + p;
-            uint8_t digest[32];
-            sha256((uint8_t*)data.c_str(), data.size(), digest);
-            
-            char hex[65];
-            for (int i = 0; i < 32; i++) sprintf(hex + i*2, "%02X", digest[i]);
-            hex[64] = '\0';
-            
-            return string(hex) == hash;
-        }
-    }
-    return false;
-}
-
-bool readAll(int sock, void *buf, size_t len) {
-    size_t got = 0;
-    while (got < len) {
-        ssize_t n = read(sock, (char*)buf + got, len - got);
-        if (n <= 0) return false;
-        got += n;
-    }
-    return true;
-}
-
-bool writeAll(int sock, const void *buf, size_t len) {
-    size_t sent = 0;
-    while (sent < len) {
-        ssize_t n = write(sock, (char*)buf + sent, len - sent);
-        if (n <= 0) return false;
-        sent += n;
-    }
-    return true;
-}
-
 uint32_t readLittleEndian32(const uint8_t* bytes) {
     return (bytes[0] << 0) | (bytes[1] << 8) | (bytes[2] << 16) | (bytes[3] << 24);
 }
@@ -154,98 +112,146 @@ bool parseAuthString(const string& authStr, string& login, string& salt, string&
     return true;
 }
 
-void handleClient(int sock, const vector<pair<string,string>> &users, const string &logFile) {
-    logMsg(logFile, "Клиент подключен");
-    
-    // Аутентификация
-    char auth[256];
-    ssize_t n = read(sock, auth, sizeof(auth)-1);
-    if (n <= 0) { 
-        logMsg(logFile, "Ошибка чтения аутентификации");
-        close(sock); 
-        return; 
-    }
-    auth[n] = '\0';
-    
-    string authStr(auth);
-    
-    // Парсинг строки аутентификации
-    string login, salt, hash;
-    if (!parseAuthString(authStr, login, salt, hash)) {
-        writeAll(sock, "ERR", 3); 
-        logMsg(logFile, "Неверный формат аутентификации: " + 
-                        (authStr.length() > 50 ? authStr.substr(0, 50) + "..." : authStr));
-        close(sock); 
-        return; 
+/// Верхняя граница числа рабочих потоков
+static const int MAX_WORKERS = 1024;
+
+/// Верхняя граница таймаута простоя сессии, секунд (сутки)
+static const int MAX_IDLE_TIMEOUT = 86400;
+
+/// Верхняя граница срока билета возобновления, секунд (сутки)
+static const int MAX_TICKET_LIFETIME = 86400;
+
+/**
+ * @brief Создаёт неблокирующий слушающий сокет на указанном порту
+ * @param port Порт
+ * @param reusePort Включить SO_REUSEPORT, чтобы несколько сокетов делили
+ * один порт, а ядро распределяло между ними входящие соединения
+ * @return Дескриптор сокета или -1 при ошибке
+ */
+int createListener(int port, bool reusePort) {
+    int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock < 0) { 
+        perror("Ошибка сокета"); 
+        return -1; 
     }
     
-    // Логируем формат (новый или старый)
-    size_t colonCount = 0;
-    for (char c : authStr) if (c == ':') colonCount++;
-    string format = (colonCount == 2) ? "новый (логин:соль:хэш)" : 
-                   (colonCount == 0 && authStr.length() == 84) ? "старый (логин4+соль16+хэш64)" : "неизвестный";
-    
-    logMsg(logFile, "Аутентификация: " + login + " (формат: " + format + ")");
-    
-    if (!checkAuth(login, salt, hash, users)) {
-        writeAll(sock, "ERR", 3);
-        logMsg(logFile, "Аутентификация отклонена: " + login);
+    int opt = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reusePort && setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        perror("Ошибка SO_REUSEPORT");
         close(sock);
-        return;
+        return -1;
     }
     
-    writeAll(sock, "OK", 2);
-    logMsg(logFile, "Клиент аутентифицирован: " + login);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = INADDR_ANY;
     
-    // Обработка векторов
-    uint8_t buffer[4];
-    if (!readAll(sock, buffer, 4)) { 
-        logMsg(logFile, "Ошибка чтения количества векторов");
+    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) { 
+        perror("Ошибка привязки"); 
         close(sock); 
-        return; 
+        return -1; 
     }
     
-    uint32_t numVectors = readLittleEndian32(buffer);
-    
-    for (uint32_t i = 0; i < numVectors; i++) {
-        if (!readAll(sock, buffer, 4)) {
-            logMsg(logFile, "Ошибка чтения размера вектора");
-            close(sock);
+    if (listen(sock, SOMAXCONN) < 0) { 
+        perror("Ошибка прослушивания"); 
+        close(sock); 
+        return -1; 
+    }
+    return sock;
+}
+
+/**
+ * @brief Перезагружает базу пользователей по сигналу и изменению файла
+ *
+ * @details Поток ждёт SIGHUP (через signalfd; сигнал заблокирован во всех
+ * потоках) и, если задан inotifyFd, событий каталога базы: запись
+ * закончена (IN_CLOSE_WRITE) или файл подменён переименованием
+ * (IN_MOVED_TO, так пишет userdb). Новая база загружается здесь же,
+ * вне потоков сессий, и публикуется в ctx.users; пустая или
+ * нечитаемая база не заменяет текущую.
+ *
+ * SIGTERM и SIGINT приходят сюда же: журнал дописывается, и процесс
+ * завершается тем же сигналом, как и без обработчика.
+ * @param userFile Файл базы
+ * @param ctx Параметры сервера
+ * @param sigFd signalfd для SIGHUP, SIGTERM и SIGINT
+ * @param inotifyFd inotify с наблюдением каталога базы (-1 - не следить)
+ */
+void reloadUsers(const string &userFile, ServerContext &ctx, int sigFd, int inotifyFd) {
+    size_t slash = userFile.rfind('/');
+    string name = slash == string::npos ? userFile : userFile.substr(slash + 1);
+
+    pollfd fds[2] = {{sigFd, POLLIN, 0}, {inotifyFd, POLLIN, 0}};
+    while (true) {
+        if (poll(fds, inotifyFd >= 0 ? 2 : 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("Ошибка ожидания перезагрузки базы");
             return;
         }
-        
-        uint32_t vectorSize = readLittleEndian32(buffer);
-        float sum = 0.0f;
-        
-        for (uint32_t j = 0; j < vectorSize; j++) {
-            if (!readAll(sock, buffer, 4)) {
-                logMsg(logFile, "Ошибка чтения данных вектора");
-                close(sock);
-                return;
+        bool reload = false;
+        if (fds[0].revents & POLLIN) {
+            signalfd_siginfo info;
+            if (read(sigFd, &info, sizeof(info)) == sizeof(info)) {
+                if (info.ssi_signo == SIGHUP) {
+                    reload = true;
+                } else {
+                    // Асинхронный журнал теряет то, что не успел записать
+                    int signo = info.ssi_signo;
+                    logMsg("=== Остановка сервера по сигналу " + to_string(signo) + " ===");
+                    logFlush();
+                    signal(signo, SIG_DFL);
+                    sigset_t stop;
+                    sigemptyset(&stop);
+                    sigaddset(&stop, signo);
+                    pthread_sigmask(SIG_UNBLOCK, &stop, nullptr);
+                    raise(signo);
+                }
             }
-            
-            uint32_t val = readLittleEndian32(buffer);
-            float f;
-            memcpy(&f, &val, sizeof(float));
-            sum += f * f;
         }
-        
-        logMsg(logFile, "Вектор " + to_string(i+1) + ": сумма квадратов = " + to_string(sum));
-        
-        uint32_t resultBits;
-        memcpy(&resultBits, &sum, sizeof(float));
-        uint8_t resultBuffer[4];
-        writeLittleEndian32(resultBits, resultBuffer);
-        
-        if (!writeAll(sock, resultBuffer, 4)) {
-            logMsg(logFile, "Ошибка отправки результата");
-            close(sock);
-            return;
+        if (inotifyFd >= 0 && (fds[1].revents & POLLIN)) {
+            alignas(inotify_event) char buf[4096];
+            ssize_t n = read(inotifyFd, buf, sizeof(buf));
+            for (ssize_t pos = 0; pos < n; ) {
+                const inotify_event *ev = (const inotify_event*)(buf + pos);
+                if (ev->len && name == ev->name) reload = true;
+                pos += sizeof(inotify_event) + ev->len;
+            }
+        }
+        if (!reload) continue;
+
+        UserStore fresh = loadUsers(userFile);
+        if (fresh.empty()) {
+            logMsg("Перезагрузка базы пользователей отменена: нет пользователей в " + userFile);
+            continue;
         }
+        string info = to_string(fresh.size()) + (fresh.mapped() ? " (двоичный образ)" : " (текстовый файл)");
+        ctx.users.publish(move(fresh));
+        logMsg("База пользователей перезагружена, пользователей: " + info);
     }
+}
+
+/**
+ * @brief Закрепляет текущий поток за index-м доступным процессу ядром
+ */
+void pinToCpu(int index) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+    int count = CPU_COUNT(&allowed);
+    if (count == 0) return;
     
-    logMsg(logFile, "Вычисления завершены для " + to_string(numVectors) + " векторов");
-    close(sock);
+    int target = index % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed)) continue;
+        if (target-- == 0) {
+            cpu_set_t one;
+            CPU_ZERO(&one);
+            CPU_SET(cpu, &one);
+            pthread_setaffinity_np(pthread_self(), sizeof(one), &one);
+            return;
+        }
+    }
 }
 
 // Основная логика сервера
@@ -257,13 +263,46 @@ extern "C" int main_server(int argc, char *argv[]) {
     string userFile = "users.txt";
     string logFile = "server.log";
     int port = 33333;
+    int workers = 1;
+    string backend = "epoll";
+    unsigned long parallelThreshold = 0;
+    int reduceThreads = 0;
+    int streamBuffers = 0;
+    int idleTimeout = 60;
+    int ticketLifetime = 300;
+    string localSocket;
+    bool watchUsers = false;
+    string logLevelName = "debug";
+    string logOverflow = "drop";
     
     po::options_description desc("Сервер vcalc v1.0\n\nИспользование: server [options]\n\nДоступные опции");
     desc.add_options()
         ("help,h", "Показать справку")
-        ("database,d", po::value<string>(&userFile)->default_value("users.txt"), "Файл с базой пользователей")
+        ("database,d", po::value<string>(&userFile)->default_value("users.txt"), "Файл с базой пользователей: текст логин:пароль или образ userdb")
         ("log,l", po::value<string>(&logFile)->default_value("server.log"), "Файл логов")
-        ("port,p", po::value<int>(&port)->default_value(33333), "Порт сервера");
+        ("log-level", po::value<string>(&logLevelName)->default_value("debug"),
+         "Уровень журнала: error, info (без строк о каждом векторе) или debug")
+        ("log-overflow", po::value<string>(&logOverflow)->default_value("drop"),
+         "Если журнал не успевает писать: drop - пропускать сообщения, block - ждать")
+        ("port,p", po::value<int>(&port)->default_value(33333), "Порт сервера")
+        ("workers,w", po::value<int>(&workers)->default_value(1), "Число рабочих потоков (у каждого свой сокет SO_REUSEPORT и цикл epoll)")
+        ("pin-cpus", "Закрепить рабочие потоки за ядрами процессора")
+        ("io-backend", po::value<string>(&backend)->default_value("epoll"), "Транспорт ввода-вывода: epoll или io_uring")
+        ("parallel-threshold", po::value<unsigned long>(&parallelThreshold)->default_value(0),
+         "Векторы от стольких элементов считать параллельно на пуле потоков (0 - выключено)")
+        ("reduce-threads", po::value<int>(&reduceThreads)->default_value(0),
+         "Число потоков пула: задания с номерами и параллельная редукция (0 - по числу ядер)")
+        ("stream-buffers", po::value<int>(&streamBuffers)->default_value(0),
+         "Блоков по 64 КиБ на соединение: пока одни считаются, в другие принимаются данные "
+         "(2 - двойная буферизация, 0 - два на поток пула и ещё один)")
+        ("idle-timeout", po::value<int>(&idleTimeout)->default_value(60),
+         "Закрывать сессию, не присылавшую данных столько секунд (0 - не закрывать)")
+        ("ticket-lifetime", po::value<int>(&ticketLifetime)->default_value(300),
+         "Срок билета возобновления сессии и смены его ключа, секунд (0 - билеты выключены)")
+        ("watch-users", po::bool_switch(&watchUsers),
+         "Перезагружать базу пользователей при изменении файла (SIGHUP перезагружает всегда)")
+        ("unix-socket", po::value<string>(&localSocket),
+         "Unix-сокет для клиентов на этом узле: векторы передаются через общую память");
     
     po::variables_map vm;
     try {
@@ -287,22 +326,105 @@ extern "C" int main_server(int argc, char *argv[]) {
         #endif
     }
     
+    LogLevel logLevel;
+    if (!parseLogLevel(logLevelName, logLevel) || (logOverflow != "drop" && logOverflow != "block")) {
+        #ifdef TEST_MODE
+        return 1;
+        #else
+        cerr << "Ошибка: Уровень журнала - error, info или debug, переполнение - drop или block" << endl;
+        return 1;
+        #endif
+    }
+    
+    #ifndef TEST_MODE
+    // Журнал пишет отдельный поток; деструктор дописывает его при выходе из main
+    Logger logger(logFile, logLevel, logOverflow == "block" ? LogOverflow::Block : LogOverflow::Drop);
+    if (!logger.opened()) cerr << "Предупреждение: не удаётся открыть журнал " << logFile << endl;
+    #endif
+    
     if (port <= 0 || port > 65535) {
         #ifdef TEST_MODE
         return 1;
         #else
         cerr << "Ошибка: Порт должен быть в диапазоне 1-65535" << endl;
-        logMsg(logFile, "ОШИБКА: Неверный порт " + to_string(port));
+        logMsg(LogLevel::Error, "ОШИБКА: Неверный порт " + to_string(port));
+        return 1;
+        #endif
+    }
+    
+    if (workers < 1 || workers > MAX_WORKERS) {
+        #ifdef TEST_MODE
+        return 1;
+        #else
+        cerr << "Ошибка: Число рабочих потоков должно быть в диапазоне 1-" << MAX_WORKERS << endl;
+        return 1;
+        #endif
+    }
+    bool pinCpus = vm.count("pin-cpus") > 0;
+    
+    if (backend != "epoll" && backend != "io_uring") {
+        #ifdef TEST_MODE
+        return 1;
+        #else
+        cerr << "Ошибка: Неизвестный транспорт " << backend << " (допустимо: epoll, io_uring)" << endl;
+        return 1;
+        #endif
+    }
+    
+    if (reduceThreads < 0 || reduceThreads > MAX_WORKERS) {
+        #ifdef TEST_MODE
+        return 1;
+        #else
+        cerr << "Ошибка: Число потоков редукции должно быть в диапазоне 0-" << MAX_WORKERS << endl;
+        return 1;
+        #endif
+    }
+    
+    if (streamBuffers < 0 || streamBuffers == 1 || streamBuffers > 2 * MAX_WORKERS + 1) {
+        #ifdef TEST_MODE
+        return 1;
+        #else
+        cerr << "Ошибка: Число блоков конвейера должно быть 0 или в диапазоне 2-" << 2 * MAX_WORKERS + 1 << endl;
+        return 1;
+        #endif
+    }
+    
+    if (idleTimeout < 0 || idleTimeout > MAX_IDLE_TIMEOUT) {
+        #ifdef TEST_MODE
+        return 1;
+        #else
+        cerr << "Ошибка: Таймаут простоя должен быть в диапазоне 0-" << MAX_IDLE_TIMEOUT << " с" << endl;
+        return 1;
+        #endif
+    }
+    
+    if (ticketLifetime < 0 || ticketLifetime > MAX_TICKET_LIFETIME) {
+        #ifdef TEST_MODE
+        return 1;
+        #else
+        cerr << "Ошибка: Срок билета должен быть в диапазоне 0-" << MAX_TICKET_LIFETIME << " с" << endl;
+        return 1;
+        #endif
+    }
+    
+    if (vm.count("unix-socket") && (localSocket.empty() || localSocket.size() >= sizeof(sockaddr_un::sun_path))) {
+        #ifdef TEST_MODE
+        return 1;
+        #else
+        cerr << "Ошибка: Путь Unix-сокета должен быть непустым и короче " << sizeof(sockaddr_un::sun_path) << " символов" << endl;
         return 1;
         #endif
     }
     
     #ifndef TEST_MODE
-    logMsg(logFile, "=== Запуск сервера ===");
+    logMsg("=== Запуск сервера ===");
     #endif
     
-    auto users = loadUsers(userFile);
-    if (users.empty()) {
+    ServerContext ctx;
+    ctx.users.publish(loadUsers(userFile));
+    ctx.idleTimeout = idleTimeout;
+    ctx.tickets.setLifetime(ticketLifetime);
+    if (ctx.users.read()->empty()) {
         #ifdef TEST_MODE
         return 1;
         #else
@@ -315,42 +437,138 @@ extern "C" int main_server(int argc, char *argv[]) {
     return 0;
     #endif
     
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) { 
-        perror("Ошибка сокета"); 
-        return 1; 
+    // Все слушающие сокеты создаются до запуска потоков, чтобы ошибка
+    // привязки была обнаружена сразу
+    vector<int> listeners;
+    for (int i = 0; i < workers; i++) {
+        int sock = createListener(port, workers > 1);
+        if (sock < 0) {
+            for (int l : listeners) close(l);
+            return 1;
+        }
+        listeners.push_back(sock);
+    }
+    int localListener = -1;
+    if (!localSocket.empty()) {
+        localListener = createLocalListener(localSocket);
+        if (localListener < 0) {
+            for (int l : listeners) close(l);
+            return 1;
+        }
     }
     
-    int opt = 1;
-    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    // Запись в закрытый клиентом сокет не должна завершать сервер
+    signal(SIGPIPE, SIG_IGN);
     
-    sockaddr_in addr = {};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(port);
-    addr.sin_addr.s_addr = INADDR_ANY;
+    // SIGHUP, SIGTERM и SIGINT принимает только поток перезагрузки базы:
+    // сигналы блокируются до запуска потоков, и они наследуют маску
+    sigset_t handled;
+    sigemptyset(&handled);
+    sigaddset(&handled, SIGHUP);
+    sigaddset(&handled, SIGTERM);
+    sigaddset(&handled, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &handled, nullptr);
+    int sigFd = signalfd(-1, &handled, SFD_CLOEXEC);
+    int inotifyFd = -1;
+    if (watchUsers) {
+        size_t slash = userFile.rfind('/');
+        string dir = slash == string::npos ? "." : slash == 0 ? "/" : userFile.substr(0, slash);
+        inotifyFd = inotify_init1(IN_CLOEXEC);
+        if (inotifyFd < 0 || inotify_add_watch(inotifyFd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            perror("Ошибка inotify");
+            if (inotifyFd >= 0) close(inotifyFd);
+            inotifyFd = -1;
+        }
+    }
+    if (sigFd >= 0) {
+        // Поток не завершается: он живёт, пока живёт процесс
+        thread(reloadUsers, userFile, ref(ctx), sigFd, inotifyFd).detach();
+    } else {
+        perror("Ошибка signalfd");
+        sigdelset(&handled, SIGHUP);
+        pthread_sigmask(SIG_UNBLOCK, &handled, nullptr);
+    }
     
-    if (bind(sock, (sockaddr*)&addr, sizeof(addr)) < 0) { 
-        perror("Ошибка привязки"); 
-        close(sock); 
-        return 1; 
+    bool useUring = backend == "io_uring";
+    if (useUring && !UringLoop::supported()) {
+        cerr << "Предупреждение: io_uring не поддерживается ядром, используется epoll" << endl;
+        logMsg("io_uring недоступен, используется epoll");
+        useUring = false;
+    }
+    if (useUring) {
+        // io_uring сам ожидает готовности сокета: слушающий сокет блокирующий
+        for (int l : listeners) fcntl(l, F_SETFL, fcntl(l, F_GETFL) & ~O_NONBLOCK);
     }
     
-    if (listen(sock, 5) < 0) { 
-        perror("Ошибка прослушивания"); 
-        close(sock); 
-        return 1; 
+    cout << "Сервер запущен на порту " << port << " (рабочих потоков: " << workers
+         << ", транспорт: " << (useUring ? "io_uring" : "epoll") << ")" << endl;
+    logMsg("Рабочих потоков: " + to_string(workers) + ", транспорт: " +
+                    (useUring ? "io_uring" : "epoll") + ", ядро суммы квадратов: " + sumOfSquaresImpl() +
+                    ", SHA-256: " + sha256Impl() + " (пачкой: " + sha256ManyImpl() + ")");
+    {
+        auto users = ctx.users.read();
+        logMsg("Пользователей: " + to_string(users->size()) +
+                        (users->mapped() ? " (двоичный образ)" : " (текстовый файл)"));
     }
+    if (idleTimeout > 0) logMsg("Таймаут простоя сессии: " + to_string(idleTimeout) + " с");
+    if (ticketLifetime > 0) logMsg("Билеты возобновления: срок и смена ключа " + to_string(ticketLifetime) + " с");
+    if (localListener >= 0) logMsg("Локальные клиенты: " + localSocket);
     
-    cout << "Сервер запущен на порту " << port << endl;
+    // Один пул на все рабочие потоки: на нём считаются задания с номерами
+    // и, если задан порог, длинные векторы
+    WorkPool pool(reduceThreads);
+    ctx.pool = &pool;
+    logMsg("Потоков пула: " + to_string(pool.size()));
+    if (parallelThreshold > 0) {
+        ctx.parallelThreshold = parallelThreshold;
+        ctx.streamBuffers = streamBuffers ? streamBuffers : 2 * pool.size() + 1;
+        logMsg("Параллельная редукция векторов от " + to_string(parallelThreshold) +
+                        " элементов, блоков конвейера на соединение: " + to_string(ctx.streamBuffers) +
+                        " (" + to_string(ctx.streamBuffers * ChunkedSum::CHUNK * 4 / 1024) + " КиБ)");
+    }
     
-    while (true) {
-        sockaddr_in client;
-        socklen_t len = sizeof(client);
-        int clientSock = accept(sock, (sockaddr*)&client, &len);
-        if (clientSock < 0) continue;
-        handleClient(clientSock, users, logFile);
+    atomic<bool> failed{false};
+    vector<thread> threads;
+    for (int i = 0; i < workers; i++) {
+        threads.emplace_back([&, i]() {
+            if (pinCpus) pinToCpu(i);
+            bool ok = false;
+            bool uring = useUring;
+            if (uring) {
+                UringLoop loop(listeners[i], ctx);
+                if (loop.open()) {
+                    ok = loop.run();
+                } else {
+                    // Сокет потока уже в группе SO_REUSEPORT: без цикла ядро
+                    // отдавало бы ему соединения, которые никто не примет
+                    logMsg(LogLevel::Error, "Поток " + to_string(i) + ": io_uring не запустился, используется epoll");
+                    fcntl(listeners[i], F_SETFL, fcntl(listeners[i], F_GETFL) | O_NONBLOCK);
+                    uring = false;
+                }
+            }
+            if (!uring) {
+                Reactor reactor(listeners[i], ctx);
+                ok = reactor.run();
+            }
+            if (!ok) {
+                // Закрытый сокет выходит из группы SO_REUSEPORT: новые
+                // соединения достаются остальным потокам
+                close(listeners[i]);
+                listeners[i] = -1;
+                failed = true;
+            }
+        });
     }
+    if (localListener >= 0) {
+        // Локальные клиенты обслуживаются отдельным потоком
+        threads.emplace_back([&]() {
+            LocalServer local(localListener, ctx);
+            if (!local.run()) failed = true;
+        });
+    }
+    for (auto &t : threads) t.join();
     
-    close(sock);
-    return 0;
+    for (int l : listeners) if (l >= 0) close(l);
+    if (localListener >= 0) close(localListener);
+    return failed ? 1 : 0;
 }
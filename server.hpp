@@ -0,0 +1,33 @@
+/**
+ * @file server.hpp
+ * @brief Общие функции сервера vcalc (журнал, аутентификация, кодирование чисел)
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "logger.hpp"
+#include "users.hpp"
+
+/**
+ * @brief Парсит строку аутентификации, поддерживая оба формата
+ * @return true если успешно, false если ошибка
+ */
+bool parseAuthString(const std::string &authStr, std::string &login, std::string &salt, std::string &hash);
+
+/**
+ * @brief Проверяет, является ли строка шестнадцатеричной
+ */
+bool isHexString(const std::string &str);
+
+/**
+ * @brief Читает 32-битное число в порядке little-endian
+ */
+uint32_t readLittleEndian32(const uint8_t *bytes);
+
+/**
+ * @brief Записывает 32-битное число в порядке little-endian
+ */
+void writeLittleEndian32(uint32_t value, uint8_t *bytes);
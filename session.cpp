@@ -0,0 +1,520 @@
+/**
+ * @file session.cpp
+ * @brief Реализация сессии клиента vcalc
+ */
+
+#include "session.hpp"
+#include "server.hpp"
+#include "kernels.hpp"
+#include "reduction.hpp"
+#include "protocol.hpp"
+#include "ops.hpp"
+#include "jobs.hpp"
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+using namespace std;
+
+/// Максимальная длина сообщения аутентификации
+static const size_t AUTH_MAX = 255;
+
+/**
+ * @brief Результаты вектора для журнала
+ */
+static string resultLog(const VectorHeader &hdr, const double *results) {
+    if (!hdr.fused()) {
+        return "сумма квадратов = " + to_string(results[0]) +
+               (hdr.extended ? string(" (") + accumModeName(hdr.mode) + ")" : string());
+    }
+    string line;
+    unsigned k = 0;
+    for (const auto &op : vectorOps()) {
+        if (!(hdr.ops & op.op)) continue;
+        line += string(k ? ", " : "") + op.name + " = " + to_string(results[k]);
+        k++;
+    }
+    if (hdr.dtype != ElemType::F32) line += string(" (") + elemTypeName(hdr.dtype) + ")";
+    if (hdr.sparse) line += " (разреженный, " + to_string(hdr.nnz) + " ненулевых)";
+    return line;
+}
+
+Session::Session(int sock, const ServerContext &ctx, int wakeFd, AuthBatch *auth)
+    : sock(sock), ctx(ctx), wakeFd(wakeFd), auth(auth), task(run()) {
+    // Ответы, готовые за одно пробуждение, и так уходят одним send(), а
+    // Нагл задержал бы каждый из них до подтверждения предыдущего (которое
+    // клиент откладывает): отключаем его. TCP_CORK не нужен по той же
+    // причине - склейка ответов уже сделана в буфере out
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    checkError();
+}
+
+Session::~Session() {
+    close(sock);
+}
+
+void Session::ReadAwaiter::await_suspend(coroutine_handle<> h) {
+    s.resumeHandle = h;
+    s.wait = Wait::Read;
+    s.readNeed = need;
+    s.readLimit = limit;
+    s.readError = error;
+    s.readBoundary = boundary;
+}
+
+bool Session::ComputeAwaiter::await_ready() const {
+    if (s.wakeFd >= 0) return !s.chunked->waitAsync(s.wakeFd);
+    // Транспорт не умеет просыпаться по пулу: ждём в его потоке
+    s.chunked->wait();
+    return true;
+}
+
+bool Session::AuthAwaiter::await_ready() {
+    if (s.auth) return false;
+    AuthRequest *r = &request;
+    checkAuthBatch(&r, 1, *s.ctx.users.read());
+    return true;
+}
+
+void Session::AuthAwaiter::await_suspend(coroutine_handle<> h) {
+    s.resumeHandle = h;
+    s.wait = Wait::Auth;
+    s.authRequest = &request;
+    s.auth->add(&s);
+}
+
+void AuthBatch::run(const UserRegistry &users) {
+    requests.clear();
+    for (Session *s : sessions) requests.push_back(s->authRequest);
+    checkAuthBatch(requests.data(), requests.size(), *users.read());
+    for (Session *s : sessions) s->authRequest = nullptr;
+    sessions.clear();
+}
+
+bool Session::JobAwaiter::await_ready() const {
+    if (!s.jobs) return true;
+    s.jobNeed = need;
+    if (s.jobsReady()) return true;
+    if (s.wakeFd >= 0) return false;
+    // Транспорт не умеет просыпаться по пулу: ждём в его потоке
+    while (!s.jobsReady()) s.jobs->waitOne();
+    return true;
+}
+
+void Session::JobAwaiter::await_suspend(coroutine_handle<> h) {
+    s.resumeHandle = h;
+    s.wait = Wait::Compute;
+    s.jobWait = true;
+}
+
+/**
+ * @brief Отправляет ответы готовых заданий и проверяет, чего ждёт JobAwaiter
+ */
+bool Session::jobsReady() {
+    collectJobs();
+    return jobNeed == SIZE_MAX ? jobs->pending() == 0 : jobs->hasRoom(jobNeed);
+}
+
+/**
+ * @brief Ставит в очередь ответы готовых заданий и взводит уведомление о следующих
+ */
+void Session::collectJobs() {
+    if (!jobs) return;
+    do {
+        jobs->collect([this](const Job &job) { finishJob(job); });
+    } while (jobs->arm());
+}
+
+void Session::finishJob(const Job &job) {
+    uint8_t reply[4 + 1 + 8 * MAX_VECTOR_RESULTS];
+    writeLittleEndian32(job.id, reply);
+    reply[4] = (uint8_t)job.resultCount;
+    for (unsigned k = 0; k < job.resultCount; k++)
+        writeLittleEndianDouble(job.results[k], reply + 5 + 8 * k);
+    out.append((const char*)reply, 5 + 8 * job.resultCount);
+
+    if (job.resultCount == 0) logMsg(LogLevel::Error, "Неверный вектор задания " + to_string(job.id));
+    else if (logEnabled(LogLevel::Debug))
+        logMsg(LogLevel::Debug, "Задание " + to_string(job.id) + ": " + resultLog(job.hdr, job.results));
+}
+
+bool Session::wantsWake() const {
+    return !failed && (wait == Wait::Compute || (jobs && jobs->pending() > 0));
+}
+
+Session::WriteAwaiter Session::writeAll(const void *data, size_t len) {
+    out.append((const char*)data, len);
+    return {*this};
+}
+
+void Session::resume() {
+    wait = Wait::None;
+    resumeHandle.resume();
+    checkError();
+}
+
+/**
+ * @brief Закрывает сессию, если корутина завершилась исключением
+ */
+void Session::checkError() {
+    exception_ptr error = task.handle.promise().error;
+    if (!error || failed) return;
+    try {
+        rethrow_exception(error);
+    } catch (exception &e) {
+        logMsg(LogLevel::Error, string("Ошибка сессии: ") + e.what());
+    } catch (...) {
+        logMsg(LogLevel::Error, "Ошибка сессии");
+    }
+    failed = true;
+}
+
+void Session::process() {
+    if (failed) return;
+    gotInput = true;
+    collectJobs();
+    if (wait == Wait::Read && in.size() >= readNeed) {
+        resume();
+    } else if (wait == Wait::Auth && !authRequest) {
+        resume();
+    } else if (wait == Wait::Compute && (jobWait ? jobsReady() : !chunked->waitAsync(wakeFd))) {
+        jobWait = false;
+        resume();
+    }
+}
+
+bool Session::idleTick() {
+    // Простой - только ожидание клиента: пока сессия считает или ждёт
+    // отправки ответов, счётчик сброшен
+    if (failed || !wantsInput() || gotInput || ctx.idleTimeout == 0) {
+        gotInput = false;
+        idleSeconds = 0;
+        return false;
+    }
+    if (++idleSeconds < ctx.idleTimeout) return false;
+    logMsg("Сессия закрыта по простою (" + to_string(ctx.idleTimeout) + " с)");
+    failed = true;
+    return true;
+}
+
+void Session::readFailed(bool closed) {
+    if (wait != Wait::Read || failed) return;
+    if (closed && readBoundary && in.size() == 0) logMsg("Клиент отключился");
+    else logMsg(LogLevel::Error, readError);
+    failed = true;
+}
+
+void Session::sendFailed() {
+    if (failed) return;
+    logMsg(LogLevel::Error, "Ошибка отправки результата");
+    failed = true;
+}
+
+bool Session::nextOutput(const char *&data, size_t &len) {
+    if (sendPos == sending.size()) {
+        if (out.empty()) return false;
+        sending.clear();
+        sendPos = 0;
+        sending.swap(out);
+    }
+    data = sending.data() + sendPos;
+    len = sending.size() - sendPos;
+    return true;
+}
+
+void Session::sent(size_t n) {
+    sendPos += n;
+    if (wait == Wait::Write && !failed && pendingOutput() <= OUT_HIGH_WATER) resume();
+}
+
+Session::Task Session::run() {
+    logMsg("Клиент подключен");
+
+    // Аутентификация: сообщение - это первая порция данных клиента
+    // (не более 255 байт), как и в прежней блокирующей версии
+    co_await readSome(AUTH_MAX, "Ошибка чтения аутентификации");
+    string login;
+    bool accepted;
+    if (in.data()[0] == AUTH_BINARY) {
+        // Двоичное рукопожатие: длина кадра известна по первым трём байтам,
+        // логин, соль и дайджест проверяются прямо в приёмном буфере
+        co_await readExact(AUTH_BINARY_PREFIX, "Ошибка чтения аутентификации");
+        size_t frameLen = authFrameSize(in.data());
+        if (frameLen == 0) {
+            co_await writeAll("ERR", 3);
+            logMsg(LogLevel::Error, "Неподдерживаемое двоичное рукопожатие (версия " + to_string(in.data()[1]) + ")");
+            co_return;
+        }
+        co_await readExact(frameLen, "Ошибка чтения аутентификации");
+        if (in.data()[1] == AUTH_TICKET) {
+            // Билет проверяется одним HMAC, без базы пользователей
+            string_view ticketLogin;
+            accepted = ctx.tickets.verify(in.data() + AUTH_BINARY_PREFIX, frameLen - AUTH_BINARY_PREFIX,
+                                          time(nullptr), ticketLogin);
+            login.assign(accepted ? ticketLogin : "(билет)");
+            logMsg("Аутентификация: " + login + " (формат: билет)");
+        } else {
+            AuthRequest request = parseAuthFrame(in.data());
+            login.assign(request.login);
+            logMsg("Аутентификация: " + login + " (формат: двоичный v2)");
+            accepted = co_await checkPassword(request);
+        }
+        in.consume(frameLen);
+    } else {
+        size_t authLen = min(in.size(), AUTH_MAX);
+        string authStr((const char*)in.data(), strnlen((const char*)in.data(), authLen));
+        in.consume(authLen);
+
+        // Парсинг строки аутентификации
+        string salt, hash;
+        if (!parseAuthString(authStr, login, salt, hash)) {
+            co_await writeAll("ERR", 3);
+            logMsg(LogLevel::Error, "Неверный формат аутентификации: " +
+                            (authStr.length() > 50 ? authStr.substr(0, 50) + "..." : authStr));
+            co_return;
+        }
+
+        // Логируем формат (новый или старый)
+        size_t colonCount = 0;
+        for (char c : authStr) if (c == ':') colonCount++;
+        string format = (colonCount == 2) ? "новый (логин:соль:хэш)" :
+                       (colonCount == 0 && authStr.length() == 84) ? "старый (логин4+соль16+хэш64)" : "неизвестный";
+
+        logMsg("Аутентификация: " + login + " (формат: " + format + ")");
+        AuthRequest request;
+        request.login = login;
+        request.salt = salt;
+        request.hash = hash;
+        accepted = co_await checkPassword(request);
+    }
+
+    if (!accepted) {
+        co_await writeAll("ERR", 3);
+        logMsg("Аутентификация отклонена: " + login);
+        co_return;
+    }
+
+    co_await writeAll("OK", 2);
+    logMsg("Клиент аутентифицирован: " + login);
+
+    // Задания (число векторов и векторы) идут друг за другом, пока клиент
+    // не закроет сессию: повторное подключение стоило бы рукопожатия TCP
+    // и проверки пароля. Обрыв между заданиями - обычное завершение
+    for (uint64_t job = 0; ; job++) {
+        if (job) co_await readNextJob(4, "Ошибка чтения количества векторов");
+        else co_await readExact(4, "Ошибка чтения количества векторов");
+        uint32_t numVectors = readLittleEndian32(in.data());
+        in.consume(4);
+
+        if (numVectors == JOB_FRAME) {
+            // Задание с номером: кадр принимается целиком и уходит в пул,
+            // а сессия сразу читает следующее задание. Ответ отправит
+            // process(), когда задание будет готово
+            co_await readExact(8, "Ошибка чтения заголовка задания");
+            uint32_t id = readLittleEndian32(in.data());
+            uint32_t len = readLittleEndian32(in.data() + 4);
+            in.consume(8);
+            if (len > JOB_FRAME_MAX) {
+                logMsg(LogLevel::Error, "Слишком длинное задание " + to_string(id) + ": " + to_string(len) + " байт");
+                co_return;
+            }
+            if (!jobs) jobs = make_unique<JobQueue>(ctx.pool, wakeFd);
+            co_await jobSlot(len);
+            Job &tagged = jobs->start(id, len);
+            for (size_t got = 0; got < len; ) {
+                co_await readExact(1, "Ошибка чтения данных задания");
+                size_t n = min<size_t>(len - got, in.size());
+                memcpy(tagged.frame.data() + got, in.data(), n);
+                in.consume(n);
+                got += n;
+            }
+            jobs->submit(tagged);
+            collectJobs();
+            continue;
+        }
+
+        // Ответы остальных заданий идут по порядку: сначала отправляются
+        // все задания с номерами
+        co_await jobsDone();
+
+        if (numVectors == SESSION_CLOSE) {
+            logMsg("Клиент завершил сессию (заданий: " + to_string(job) + ")");
+            co_return;
+        }
+
+        if (numVectors == TICKET_REQUEST) {
+            // Билет возобновления: uint8 длина и билет (0 - билеты выключены)
+            uint8_t reply[1 + TICKET_MAX];
+            size_t len = ctx.tickets.issue(login, time(nullptr), reply + 1);
+            reply[0] = (uint8_t)len;
+            co_await writeAll(reply, 1 + len);
+            continue;
+        }
+
+        if (!vectorCountValid(numVectors)) {
+            // Неизвестная метка: что идёт за ней, разобрать нельзя
+            co_await writeAll("ERR", 3);
+            logMsg(LogLevel::Error, "Неверное число векторов: " + to_string(numVectors));
+            co_return;
+        }
+
+        // Пакет: размеры всех векторов приходят одним заголовком, а ответы
+        // копятся и уходят одним массивом, а не сегментом на вектор
+        bool batch = numVectors == BATCH_FRAME;
+        AccumMode batchMode = AccumMode::Float;
+        vector<uint32_t> batchSizes;
+        string batchResults;
+        if (batch) {
+            co_await readExact(BATCH_PREFIX, "Ошибка чтения заголовка пакета");
+            if (!parseBatchHeader(in.data(), numVectors, batchMode)) {
+                logMsg(LogLevel::Error, "Неверный заголовок пакета");
+                co_return;
+            }
+            in.consume(BATCH_PREFIX);
+            batchSizes.resize(numVectors);
+            for (uint32_t j = 0; j < numVectors; ) {
+                co_await readExact(4, "Ошибка чтения заголовка пакета");
+                size_t count = min<size_t>(numVectors - j, in.size() / 4);
+                for (size_t k = 0; k < count; k++) batchSizes[j + k] = readLittleEndian32(in.data() + 4 * k);
+                in.consume(4 * count);
+                j += count;
+            }
+            batchResults.reserve(8 * (size_t)numVectors);
+            logMsg("Пакет из " + to_string(numVectors) + " векторов");
+        }
+
+        for (uint32_t i = 0; i < numVectors; i++) {
+            VectorHeader hdr;
+            if (batch) {
+                hdr.size = batchSizes[i];
+                hdr.mode = batchMode;
+                hdr.extended = true;
+            } else {
+                co_await readExact(4, "Ошибка чтения размера вектора");
+                hdr.size = readLittleEndian32(in.data());
+                in.consume(4);
+                if (!vectorSizeValid(hdr.size)) {
+                    co_await writeAll("ERR", 3);
+                    logMsg(LogLevel::Error, "Неверный размер вектора " + to_string(i+1) + ": " + to_string(hdr.size));
+                    co_return;
+                }
+            }
+
+            if (!batch && hdr.size == EXT_VECTOR) {
+                // Расширенный заголовок: байт длины и поля
+                co_await readExact(1, "Ошибка чтения заголовка вектора");
+                size_t hdrLen = in.data()[0];
+                co_await readExact(1 + hdrLen, "Ошибка чтения заголовка вектора");
+                if (!parseVectorHeader(in.data() + 1, hdrLen, hdr)) {
+                    logMsg(LogLevel::Error, "Неверный заголовок вектора " + to_string(i+1));
+                    co_return;
+                }
+                in.consume(1 + hdrLen);
+            }
+            uint32_t vectorSize = hdr.size;
+            double results[MAX_VECTOR_RESULTS];
+            unsigned resultCount = 1;
+
+            if (hdr.fused()) {
+                // Набор операций, элементы не float или разреженный вектор: все
+                // операции считаются одним проходом по данным, блоками по
+                // SQUARE_BLOCK элементов (или пар элементов)
+                FusedReduction fused(hdr.ops, hdr.dtype, hdr.scale);
+                size_t width = fused.elemSize();
+                if (hdr.sparse) {
+                    // Значения записей копятся в целый блок, как и плотные
+                    // элементы, так что результат не зависит от порций из сети
+                    SparseDecoder sparse(vectorSize, hdr.nnz, width, fused.paired());
+                    sparseBlock.resize(2 * SQUARE_BLOCK * width);
+                    uint8_t *x = sparseBlock.data(), *y = x + SQUARE_BLOCK * width;
+                    size_t filled = 0;
+                    while (sparse.remaining() > 0 || filled > 0) {
+                        size_t used = 0;
+                        if (!sparse.decode(in.data(), in.size(), used, x, y, filled, SQUARE_BLOCK)) {
+                            logMsg(LogLevel::Error, "Неверная запись разреженного вектора " + to_string(i+1));
+                            co_return;
+                        }
+                        in.consume(used);
+                        if (filled == SQUARE_BLOCK || (filled > 0 && sparse.remaining() == 0)) {
+                            fused.add(x, fused.paired() ? y : nullptr, filled);
+                            filled = 0;
+                        } else if (used == 0) {
+                            // Начало следующей записи ещё не пришло целиком
+                            co_await readExact(in.size() + 1, "Ошибка чтения данных вектора");
+                        }
+                    }
+                    fused.addZeros(vectorSize - hdr.nnz);
+                } else {
+                    size_t elemBytes = width * (fused.paired() ? 2 : 1);
+                    for (uint32_t j = 0; j < vectorSize; ) {
+                        size_t left = vectorSize - j;
+                        co_await readExact(min(left, SQUARE_BLOCK) * elemBytes, "Ошибка чтения данных вектора");
+                        size_t count = min(left, in.size() / elemBytes);
+                        if (count < left) count -= count % SQUARE_BLOCK;
+                        accumulateOps(fused, in.data(), count);
+                        in.consume(count * elemBytes);
+                        j += count;
+                    }
+                }
+                resultCount = fused.results(results);
+            } else if (ctx.pool && ctx.parallelThreshold && vectorSize >= ctx.parallelThreshold) {
+                // Длинный вектор: блоки считаются на общем пуле потоков, а
+                // сессия тем временем принимает следующие. Если все блоки
+                // заняты, сокет не читается, пока пул не освободит старший
+                if (!chunked) chunked = make_unique<ChunkedSum>(*ctx.pool, ctx.streamBuffers);
+                chunked->setMode(hdr.mode);
+                for (uint32_t j = 0; j < vectorSize; ) {
+                    co_await readExact(4, "Ошибка чтения данных вектора");
+                    size_t count = min<size_t>(vectorSize - j, in.size() / 4);
+                    size_t taken = chunked->append(in.data(), count);
+                    in.consume(taken * 4);
+                    j += taken;
+                    if (taken < count) co_await computeDone();
+                }
+                while (chunked->busy()) co_await computeDone();
+                results[0] = chunked->finish();
+            } else {
+                AnySquareSum acc = makeSquareSum(hdr.mode);
+                for (uint32_t j = 0; j < vectorSize; ) {
+                    // Суммируем все целые блоки, уже лежащие в буфере. Неполный
+                    // блок ждёт продолжения, чтобы границы блоков, а значит
+                    // и результат, не зависели от того, как данные пришли из сети
+                    size_t left = vectorSize - j;
+                    co_await readExact(min(left, SQUARE_BLOCK) * 4, "Ошибка чтения данных вектора");
+                    size_t count = min(left, in.size() / 4);
+                    if (count < left) count -= count % SQUARE_BLOCK;
+                    accumulateSquares(acc, in.data(), count);
+                    in.consume(count * 4);
+                    j += count;
+                }
+                results[0] = visit([](auto &s) { return s.result(); }, acc);
+            }
+
+            // Строка о каждом векторе собирается, только если её запишут
+            if (logEnabled(LogLevel::Debug))
+                logMsg(LogLevel::Debug, "Вектор " + to_string(i+1) + ": " + resultLog(hdr, results));
+
+            if (hdr.extended) {
+                uint8_t resultBuffer[8 * MAX_VECTOR_RESULTS];
+                for (unsigned k = 0; k < resultCount; k++)
+                    writeLittleEndianDouble(results[k], resultBuffer + 8 * k);
+                if (batch) batchResults.append((const char*)resultBuffer, 8 * resultCount);
+                else co_await writeAll(resultBuffer, 8 * resultCount);
+            } else {
+                float result = (float)results[0];
+                uint32_t resultBits;
+                memcpy(&resultBits, &result, sizeof(float));
+                uint8_t resultBuffer[4];
+                writeLittleEndian32(resultBits, resultBuffer);
+                co_await writeAll(resultBuffer, 4);
+            }
+        }
+
+        if (batch) co_await writeAll(batchResults.data(), batchResults.size());
+        logMsg("Вычисления завершены для " + to_string(numVectors) + " векторов");
+    }
+}
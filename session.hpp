@@ -0,0 +1,343 @@
+/**
+ * @file session.hpp
+ * @brief Сессия клиента vcalc: протокол в виде корутины C++20
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include "buffer.hpp"
+#include "users.hpp"
+#include "tickets.hpp"
+
+class WorkPool;
+class ChunkedSum;
+class JobQueue;
+struct Job;
+class Session;
+
+/**
+ * @brief Параметры сервера, общие для всех сессий и рабочих потоков
+ */
+struct ServerContext {
+    UserRegistry users;                 ///< База пользователей (заменяется на лету)
+    TicketKeys tickets;                 ///< Ключи билетов возобновления сессии
+    WorkPool *pool = nullptr;           ///< Пул потоков (nullptr - всё считается в потоке транспорта)
+    size_t parallelThreshold = 0;       ///< Векторы от стольких элементов считаются на пуле (0 - не считать)
+    size_t streamBuffers = 0;           ///< Блоков конвейера на соединение (0 - по числу потоков пула)
+    unsigned idleTimeout = 0;           ///< Секунд без данных, после которых сессия закрывается (0 - не закрывать)
+};
+
+/**
+ * @brief Пачка проверок пароля, собранная транспортом за одну итерацию цикла
+ *
+ * @details Сессия, получившая сообщение аутентификации, не считает хэш
+ * сразу, а добавляет себя в пачку и ждёт (Session::wantsAuth()). Транспорт
+ * после разбора всех событий итерации вызывает run() - проверки идут
+ * одним вызовом checkAuthBatch() с многобуферным SHA-256 - и продвигает
+ * дождавшиеся сессии. Задержки нет: пачка - это то, что и так пришло
+ * вместе, например при массовом переподключении клиентов.
+ */
+class AuthBatch {
+public:
+    /// Добавляет сессию, ждущую проверки
+    void add(Session *s) { sessions.push_back(s); }
+
+    bool empty() const { return sessions.empty(); }
+
+    /// Проверяет все собранные запросы по текущей базе и очищает пачку
+    void run(const UserRegistry &users);
+
+private:
+    std::vector<Session*> sessions;
+    std::vector<AuthRequest*> requests;
+};
+
+/**
+ * @brief Состояние одного клиентского соединения
+ *
+ * @details Протокол (аутентификация, затем задания: количество векторов,
+ * заголовок вектора, данные вектора и отправка результата) записан одной корутиной
+ * run() в том же прямолинейном виде, что и прежний блокирующий
+ * handleClient, но вместо блокирующих вызовов она выполняет
+ * co_await readExact() / writeAll(). Приостановленная сессия - это
+ * только кадр корутины, без отдельного потока и стека.
+ *
+ * Сессия не выполняет ввод-вывод сама: транспорт (реактор epoll или цикл
+ * io_uring) складывает принятые байты в приёмный буфер input() и вызывает
+ * process(), который возобновляет корутину, когда ожидаемые данные
+ * получены; ответы транспорт забирает через nextOutput() / sent().
+ *
+ * Длинные векторы считаются на пуле потоков (ChunkedSum). Если все блоки
+ * конвейера заняты, корутина ждёт их, не занимая поток транспорта
+ * (wantsCompute()): пул будит транспорт через eventfd, переданный
+ * в конструктор, и тот снова вызывает process(). Так же пул сообщает
+ * о готовых заданиях с номерами (JobQueue), ответы на которые process()
+ * ставит в очередь отправки сразу (wantsWake()).
+ *
+ * Клиент аутентифицируется текстовой строкой (parseAuthString()),
+ * двоичным рукопожатием v2 (authFrameSize()), которое начинается с нуля,
+ * или билетом возобновления из прошлой сессии (TicketKeys).
+ * Если транспорт передал AuthBatch, пароль проверяется в пачке вместе
+ * с другими подключениями той же итерации (wantsAuth()).
+ *
+ * При обрыве соединения корутина больше не возобновляется: сообщение
+ * об ошибке задаётся в точке ожидания, а кадр уничтожается вместе с сессией.
+ */
+class Session {
+public:
+    /**
+     * @param sock Сокет клиента (сессия становится его владельцем)
+     * @param ctx Параметры сервера
+     * @param wakeFd eventfd транспорта, который пул отмечает по готовности
+     * блоков; -1 - ждать блоки, занимая поток
+     * @param auth Пачка проверок пароля транспорта; nullptr - проверять сразу
+     */
+    Session(int sock, const ServerContext &ctx, int wakeFd = -1, AuthBatch *auth = nullptr);
+    ~Session();
+
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+
+    int fd() const { return sock; }
+
+    /// Приёмный буфер: транспорт дописывает в него данные из сокета
+    RecvBuffer &input() { return in; }
+
+    /// Сколько байт транспорту можно прочитать за один раз
+    size_t inputLimit() const { return readLimit; }
+
+    /// Корутина ждёт данных от клиента
+    bool wantsInput() const { return wait == Wait::Read && !failed; }
+
+    /// Корутина ждёт, пока пул досчитает блоки вектора
+    bool wantsCompute() const { return wait == Wait::Compute && !failed; }
+
+    /// Корутина ждёт проверки пароля в пачке AuthBatch
+    bool wantsAuth() const { return wait == Wait::Auth && !failed; }
+
+    /**
+     * @brief Сессию нужно продвинуть, когда пул отметит eventfd
+     *
+     * @details Кроме ожидания блоков это задания с номерами в работе:
+     * их ответы отправляются по готовности, чего бы ни ждала корутина.
+     */
+    bool wantsWake() const;
+
+    /**
+     * @brief Возобновляет корутину, если ожидаемые ею данные уже в буфере
+     * или досчитан блок, которого она ждёт
+     */
+    void process();
+
+    /**
+     * @brief Отмечает очередную секунду; транспорт вызывает раз в секунду
+     *
+     * @details Сессия, которая ждёт данных и не получила их за
+     * ServerContext::idleTimeout таких отметок подряд, закрывается.
+     * @return true если сессия закрыта по простою
+     */
+    bool idleTick();
+
+    /**
+     * @brief Сообщает о закрытии соединения клиентом или ошибке чтения
+     * @param closed Клиент закрыл соединение (recv вернул 0), а не ошибка
+     * чтения: между заданиями это обычное завершение, не ошибка
+     */
+    void readFailed(bool closed = false);
+
+    /**
+     * @brief Сообщает об ошибке отправки ответа
+     */
+    void sendFailed();
+
+    /**
+     * @brief Возвращает очередную порцию неотправленного ответа
+     * @param data [out] Начало данных; указатель действителен до вызова sent(),
+     * даже если тем временем корутина добавит новые ответы
+     * @param len [out] Длина данных
+     * @return false если отправлять нечего
+     */
+    bool nextOutput(const char *&data, size_t &len);
+
+    /// Отмечает n байт из nextOutput() как отправленные
+    void sent(size_t n);
+
+    /// Все ответы отправлены
+    bool outputDone() const { return sendPos == sending.size() && out.empty(); }
+
+    /// Сессию можно закрыть: протокол завершён и ответы отправлены, либо произошла ошибка
+    bool finished() const { return failed || (task.done() && outputDone()); }
+
+private:
+    /**
+     * @brief Объект-корутина протокола
+     *
+     * @details Стартует сразу (до первого ожидания) и не уничтожается
+     * по завершении, чтобы транспорт мог проверить done(). Исключение
+     * корутины (например, bad_alloc при росте буфера) не выходит в поток
+     * транспорта: оно сохраняется в error, и сессия закрывается (checkError()).
+     */
+    struct Task {
+        struct promise_type {
+            Task get_return_object() {
+                return Task{std::coroutine_handle<promise_type>::from_promise(*this)};
+            }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { error = std::current_exception(); }
+
+            std::exception_ptr error;   ///< Исключение, завершившее корутину
+        };
+
+        explicit Task(std::coroutine_handle<promise_type> h = nullptr) : handle(h) {}
+        Task(const Task &) = delete;
+        Task &operator=(const Task &) = delete;
+        ~Task() { if (handle) handle.destroy(); }
+
+        bool done() const { return !handle || handle.done(); }
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    friend class AuthBatch;
+
+    enum class Wait { None, Read, Write, Compute, Auth };
+
+    /// Ожидание: в буфере не меньше need байт
+    struct ReadAwaiter {
+        Session &s;
+        size_t need;
+        size_t limit;
+        const char *error;
+        bool boundary;          ///< Ждём начала задания: закрытие здесь - обычное завершение
+
+        bool await_ready() const { return s.in.size() >= need; }
+        void await_suspend(std::coroutine_handle<> h);
+        void await_resume() const {}
+    };
+
+    /// Ожидание: объём неотправленных ответов опустился до порога
+    struct WriteAwaiter {
+        Session &s;
+
+        bool await_ready() const { return s.pendingOutput() <= OUT_HIGH_WATER; }
+        void await_suspend(std::coroutine_handle<> h) { s.resumeHandle = h; s.wait = Wait::Write; }
+        void await_resume() const {}
+    };
+
+    /// Ожидание: пул досчитал самый старый блок вектора
+    struct ComputeAwaiter {
+        Session &s;
+
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<> h) { s.resumeHandle = h; s.wait = Wait::Compute; }
+        void await_resume() const {}
+    };
+
+    /// Ожидание: есть место для задания длиной need байт (SIZE_MAX - все задания готовы)
+    struct JobAwaiter {
+        Session &s;
+        size_t need;
+
+        bool await_ready() const;
+        void await_suspend(std::coroutine_handle<> h);
+        void await_resume() const {}
+    };
+
+    /// Ожидание: пароль проверен в пачке транспорта
+    struct AuthAwaiter {
+        Session &s;
+        AuthRequest request;
+
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> h);
+        bool await_resume() const { return request.accepted; }
+    };
+
+    /// Порог неотправленных ответов, после которого корутина ждёт отправки
+    static const size_t OUT_HIGH_WATER = 64 * 1024;
+
+    Task run();
+
+    /**
+     * @brief Ждёт, пока в приёмном буфере окажется не меньше n байт
+     * @param error Сообщение журнала, если соединение оборвётся раньше
+     */
+    ReadAwaiter readExact(size_t n, const char *error) { return {*this, n, SIZE_MAX, error, false}; }
+
+    /**
+     * @brief Ждёт первую порцию данных (транспорт читает не более limit байт)
+     * @param error Сообщение журнала, если соединение оборвётся раньше
+     */
+    ReadAwaiter readSome(size_t limit, const char *error) { return {*this, 1, limit, error, false}; }
+
+    /**
+     * @brief Ждёт n байт начала следующего задания
+     *
+     * @details Если клиент закроет соединение, ничего не прислав, это
+     * конец сессии, а не ошибка; обрыв посреди заголовка - ошибка.
+     */
+    ReadAwaiter readNextJob(size_t n, const char *error) { return {*this, n, SIZE_MAX, error, true}; }
+
+    /**
+     * @brief Ставит ответ в очередь и при её переполнении ждёт отправки
+     */
+    WriteAwaiter writeAll(const void *data, size_t len);
+
+    /// Ждёт блоков параллельной редукции
+    ComputeAwaiter computeDone() { return {*this}; }
+
+    /// Ждёт места для задания с кадром длиной len байт
+    JobAwaiter jobSlot(size_t len) { return {*this, len}; }
+
+    /// Проверяет пароль; результат co_await - true, если вход разрешён
+    AuthAwaiter checkPassword(const AuthRequest &request) { return {*this, request}; }
+
+    /// Ждёт ответов на все задания с номерами
+    JobAwaiter jobsDone() { return {*this, SIZE_MAX}; }
+
+    bool jobsReady();
+    void collectJobs();
+    void finishJob(const Job &job);
+
+    size_t pendingOutput() const { return out.size() + sending.size() - sendPos; }
+    void resume();
+    void checkError();
+
+    int sock;
+    const ServerContext &ctx;
+    int wakeFd;
+    AuthBatch *auth;
+    AuthRequest *authRequest = nullptr;    ///< Запрос в пачке auth, пока она не проверена
+
+    RecvBuffer in;                  ///< Принятые, но ещё не разобранные данные
+    std::string out;                ///< Ответы, ещё не переданные транспорту
+    std::string sending;            ///< Ответы, которые транспорт отправляет сейчас
+    size_t sendPos = 0;
+
+    Wait wait = Wait::None;         ///< Чего ждёт приостановленная корутина
+    std::coroutine_handle<> resumeHandle;
+    size_t readNeed = 0;
+    size_t readLimit = SIZE_MAX;
+    const char *readError = nullptr;
+    bool readBoundary = false;      ///< Ожидание начала задания (ReadAwaiter::boundary)
+    bool failed = false;
+    bool gotInput = false;          ///< Данные приходили с прошлой отметки idleTick()
+    unsigned idleSeconds = 0;       ///< Отметок подряд без данных
+
+    std::unique_ptr<ChunkedSum> chunked;   ///< Блоки параллельной редукции, создаются для первого длинного вектора
+    std::vector<uint8_t> sparseBlock;      ///< Значения разреженного вектора, накопленные до целого блока
+    std::unique_ptr<JobQueue> jobs;        ///< Задания с номерами, создаются для первого из них
+    bool jobWait = false;                  ///< Ожидание Compute относится к заданиям, а не к блокам
+    size_t jobNeed = 0;                    ///< Чего ждёт JobAwaiter
+
+    Task task;                      ///< Объявлена последней: стартует, когда остальные поля готовы
+};
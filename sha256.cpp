@@ -6,13 +6,31 @@
  * 
  * @details Алгоритм хеширования SHA-256 согласно стандарту FIPS 180-4.
  * Используется для аутентификации пользователей.
+ *
+ * Функция сжатия есть в трёх вариантах: переносимом, на инструкциях
+ * SHA-NI (x86) и на расширениях ARMv8 Crypto (arm64). Аппаратные
+ * варианты компилируются с атрибутом target, как ядра в kernels.cpp,
+ * и выбираются во время работы по возможностям процессора.
  */
 
 #include "sha256.hpp"
 #include <cstdint>
-#include <cstdlib>
 #include <cstring>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VCALC_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#define VCALC_ARM64 1
+#endif
+
+using namespace std;
+
 /**
  * @brief Циклический сдвиг вправо
  */
@@ -83,6 +101,260 @@ static inline uint32_t ssig1(uint32_t x){
     return ROTR(x,17) ^ ROTR(x,19) ^ SHR(x,10);
 }
 
+/**
+ * @brief Обрабатывает один 512-битный блок (переносимый вариант)
+ * @param h Текущие хэш-значения
+ * @param chunk Блок 64 байта
+ */
+static void sha256Block(uint32_t h[8], const uint8_t *chunk) {
+    uint32_t w[64];
+    
+    // Подготовка расписания сообщений
+    for (int t = 0; t < 16; t++) {
+        w[t] = (chunk[t*4] << 24) | (chunk[t*4+1] << 16) | 
+               (chunk[t*4+2] << 8) | (chunk[t*4+3]);
+    }
+    
+    for (int t = 16; t < 64; t++) {
+        w[t] = ssig1(w[t-2]) + w[t-7] + ssig0(w[t-15]) + w[t-16];
+    }
+    
+    // Инициализация рабочих переменных
+    uint32_t a = h[0];
+    uint32_t b0 = h[1];
+    uint32_t c = h[2];
+    uint32_t d = h[3];
+    uint32_t e = h[4];
+    uint32_t f = h[5];
+    uint32_t g = h[6];
+    uint32_t hh = h[7];
+    
+    // Основной цикл сжатия
+    for (int t = 0; t < 64; t++) {
+        uint32_t T1 = hh + bsig1(e) + ch(e, f, g) + k[t] + w[t];
+        uint32_t T2 = bsig0(a) + maj(a, b0, c);
+        hh = g; 
+        g = f; 
+        f = e; 
+        e = d + T1; 
+        d = c; 
+        c = b0; 
+        b0 = a; 
+        a = T1 + T2;
+    }
+    
+    // Обновление хэш-значений
+    h[0] += a; 
+    h[1] += b0; 
+    h[2] += c; 
+    h[3] += d; 
+    h[4] += e; 
+    h[5] += f; 
+    h[6] += g; 
+    h[7] += hh;
+}
+
+static void sha256BlocksScalar(uint32_t h[8], const uint8_t *data, size_t count) {
+    for (size_t i = 0; i < count; i++) sha256Block(h, data + 64 * i);
+}
+
+#ifdef VCALC_X86
+
+/**
+ * @brief SHA-NI: четыре раунда на пару инструкций sha256rnds2
+ *
+ * @details Инструкции работают с состоянием в порядке ABEF / CDGH,
+ * поэтому h переставляется на входе и обратно на выходе, а между
+ * блоками состояние остаётся в регистрах. Расписание сообщений
+ * считается sha256msg1 / sha256msg2 по четыре слова.
+ */
+__attribute__((target("sha,sse4.1")))
+static void sha256BlocksShaNi(uint32_t h[8], const uint8_t *data, size_t count) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&h[0]), 0xB1);     // CDAB
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&h[4]), 0x1B);  // EFGH
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);                                  // ABEF
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);                                       // CDGH
+
+    for (size_t b = 0; b < count; b++, data += 64) {
+        __m128i abefSave = state0, cdghSave = state1;
+        __m128i w[4];
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(data + 16 * i)), byteSwap);
+            } else {
+                // W[t..t+3] из W[t-16..t-1]: sigma0 через msg1, W[t-7..t-4] сдвигом, sigma1 через msg2
+                __m128i x = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+                x = _mm_add_epi32(x, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+                w[i & 3] = _mm_sha256msg2_epu32(x, w[(i + 3) & 3]);
+            }
+            __m128i msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128((const __m128i*)&k[4 * i]));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+        }
+        state0 = _mm_add_epi32(state0, abefSave);
+        state1 = _mm_add_epi32(state1, cdghSave);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);                      // FEBA
+    state1 = _mm_shuffle_epi32(state1, 0xB1);                   // DCHG
+    _mm_storeu_si128((__m128i*)&h[0], _mm_blend_epi16(tmp, state1, 0xF0));  // DCBA
+    _mm_storeu_si128((__m128i*)&h[4], _mm_alignr_epi8(state1, tmp, 8));     // HGFE
+}
+
+static bool hasShaNi() {
+    return __builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1");
+}
+
+#endif
+
+#ifdef VCALC_ARM64
+
+/**
+ * @brief ARMv8 Crypto: четыре раунда на пару инструкций sha256h / sha256h2
+ *
+ * @details Состояние хранится в порядке ABCD / EFGH, как в h, и между
+ * блоками остаётся в регистрах.
+ */
+__attribute__((target("arch=armv8-a+crypto")))
+static void sha256BlocksArm(uint32_t h[8], const uint8_t *data, size_t count) {
+    uint32x4_t state0 = vld1q_u32(&h[0]);
+    uint32x4_t state1 = vld1q_u32(&h[4]);
+
+    for (size_t b = 0; b < count; b++, data += 64) {
+        uint32x4_t abcdSave = state0, efghSave = state1;
+        uint32x4_t w[4];
+#pragma GCC unroll 16
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+            } else {
+                w[i & 3] = vsha256su1q_u32(vsha256su0q_u32(w[i & 3], w[(i + 1) & 3]),
+                                           w[(i + 2) & 3], w[(i + 3) & 3]);
+            }
+            uint32x4_t msg = vaddq_u32(w[i & 3], vld1q_u32(&k[4 * i]));
+            uint32x4_t abcd = state0;
+            state0 = vsha256hq_u32(state0, state1, msg);
+            state1 = vsha256h2q_u32(state1, abcd, msg);
+        }
+        state0 = vaddq_u32(state0, abcdSave);
+        state1 = vaddq_u32(state1, efghSave);
+    }
+
+    vst1q_u32(&h[0], state0);
+    vst1q_u32(&h[4], state1);
+}
+
+static bool hasArmSha2() { return (getauxval(AT_HWCAP) & HWCAP_SHA2) != 0; }
+
+#endif
+
+static bool always() { return true; }
+
+const vector<Sha256Backend> &sha256Backends() {
+    static const vector<Sha256Backend> backends = {
+#ifdef VCALC_X86
+        {"sha-ni", sha256BlocksShaNi, hasShaNi},
+#endif
+#ifdef VCALC_ARM64
+        {"armv8-crypto", sha256BlocksArm, hasArmSha2},
+#endif
+        {"scalar", sha256BlocksScalar, always},
+    };
+    return backends;
+}
+
+/**
+ * @brief Выбирает первую поддерживаемую процессором реализацию
+ */
+static const Sha256Backend &selectedBackend() {
+    static const Sha256Backend &backend = []() -> const Sha256Backend & {
+#ifdef VCALC_X86
+        __builtin_cpu_init();
+#endif
+        for (const auto &b : sha256Backends())
+            if (b.supported()) return b;
+        return sha256Backends().back();
+    }();
+    return backend;
+}
+
+const char *sha256Impl() {
+    return selectedBackend().name;
+}
+
+void sha256Init(Sha256Context &ctx) {
+    sha256Init(ctx, selectedBackend());
+}
+
+void sha256Init(Sha256Context &ctx, const Sha256Backend &backend) {
+    // Начальные хэш-значения
+    static const uint32_t init[8] = {
+        0x6a09e667UL,0xbb67ae85UL,0x3c6ef372UL,0xa54ff53aUL,
+        0x510e527fUL,0x9b05688cUL,0x1f83d9abUL,0x5be0cd19UL
+    };
+    ctx.backend = &backend;
+    memcpy(ctx.h, init, sizeof(init));
+    ctx.length = 0;
+    ctx.used = 0;
+}
+
+void sha256Update(Sha256Context &ctx, const uint8_t *data, size_t len) {
+    ctx.length += len;
+    
+    // Дополняем начатый блок
+    if (ctx.used > 0) {
+        size_t take = len < 64 - ctx.used ? len : 64 - ctx.used;
+        memcpy(ctx.block + ctx.used, data, take);
+        ctx.used += take;
+        data += take;
+        len -= take;
+        if (ctx.used < 64) return;
+        ctx.backend->blocks(ctx.h, ctx.block, 1);
+        ctx.used = 0;
+    }
+    
+    // Целые блоки обрабатываются прямо из входных данных, без копирования,
+    // одним вызовом: аппаратные варианты держат состояние в регистрах
+    size_t full = len / 64;
+    if (full > 0) {
+        ctx.backend->blocks(ctx.h, data, full);
+        data += full * 64;
+        len -= full * 64;
+    }
+    
+    memcpy(ctx.block, data, len);
+    ctx.used = len;
+}
+
+void sha256Final(Sha256Context &ctx, uint8_t out[32]) {
+    // Добавление бита '1', нулей и длины сообщения в битах
+    // (64 бита, старший байт вперед); длина может уйти в следующий блок
+    uint64_t bit_len = ctx.length * 8;
+    ctx.block[ctx.used++] = 0x80;
+    if (ctx.used > 56) {
+        memset(ctx.block + ctx.used, 0, 64 - ctx.used);
+        ctx.backend->blocks(ctx.h, ctx.block, 1);
+        ctx.used = 0;
+    }
+    memset(ctx.block + ctx.used, 0, 56 - ctx.used);
+    for (int i = 7; i >= 0; i--) { 
+        ctx.block[56 + i] = bit_len & 0xFF; 
+        bit_len >>= 8; 
+    }
+    ctx.backend->blocks(ctx.h, ctx.block, 1);
+    
+    // Преобразование хэш-значений в байтовый массив (big-endian)
+    for (int i = 0; i < 8; i++) {
+        out[i*4] = (ctx.h[i] >> 24) & 0xFF;
+        out[i*4+1] = (ctx.h[i] >> 16) & 0xFF;
+        out[i*4+2] = (ctx.h[i] >> 8) & 0xFF;
+        out[i*4+3] = (ctx.h[i]) & 0xFF;
+    }
+}
+
 /**
  * @brief Вычисляет хэш SHA-256 для входных данных
  * 
@@ -90,95 +362,254 @@ static inline uint32_t ssig1(uint32_t x){
  * @param len Длина входных данных в байтах
  * @param out Выходной массив для хэша (32 байта)
  * 
- * @details Реализация алгоритма SHA-256:
- * 1. Инициализация хэш-значений
- * 2. Подготовка сообщения с дополнением
- * 3. Обработка блоков по 512 бит
- * 4. Генерация итогового хэша
- * 
- * @note Функция выделяет динамическую память для временного буфера
+ * @details Обёртка над sha256Init() / sha256Update() / sha256Final():
+ * память не выделяется, сообщение не копируется.
  */
 void sha256(const uint8_t *data, size_t len, uint8_t out[32]) {
-    // Инициализация начальных хэш-значений
-    uint32_t h[8] = {
+    Sha256Context ctx;
+    sha256Init(ctx);
+    sha256Update(ctx, data, len);
+    sha256Final(ctx, out);
+}
+
+/**
+ * @brief Блоки одного сообщения для многобуферного хэширования
+ *
+ * @details Целые блоки читаются прямо из сообщения, последний неполный
+ * блок с дополнением (один или два блока) собирается в tail.
+ */
+struct LaneMessage {
+    const uint8_t *data;
+    size_t full;            ///< Целых блоков в данных
+    size_t blocks;          ///< Всего блоков с дополнением
+    uint8_t tail[128];
+
+    void init(const uint8_t *d, size_t len) {
+        data = d;
+        full = len / 64;
+        size_t rem = len % 64;
+        size_t tailBlocks = rem + 9 > 64 ? 2 : 1;
+        blocks = full + tailBlocks;
+        memcpy(tail, d + full * 64, rem);
+        tail[rem] = 0x80;
+        memset(tail + rem + 1, 0, 64 * tailBlocks - rem - 1);
+        uint64_t bitLen = (uint64_t)len * 8;
+        for (int i = 1; i <= 8; i++, bitLen >>= 8) tail[64 * tailBlocks - i] = bitLen & 0xFF;
+    }
+
+    const uint8_t *block(size_t b) const { return b < full ? data + 64 * b : tail + 64 * (b - full); }
+};
+
+/// Циклический сдвиг всех дорожек (макрос: векторы шире 128 бит нельзя передавать вне target-функции)
+#define ROTR_LANES(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+/**
+ * @brief Многобуферное сжатие на векторах GCC из L слов по 32 бита
+ *
+ * @details Всегда встраивается, поэтому компилируется под набор
+ * инструкций вызывающей функции (атрибут target): один исходный текст
+ * даёт варианты SSE2/NEON, AVX2 и AVX-512. Дорожки сверх count
+ * дублируют сообщение 0, их результат не записывается.
+ */
+template <class V, size_t L>
+__attribute__((always_inline))
+static inline void sha256Lanes(const uint8_t *const data[], const size_t len[], size_t count, uint8_t (*out)[32]) {
+    static const uint32_t init[8] = {
         0x6a09e667UL,0xbb67ae85UL,0x3c6ef372UL,0xa54ff53aUL,
         0x510e527fUL,0x9b05688cUL,0x1f83d9abUL,0x5be0cd19UL
     };
-    
-    // Подготовка сообщения (дополнение до кратного 512 битам)
-    size_t num_blocks = ((len + 9) + 63) / 64;
-    uint8_t *msg = (uint8_t*)calloc(num_blocks*64, 1);
-    memcpy(msg, data, len);
-    
-    // Добавление бита '1'
-    msg[len] = 0x80;
-    
-    // Добавление длины сообщения в битах (64 бита, старший байт вперед)
-    uint64_t bit_len = (uint64_t)len * 8;
-    uint8_t *p = msg + num_blocks*64 - 8;
-    for (int i = 7; i >= 0; i--) { 
-        p[i] = bit_len & 0xFF; 
-        bit_len >>= 8; 
+    LaneMessage msgs[L];
+    size_t maxBlocks = 0;
+    for (size_t l = 0; l < L; l++) {
+        size_t src = l < count ? l : 0;
+        msgs[l].init(data[src], len[src]);
+        maxBlocks = msgs[l].blocks > maxBlocks ? msgs[l].blocks : maxBlocks;
     }
-    
-    // Обработка каждого 512-битного блока
-    for (size_t b = 0; b < num_blocks; b++) {
-        uint32_t w[64];
-        const uint8_t *chunk = msg + b*64;
-        
-        // Подготовка расписания сообщений
-        for (int t = 0; t < 16; t++) {
-            w[t] = (chunk[t*4] << 24) | (chunk[t*4+1] << 16) | 
-                   (chunk[t*4+2] << 8) | (chunk[t*4+3]);
-        }
-        
-        for (int t = 16; t < 64; t++) {
-            w[t] = ssig1(w[t-2]) + w[t-7] + ssig0(w[t-15]) + w[t-16];
+    V s[8];
+    for (int i = 0; i < 8; i++) s[i] = V{} + init[i];
+
+    for (size_t b = 0; b < maxBlocks; b++) {
+        // Слова блока раскладываются по дорожкам; закончившиеся
+        // сообщения маскируются и не меняют состояния
+        alignas(64) uint32_t words[16][L], mask[L];
+        for (size_t l = 0; l < L; l++) {
+            const uint8_t *p = msgs[l].block(b < msgs[l].blocks ? b : 0);
+            for (int t = 0; t < 16; t++)
+                words[t][l] = ((uint32_t)p[4*t] << 24) | ((uint32_t)p[4*t+1] << 16) | ((uint32_t)p[4*t+2] << 8) | p[4*t+3];
+            mask[l] = b < msgs[l].blocks ? ~0u : 0u;
         }
-        
-        // Инициализация рабочих переменных
-        uint32_t a = h[0];
-        uint32_t b0 = h[1];
-        uint32_t c = h[2];
-        uint32_t d = h[3];
-        uint32_t e = h[4];
-        uint32_t f = h[5];
-        uint32_t g = h[6];
-        uint32_t hh = h[7];
-        
-        // Основной цикл сжатия
+        V w[16], active;
+        memcpy(w, words, sizeof(w));
+        memcpy(&active, mask, sizeof(active));
+        V a = s[0], b0 = s[1], c = s[2], d = s[3], e = s[4], f = s[5], g = s[6], hh = s[7];
+#pragma GCC unroll 64
         for (int t = 0; t < 64; t++) {
-            uint32_t T1 = hh + bsig1(e) + ch(e, f, g) + k[t] + w[t];
-            uint32_t T2 = bsig0(a) + maj(a, b0, c);
-            hh = g; 
-            g = f; 
-            f = e; 
-            e = d + T1; 
-            d = c; 
-            c = b0; 
-            b0 = a; 
+            if (t >= 16) {
+                V w2 = w[(t - 2) & 15], w15 = w[(t - 15) & 15];
+                w[t & 15] += (ROTR_LANES(w2, 17) ^ ROTR_LANES(w2, 19) ^ (w2 >> 10)) + w[(t - 7) & 15] +
+                             (ROTR_LANES(w15, 7) ^ ROTR_LANES(w15, 18) ^ (w15 >> 3));
+            }
+            V T1 = hh + (ROTR_LANES(e, 6) ^ ROTR_LANES(e, 11) ^ ROTR_LANES(e, 25)) + ((e & f) ^ (~e & g)) +
+                   k[t] + w[t & 15];
+            V T2 = (ROTR_LANES(a, 2) ^ ROTR_LANES(a, 13) ^ ROTR_LANES(a, 22)) + ((a & b0) ^ (a & c) ^ (b0 & c));
+            hh = g;
+            g = f;
+            f = e;
+            e = d + T1;
+            d = c;
+            c = b0;
+            b0 = a;
             a = T1 + T2;
         }
-        
-        // Обновление хэш-значений
-        h[0] += a; 
-        h[1] += b0; 
-        h[2] += c; 
-        h[3] += d; 
-        h[4] += e; 
-        h[5] += f; 
-        h[6] += g; 
-        h[7] += hh;
+        s[0] += a & active;
+        s[1] += b0 & active;
+        s[2] += c & active;
+        s[3] += d & active;
+        s[4] += e & active;
+        s[5] += f & active;
+        s[6] += g & active;
+        s[7] += hh & active;
     }
-    
-    // Освобождение памяти
-    free(msg);
-    
-    // Преобразование хэш-значений в байтовый массив (big-endian)
-    for (int i = 0; i < 8; i++) {
-        out[i*4] = (h[i] >> 24) & 0xFF;
-        out[i*4+1] = (h[i] >> 16) & 0xFF;
-        out[i*4+2] = (h[i] >> 8) & 0xFF;
-        out[i*4+3] = (h[i]) & 0xFF;
+
+    for (size_t l = 0; l < count; l++) {
+        for (int i = 0; i < 8; i++) {
+            uint32_t v = s[i][l];
+            out[l][i*4] = v >> 24;
+            out[l][i*4+1] = (v >> 16) & 0xFF;
+            out[l][i*4+2] = (v >> 8) & 0xFF;
+            out[l][i*4+3] = v & 0xFF;
+        }
     }
 }
+
+typedef uint32_t u32x4 __attribute__((vector_size(16)));
+
+/// Четыре дорожки: SSE2 на x86-64 и NEON на arm64 есть всегда
+static void sha256Many4(const uint8_t *const data[], const size_t len[], size_t count, uint8_t (*out)[32]) {
+    sha256Lanes<u32x4, 4>(data, len, count, out);
+}
+
+#ifdef VCALC_X86
+
+typedef uint32_t u32x8 __attribute__((vector_size(32)));
+typedef uint32_t u32x16 __attribute__((vector_size(64)));
+
+__attribute__((target("avx2")))
+static void sha256ManyAvx2(const uint8_t *const data[], const size_t len[], size_t count, uint8_t (*out)[32]) {
+    sha256Lanes<u32x8, 8>(data, len, count, out);
+}
+
+__attribute__((target("avx512f")))
+static void sha256ManyAvx512(const uint8_t *const data[], const size_t len[], size_t count, uint8_t (*out)[32]) {
+    sha256Lanes<u32x16, 16>(data, len, count, out);
+}
+
+static bool hasAvx2() { return __builtin_cpu_supports("avx2"); }
+static bool hasAvx512() { return __builtin_cpu_supports("avx512f"); }
+
+#endif
+
+/// По одному сообщению выбранной реализацией сжатия
+static void sha256ManySerial(const uint8_t *const data[], const size_t len[], size_t count, uint8_t (*out)[32]) {
+    for (size_t i = 0; i < count; i++) sha256(data[i], len[i], out[i]);
+}
+
+/**
+ * @brief Сжатие выполняют инструкции SHA (SHA-NI, ARMv8 Crypto)
+ *
+ * @details Аппаратное сжатие одного сообщения быстрее восьми дорожек
+ * AVX2 и уступает только шестнадцати дорожкам AVX-512.
+ */
+static bool hasShaInstructions() {
+    return &selectedBackend() != &sha256Backends().back();
+}
+
+const vector<Sha256ManyBackend> &sha256ManyBackends() {
+    static const vector<Sha256ManyBackend> backends = {
+#ifdef VCALC_X86
+        {"avx512x16", 16, sha256ManyAvx512, hasAvx512},
+#endif
+        {"sha-serial", 1, sha256ManySerial, hasShaInstructions},
+#ifdef VCALC_X86
+        {"avx2x8", 8, sha256ManyAvx2, hasAvx2},
+#endif
+        {"simd128x4", 4, sha256Many4, always},
+        {"serial", 1, sha256ManySerial, always},
+    };
+    return backends;
+}
+
+/**
+ * @brief Выбирает первую поддерживаемую процессором многобуферную реализацию
+ */
+static const Sha256ManyBackend &selectedManyBackend() {
+    static const Sha256ManyBackend &backend = []() -> const Sha256ManyBackend & {
+#ifdef VCALC_X86
+        __builtin_cpu_init();
+#endif
+        for (const auto &b : sha256ManyBackends())
+            if (b.supported()) return b;
+        return sha256ManyBackends().back();
+    }();
+    return backend;
+}
+
+const char *sha256ManyImpl() {
+    return selectedManyBackend().name;
+}
+
+void sha256Many(const uint8_t *const data[], const size_t len[], size_t count, uint8_t (*out)[32]) {
+    const Sha256ManyBackend &backend = selectedManyBackend();
+    // Одиночное сообщение быстрее посчитать обычным путём
+    while (count > 1 && backend.lanes > 1) {
+        size_t n = count < backend.lanes ? count : backend.lanes;
+        backend.hash(data, len, n, out);
+        data += n;
+        len += n;
+        out += n;
+        count -= n;
+    }
+    for (size_t i = 0; i < count; i++) sha256(data[i], len[i], out[i]);
+}
+
+void hmacSha256Init(HmacSha256Key &key, const uint8_t *secret, size_t len) {
+    uint8_t block[64] = {};
+    if (len > 64) sha256(secret, len, block);
+    else memcpy(block, secret, len);
+
+    uint8_t pad[64];
+    Sha256Context ctx;
+    for (int i = 0; i < 64; i++) pad[i] = block[i] ^ 0x36;
+    sha256Init(ctx);
+    sha256Update(ctx, pad, 64);
+    memcpy(key.inner, ctx.h, sizeof(key.inner));
+    for (int i = 0; i < 64; i++) pad[i] = block[i] ^ 0x5c;
+    sha256Init(ctx);
+    sha256Update(ctx, pad, 64);
+    memcpy(key.outer, ctx.h, sizeof(key.outer));
+}
+
+void hmacSha256(const HmacSha256Key &key, const uint8_t *data, size_t len, uint8_t out[32]) {
+    // Оба вычисления продолжаются с сохранённых состояний после блока ключа
+    Sha256Context ctx;
+    sha256Init(ctx);
+    memcpy(ctx.h, key.inner, sizeof(key.inner));
+    ctx.length = 64;
+    sha256Update(ctx, data, len);
+    uint8_t innerHash[32];
+    sha256Final(ctx, innerHash);
+
+    sha256Init(ctx);
+    memcpy(ctx.h, key.outer, sizeof(key.outer));
+    ctx.length = 64;
+    sha256Update(ctx, innerHash, sizeof(innerHash));
+    sha256Final(ctx, out);
+}
+
+bool constantTimeEqual(const uint8_t *a, const uint8_t *b, size_t n) {
+    // volatile не даёт компилятору выйти из цикла при первом различии
+    const volatile uint8_t *x = a, *y = b;
+    uint8_t diff = 0;
+    for (size_t i = 0; i < n; i++) diff |= x[i] ^ y[i];
+    return diff == 0;
+}
@@ -6,6 +6,62 @@
 #pragma once
 #include <cstdint>
 #include <cstddef>
+#include <vector>
+
+/**
+ * @brief Реализация функции сжатия SHA-256 под конкретный набор инструкций
+ */
+struct Sha256Backend {
+    const char *name;                                               ///< Имя для журнала и тестов
+    void (*blocks)(uint32_t h[8], const uint8_t *data, size_t count);   ///< Сжимает count блоков по 64 байта
+    bool (*supported)();                                            ///< Поддерживает ли её текущий процессор
+};
+
+/**
+ * @brief Все реализации сжатия, от аппаратных к переносимой
+ *
+ * @details Используется тестами, чтобы сверить каждую реализацию
+ * с контрольными значениями.
+ */
+const std::vector<Sha256Backend> &sha256Backends();
+
+/**
+ * @brief Имя реализации, выбранной для текущего процессора
+ *
+ * @details Выбирается один раз при первом вызове: SHA-NI на x86,
+ * расширения ARMv8 Crypto на arm64, иначе переносимый код.
+ */
+const char *sha256Impl();
+
+/**
+ * @brief Состояние потокового вычисления SHA-256
+ *
+ * @details Данные подаются частями (sha256Update()) и копятся в блоке
+ * на стеке вызывающего, так что хэш из нескольких кусков - например,
+ * соль и пароль - не требует ни склейки, ни выделения памяти.
+ */
+struct Sha256Context {
+    const Sha256Backend *backend;   ///< Реализация сжатия
+    uint32_t h[8];          ///< Текущие хэш-значения
+    uint64_t length;        ///< Обработано байт
+    uint8_t block[64];      ///< Начатый блок
+    size_t used;            ///< Байт в начатом блоке
+};
+
+/// Начинает новое вычисление лучшей для процессора реализацией
+void sha256Init(Sha256Context &ctx);
+
+/// Начинает новое вычисление заданной реализацией (для тестов и замеров)
+void sha256Init(Sha256Context &ctx, const Sha256Backend &backend);
+
+/// Добавляет len байт данных
+void sha256Update(Sha256Context &ctx, const uint8_t *data, size_t len);
+
+/**
+ * @brief Завершает вычисление
+ * @param out Массив для записи результата (32 байта)
+ */
+void sha256Final(Sha256Context &ctx, uint8_t out[32]);
 
 /**
  * @brief Вычисляет хэш SHA-256 для данных
@@ -14,3 +70,73 @@
  * @param out Массив для записи результата (32 байта)
  */
 void sha256(const uint8_t *data, size_t len, uint8_t out[32]);
+
+/**
+ * @brief Хэширование нескольких независимых сообщений за один проход
+ *
+ * @details Сообщения раскладываются по дорожкам вектора: дорожка l
+ * каждого регистра держит слово сообщения l, и одна последовательность
+ * инструкций считает раунд сразу для всех дорожек. Выгодно для коротких
+ * сообщений (соль и пароль - один блок), которые по одному не загружают
+ * векторные блоки процессора. Сообщения разной длины обрабатываются
+ * вместе: закончившиеся дорожки перестают менять своё состояние.
+ */
+struct Sha256ManyBackend {
+    const char *name;       ///< Имя для журнала и тестов
+    size_t lanes;           ///< Сообщений за один проход
+    /// Хэширует count <= lanes сообщений
+    void (*hash)(const uint8_t *const data[], const size_t len[], size_t count, uint8_t (*out)[32]);
+    bool (*supported)();    ///< Поддерживает ли её текущий процессор
+};
+
+/// Все многобуферные реализации, от самой быстрой к последовательной
+const std::vector<Sha256ManyBackend> &sha256ManyBackends();
+
+/**
+ * @brief Имя многобуферной реализации, выбранной для текущего процессора
+ *
+ * @details Если сжатие выполняют инструкции SHA (sha256Impl() не
+ * "scalar"), а AVX-512 нет, сообщения хэшируются по одному
+ * ("sha-serial"): так быстрее, чем восемью дорожками AVX2.
+ */
+const char *sha256ManyImpl();
+
+/**
+ * @brief Вычисляет хэши count сообщений
+ * @param data Начала сообщений
+ * @param len Длины сообщений
+ * @param out Массив для записи count результатов
+ */
+void sha256Many(const uint8_t *const data[], const size_t len[], size_t count, uint8_t (*out)[32]);
+
+/**
+ * @brief Ключ HMAC-SHA256, подготовленный для многократного использования
+ *
+ * @details Хранит состояния SHA-256 после блока ключа, сложенного с ipad
+ * и с opad (RFC 2104). Код аутентификации короткого сообщения тогда
+ * стоит двух сжатий вместо четырёх.
+ */
+struct HmacSha256Key {
+    uint32_t inner[8];      ///< Состояние после блока ключ ^ ipad
+    uint32_t outer[8];      ///< Состояние после блока ключ ^ opad
+};
+
+/**
+ * @brief Готовит ключ HMAC-SHA256
+ * @param secret Ключ; длиннее 64 байт заменяется своим хэшем
+ */
+void hmacSha256Init(HmacSha256Key &key, const uint8_t *secret, size_t len);
+
+/**
+ * @brief Вычисляет HMAC-SHA256 сообщения
+ * @param out Массив для записи кода (32 байта)
+ */
+void hmacSha256(const HmacSha256Key &key, const uint8_t *data, size_t len, uint8_t out[32]);
+
+/**
+ * @brief Сравнивает n байт за время, не зависящее от места первого различия
+ *
+ * @details Для кодов и дайджестов, присланных клиентом: обычное memcmp
+ * по времени ответа выдавало бы длину совпавшего начала.
+ */
+bool constantTimeEqual(const uint8_t *a, const uint8_t *b, size_t n);
@@ -0,0 +1,158 @@
+/**
+ * @file shm.cpp
+ * @brief Реализация колец в разделяемой памяти
+ */
+
+#include "shm.hpp"
+#include <cstring>
+#include <new>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/// Записи выровнены на 8 байт: данные после заголовка годятся для double
+static uint64_t recordSpan(uint64_t len) {
+    return (SHM_RECORD_HEADER + len + 7) & ~(uint64_t)7;
+}
+
+static bool powerOfTwo(uint64_t v) {
+    return v >= 64 && (v & (v - 1)) == 0;
+}
+
+ShmRing::ShmRing(uint8_t *data, uint64_t size, atomic<uint64_t> *head, atomic<uint64_t> *tail)
+    : data(data), size(size), head(head), tail(tail),
+      writePos(tail->load()), reserved(writePos), readPos(head->load()) {
+}
+
+uint8_t *ShmRing::reserve(uint32_t len) {
+    uint64_t need = recordSpan(len);
+    if (need > size / 2) return nullptr;
+
+    uint64_t off = writePos & (size - 1);
+    uint64_t skip = off + need > size ? size - off : 0;
+    if (writePos - head->load(memory_order_acquire) + skip + need > size) return nullptr;
+
+    if (skip) {
+        // Запись не помещается до конца кольца: остаток занимает маркер,
+        // станет видимым вместе с записью в commit()
+        memcpy(data + off, &SHM_WRAP, 4);
+        writePos += skip;
+    }
+    reserved = writePos;
+    return data + (reserved & (size - 1)) + SHM_RECORD_HEADER;
+}
+
+void ShmRing::commit(uint32_t tag, uint32_t len) {
+    uint8_t *rec = data + (reserved & (size - 1));
+    memcpy(rec, &len, 4);
+    memcpy(rec + 4, &tag, 4);
+    writePos = reserved + recordSpan(len);
+    // Последовательная согласованность: парная проверке флага sleeping
+    // в shmWake() и подъёму флага перед сном на другой стороне
+    tail->store(writePos);
+}
+
+ShmRing::Status ShmRing::peek(uint32_t &tag, const uint8_t *&out, uint32_t &len) {
+    uint64_t avail = tail->load() - readPos;
+    while (avail > 0) {
+        // Позицию и длины пишет другая сторона: всё проверяется, а каждое
+        // поле читается из общей памяти один раз
+        if (avail > size || avail % 8) return Status::Corrupt;
+        uint64_t off = readPos & (size - 1);
+        uint32_t recLen;
+        memcpy(&recLen, data + off, 4);
+        if (recLen == SHM_WRAP) {
+            uint64_t skip = size - off;
+            if (skip > avail) return Status::Corrupt;
+            readPos += skip;
+            avail -= skip;
+            head->store(readPos, memory_order_release);
+            continue;
+        }
+        uint64_t span = recordSpan(recLen);
+        if (span > avail || off + span > size) return Status::Corrupt;
+        memcpy(&tag, data + off + 4, 4);
+        out = data + off + SHM_RECORD_HEADER;
+        len = recLen;
+        peeked = span;
+        return Status::Ready;
+    }
+    return Status::Empty;
+}
+
+void ShmRing::pop() {
+    readPos += peeked;
+    peeked = 0;
+    head->store(readPos, memory_order_release);
+}
+
+bool ShmRing::hasRoom(uint32_t len) const {
+    uint64_t need = recordSpan(len);
+    uint64_t off = writePos & (size - 1);
+    uint64_t skip = off + need > size ? size - off : 0;
+    return writePos - head->load() + skip + need <= size;
+}
+
+ShmChannel::~ShmChannel() {
+    if (base) munmap(base, length);
+    if (memFd >= 0) close(memFd);
+}
+
+bool ShmChannel::create(uint64_t requestSize, uint64_t responseSize) {
+    if (!powerOfTwo(requestSize) || !powerOfTwo(responseSize)) return false;
+    memFd = memfd_create("vcalc-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (memFd < 0) return false;
+    size_t total = SHM_CONTROL_SIZE + requestSize + responseSize;
+    if (ftruncate(memFd, total) < 0) return false;
+    // Клиент не должен укоротить область: обращение сервера к отрезанным
+    // страницам завершило бы его по SIGBUS
+    if (fcntl(memFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) < 0) return false;
+    return map(total, true, requestSize, responseSize);
+}
+
+bool ShmChannel::attach(int fd) {
+    memFd = fd;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < SHM_CONTROL_SIZE) return false;
+    if (!map(st.st_size, false, 0, 0)) return false;
+    if (ctl->magic != SHM_MAGIC || ctl->version != SHM_VERSION) return false;
+    if (!powerOfTwo(ctl->requestSize) || !powerOfTwo(ctl->responseSize)) return false;
+    if (SHM_CONTROL_SIZE + ctl->requestSize + ctl->responseSize != (uint64_t)st.st_size) return false;
+    request = ShmRing((uint8_t*)base + SHM_CONTROL_SIZE, ctl->requestSize,
+                      &ctl->requestHead, &ctl->requestTail);
+    response = ShmRing((uint8_t*)base + SHM_CONTROL_SIZE + ctl->requestSize, ctl->responseSize,
+                       &ctl->responseHead, &ctl->responseTail);
+    return true;
+}
+
+bool ShmChannel::map(size_t len, bool init, uint64_t requestSize, uint64_t responseSize) {
+    void *p = mmap(nullptr, len, PROT_READ | PROT_WRITE, MAP_SHARED, memFd, 0);
+    if (p == MAP_FAILED) return false;
+    base = p;
+    length = len;
+    if (!init) {
+        ctl = static_cast<ShmControl*>(base);
+        return true;
+    }
+    // Новая область memfd заполнена нулями; управляющий блок создаётся в ней
+    ctl = new (base) ShmControl();
+    ctl->magic = SHM_MAGIC;
+    ctl->version = SHM_VERSION;
+    ctl->requestSize = requestSize;
+    ctl->responseSize = responseSize;
+    request = ShmRing((uint8_t*)base + SHM_CONTROL_SIZE, requestSize, &ctl->requestHead, &ctl->requestTail);
+    response = ShmRing((uint8_t*)base + SHM_CONTROL_SIZE + requestSize, responseSize,
+                       &ctl->responseHead, &ctl->responseTail);
+    return true;
+}
+
+void shmWake(atomic<uint32_t> &sleeping, int eventFd) {
+    // Обычно другая сторона не спит, и публикация обходится без системного вызова
+    if (sleeping.load() && sleeping.exchange(0)) {
+        uint64_t one = 1;
+        write(eventFd, &one, sizeof(one));
+    }
+}
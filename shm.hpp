@@ -0,0 +1,184 @@
+/**
+ * @file shm.hpp
+ * @brief Кольца записей в разделяемой памяти для локальных клиентов
+ *
+ * @details Область memfd состоит из управляющего блока и двух колец:
+ * запросов (пишет клиент, читает сервер) и ответов (наоборот). Запись
+ * кольца - заголовок uint32 len | uint32 tag и len байт данных,
+ * выровненные на 8 байт, так что элементы вектора лежат в кольце
+ * выровненными и считаются прямо в нём. Запись не разрывается на конце
+ * кольца: остаток до конца занимает маркер переноса (len = SHM_WRAP).
+ *
+ * Позиции колец - счётчики байт, которые только растут; у каждого
+ * кольца одна пишущая и одна читающая сторона, поэтому синхронизация -
+ * только атомарные позиции. Системный вызов нужен лишь для пробуждения
+ * спящей стороны: перед сном она поднимает свой флаг sleeping и ещё раз
+ * проверяет кольцо, а другая сторона, опубликовав запись, пишет
+ * в eventfd, только если застала флаг поднятым.
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/// Сигнатура управляющего блока ("VCSH")
+const uint32_t SHM_MAGIC = 0x48534356;
+
+/// Версия формата колец
+const uint32_t SHM_VERSION = 1;
+
+/// Длина записи-маркера переноса в начало кольца
+const uint32_t SHM_WRAP = 0xFFFFFFFF;
+
+/// Длина заголовка записи
+const size_t SHM_RECORD_HEADER = 8;
+
+/**
+ * @brief Управляющий блок в начале разделяемой области
+ *
+ * @details Позиции и флаги разнесены по строкам кэша, чтобы запись
+ * одной стороны не вытесняла строку, которую читает другая.
+ */
+struct ShmControl {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t requestSize;                       ///< Размер кольца запросов (степень двойки)
+    uint64_t responseSize;                      ///< Размер кольца ответов (степень двойки)
+    alignas(64) std::atomic<uint64_t> requestHead;      ///< Сервер прочитал запросы до этой позиции
+    alignas(64) std::atomic<uint64_t> requestTail;      ///< Клиент записал запросы до этой позиции
+    alignas(64) std::atomic<uint64_t> responseHead;     ///< Клиент прочитал ответы до этой позиции
+    alignas(64) std::atomic<uint64_t> responseTail;     ///< Сервер записал ответы до этой позиции
+    alignas(64) std::atomic<uint32_t> serverSleeping;   ///< Сервер ждёт сигнала в своём eventfd
+    alignas(64) std::atomic<uint32_t> clientSleeping;   ///< Клиент ждёт сигнала в своём eventfd
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "позиции колец должны быть атомарны без блокировок");
+
+/// Смещение колец от начала области (управляющий блок занимает страницу)
+const size_t SHM_CONTROL_SIZE = 4096;
+
+static_assert(sizeof(ShmControl) <= SHM_CONTROL_SIZE, "управляющий блок не помещается в страницу");
+
+/**
+ * @brief Одно кольцо записей с точки зрения одной из сторон
+ *
+ * @details Пишущая сторона вызывает reserve() / commit(), читающая -
+ * peek() / pop(). Позиции другой стороны читаются из общей памяти,
+ * свои ведутся локально и публикуются. Читающая сторона не доверяет
+ * содержимому кольца: длины записей проверяются, а испорченное кольцо
+ * даёт Status::Corrupt.
+ */
+class ShmRing {
+public:
+    ShmRing() = default;
+
+    /**
+     * @param data Начало кольца
+     * @param size Размер кольца (степень двойки)
+     * @param head Позиция читающей стороны
+     * @param tail Позиция пишущей стороны
+     */
+    ShmRing(uint8_t *data, uint64_t size, std::atomic<uint64_t> *head, std::atomic<uint64_t> *tail);
+
+    /// Наибольшая длина данных одной записи
+    uint64_t maxRecord() const { return size / 2 - SHM_RECORD_HEADER; }
+
+    /**
+     * @brief Резервирует место под запись с len байтами данных
+     * @return Начало данных записи или nullptr, если места пока нет
+     */
+    uint8_t *reserve(uint32_t len);
+
+    /**
+     * @brief Публикует зарезервированную запись
+     * @param tag Метка записи (номер запроса)
+     * @param len Длина данных, не больше зарезервированной
+     */
+    void commit(uint32_t tag, uint32_t len);
+
+    /// Результат чтения кольца
+    enum class Status { Empty, Ready, Corrupt };
+
+    /**
+     * @brief Очередная запись без её удаления из кольца
+     * @param tag [out] Метка записи
+     * @param data [out] Начало данных (выровнено на 8 байт)
+     * @param len [out] Длина данных
+     */
+    Status peek(uint32_t &tag, const uint8_t *&data, uint32_t &len);
+
+    /// Освобождает запись, полученную последним peek()
+    void pop();
+
+    /// В кольце есть неразобранные записи
+    bool readable() const { return tail->load() != readPos; }
+
+    /// Поместится ли сейчас запись с len байтами данных
+    bool hasRoom(uint32_t len) const;
+
+private:
+    uint8_t *data = nullptr;
+    uint64_t size = 0;
+    std::atomic<uint64_t> *head = nullptr;
+    std::atomic<uint64_t> *tail = nullptr;
+    uint64_t writePos = 0;      ///< Локальная позиция записи (пишущая сторона)
+    uint64_t reserved = 0;      ///< Зарезервированная запись начинается здесь
+    uint64_t readPos = 0;       ///< Локальная позиция чтения (читающая сторона)
+    uint64_t peeked = 0;        ///< Размер записи, полученной peek()
+};
+
+/**
+ * @brief Разделяемая область: управляющий блок и оба кольца
+ */
+class ShmChannel {
+public:
+    ShmChannel() = default;
+    ~ShmChannel();
+
+    ShmChannel(const ShmChannel &) = delete;
+    ShmChannel &operator=(const ShmChannel &) = delete;
+
+    /**
+     * @brief Создаёт область в memfd (сервер)
+     * @param requestSize Размер кольца запросов (степень двойки)
+     * @param responseSize Размер кольца ответов (степень двойки)
+     * @return false при ошибке memfd_create / ftruncate / mmap
+     */
+    bool create(uint64_t requestSize, uint64_t responseSize);
+
+    /**
+     * @brief Подключается к области, созданной сервером (клиент)
+     * @param fd memfd, полученный от сервера; канал становится его владельцем
+     * @return false если область не отображается или неверен её формат
+     */
+    bool attach(int fd);
+
+    /// Дескриптор memfd
+    int fd() const { return memFd; }
+
+    ShmControl *control() const { return ctl; }
+
+    /// Кольцо запросов
+    ShmRing &requests() { return request; }
+
+    /// Кольцо ответов
+    ShmRing &responses() { return response; }
+
+private:
+    bool map(size_t length, bool init, uint64_t requestSize, uint64_t responseSize);
+
+    int memFd = -1;
+    void *base = nullptr;
+    size_t length = 0;
+    ShmControl *ctl = nullptr;
+    ShmRing request;
+    ShmRing response;
+};
+
+/**
+ * @brief Будит спящую сторону после публикации записи
+ * @param sleeping Флаг сна другой стороны
+ * @param eventFd Её eventfd
+ */
+void shmWake(std::atomic<uint32_t> &sleeping, int eventFd);
@@ -5,33 +5,18 @@
 
 #include <UnitTest++/UnitTest++.h>
 #include <vector>
+#include <atomic>
+#include <thread>
 #include <string>
 #include <cstring>
+#include <cstdio>
+#include <unistd.h>
 #include "../sha256.hpp"
-
-bool checkAuth(const std::string& login, const std::string& salt, 
-               const std::string& hash, 
-               const std::vector<std::pair<std::string,std::string>>& users) {
-    for (const auto& [l, p] : users) {
-        if (l == login) {
-            std::string data = salt + p;
-            uint8_t digest[32];
-            sha256((uint8_t*)data.c_str(), data.size(), digest);
-            
-            char hex[65];
-            for (int i = 0; i < 32; i++) {
-                sprintf(hex + i*2, "%02X", digest[i]);
-            }
-            hex[64] = '\0';
-            
-            return std::string(hex) == hash;
-        }
-    }
-    return false;
-}
+#include "../users.hpp"
+#include "../tickets.hpp"
 
 SUITE(AuthTests) {
-    std::vector<std::pair<std::string,std::string>> users = {
+    UserStore users = {
         {"user", "P@ssW0rd"},
         {"admin", "Admin123"},
         {"test", "Test456"}
@@ -69,7 +54,7 @@ SUITE(AuthTests) {
     
     // Тест 4: Пустая база пользователей
     TEST(EmptyUserDatabase) {
-        std::vector<std::pair<std::string,std::string>> empty_users;
+        UserStore empty_users;
         std::string dummy_hash = "0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF0123456789ABCDEF";
         CHECK(!checkAuth("user", "A1B2C3D4E5F67890", dummy_hash, empty_users));
     }
@@ -82,6 +67,9 @@ SUITE(AuthTests) {
             {"charlie", "password3"}
         };
         
+        UserStore store;
+        for (const auto& [l, p] : multi_users) store.add(l, p);
+        
         bool all_correct = true;
         for (const auto& [l, p] : multi_users) {
             std::string s = "SALT1234567890AB";
@@ -92,7 +80,7 @@ SUITE(AuthTests) {
             for (int i = 0; i < 32; i++) {
                 sprintf(h + i*2, "%02X", dig[i]);
             }
-            if (!checkAuth(l, s, h, multi_users)) {
+            if (!checkAuth(l, s, h, store)) {
                 all_correct = false;
                 break;
             }
@@ -165,6 +153,269 @@ SUITE(AuthTests) {
         
         CHECK(memcmp(dig1, dig2, 32) != 0);
     }
+    
+    // Тест 11: Поиск в большой базе и отсутствующие логины
+    TEST(LargeUserStore) {
+        UserStore store;
+        char login[16], pass[16];
+        for (int i = 0; i < 100000; i++) {
+            snprintf(login, sizeof(login), "user%d", i);
+            snprintf(pass, sizeof(pass), "pass%d", i);
+            CHECK(store.add(login, pass));
+        }
+        CHECK_EQUAL(100000u, store.size());
+        
+        std::string_view p;
+        bool all_found = true;
+        for (int i = 0; i < 100000; i += 7) {
+            snprintf(login, sizeof(login), "user%d", i);
+            snprintf(pass, sizeof(pass), "pass%d", i);
+            if (!store.find(login, p) || p != pass) all_found = false;
+        }
+        CHECK(all_found);
+        CHECK(!store.find("user100000", p));
+        CHECK(!store.find("", p));
+        CHECK(!store.find("user", p));
+    }
+    
+    // Тест 12: Повторный логин не заменяет первую запись
+    TEST(DuplicateLoginKeepsFirst) {
+        UserStore store = {{"user", "first"}, {"user", "second"}, {"", "empty"}};
+        CHECK_EQUAL(2u, store.size());
+        std::string_view p;
+        CHECK(store.find("user", p));
+        CHECK(p == "first");
+        CHECK(store.find("", p));
+        CHECK(p == "empty");
+    }
+    
+    // Тест 13: Двоичный образ базы отображается и находит тех же пользователей
+    TEST(UserImageRoundTrip) {
+        const char *path = "test_users.db";
+        UserStore store;
+        char login[16], pass[16];
+        for (int i = 0; i < 1000; i++) {
+            snprintf(login, sizeof(login), "user%d", i);
+            snprintf(pass, sizeof(pass), "pass%d", i);
+            store.add(login, pass);
+        }
+        CHECK(store.save(path));
+        
+        UserStore image = loadUsers(path);
+        CHECK(image.mapped());
+        CHECK_EQUAL(1000u, image.size());
+        CHECK(!image.add("new", "user"));
+        std::string_view p;
+        CHECK(image.find("user999", p));
+        CHECK(p == "pass999");
+        CHECK(!image.find("user1000", p));
+        
+        // Перемещённая база продолжает искать в том же отображении
+        UserStore moved = std::move(image);
+        CHECK(moved.find("user0", p));
+        CHECK(p == "pass0");
+        CHECK(image.empty());
+        remove(path);
+    }
+    
+    // Тест 14: Усечённый или чужой файл не принимается за образ
+    TEST(UserImageRejectsDamaged) {
+        const char *path = "test_users.db";
+        UserStore store = {{"user", "P@ssW0rd"}};
+        CHECK(store.save(path));
+        
+        FILE *f = fopen(path, "r+b");
+        fseek(f, 0, SEEK_END);
+        long size = ftell(f);
+        fclose(f);
+        CHECK(truncate(path, size - 1) == 0);
+        UserStore cut;
+        CHECK(!cut.open(path));
+        
+        f = fopen(path, "wb");
+        fputs("user:P@ssW0rd\n", f);
+        fclose(f);
+        UserStore text;
+        CHECK(!text.open(path));
+        // Текстовый файл читается как прежде
+        text = loadUsers(path);
+        CHECK(!text.mapped());
+        CHECK_EQUAL(1u, text.size());
+        remove(path);
+    }
+    
+    // Тест 15: Читатели видят целую базу, пока она заменяется
+    TEST(RegistryPublishWhileReading) {
+        UserRegistry registry;
+        registry.publish(UserStore{{"user", "v0"}});
+        
+        std::atomic<bool> stop{false};
+        std::atomic<int> torn{0};
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 2; t++) {
+            readers.emplace_back([&]() {
+                while (!stop) {
+                    auto users = registry.read();
+                    std::string_view p, q;
+                    // В каждом поколении пароли user и user2 совпадают
+                    if (!users->find("user", p)) torn++;
+                    else if (users->find("user2", q) && p != q) torn++;
+                }
+            });
+        }
+        for (int v = 1; v <= 200; v++) {
+            std::string pass = "v" + std::to_string(v);
+            registry.publish(UserStore{{"user", pass}, {"user2", pass}});
+        }
+        stop = true;
+        for (auto &t : readers) t.join();
+        CHECK_EQUAL(0, torn.load());
+        
+        std::string_view p;
+        CHECK(registry.read()->find("user2", p));
+        CHECK(p == "v200");
+    }
+    
+    // Тест 16: Пачка проверок даёт те же ответы, что и checkAuth по одной
+    TEST(CheckAuthBatchMatchesSingle) {
+        UserStore many;
+        for (int i = 0; i < 50; i++) many.add("user" + std::to_string(i), "Pass" + std::string(i * 3, 'x'));
+        
+        // Больше AUTH_BATCH_MAX запросов: верные, неверные, неизвестные и испорченные
+        std::vector<std::string> logins, salts, hashes;
+        for (int i = 0; i < 40; i++) {
+            std::string login = "user" + std::to_string(i % 3 == 2 ? i + 100 : i);
+            std::string salt = "SALT" + std::to_string(i) + "0123456789AB";
+            std::string data = salt + "Pass" + std::string(i * 3, 'x');
+            uint8_t digest[32];
+            sha256((const uint8_t*)data.data(), data.size(), digest);
+            char hex[65];
+            for (int k = 0; k < 32; k++) {
+                sprintf(hex + k*2, "%02X", digest[k]);
+            }
+            std::string hash = hex;
+            if (i % 5 == 1) hash[7] = hash[7] == 'A' ? 'B' : 'A';
+            if (i % 7 == 3) hash.pop_back();
+            logins.push_back(login);
+            salts.push_back(salt);
+            hashes.push_back(hash);
+        }
+        std::vector<AuthRequest> requests(logins.size());
+        std::vector<AuthRequest*> pointers;
+        for (size_t i = 0; i < requests.size(); i++) {
+            requests[i] = {logins[i], salts[i], hashes[i]};
+            pointers.push_back(&requests[i]);
+        }
+        checkAuthBatch(pointers.data(), pointers.size(), many);
+        
+        int accepted = 0;
+        for (size_t i = 0; i < requests.size(); i++) {
+            CHECK_EQUAL(checkAuth(logins[i], salts[i], hashes[i], many), requests[i].accepted);
+            accepted += requests[i].accepted;
+        }
+        CHECK(accepted > 10);
+        
+        // Пачка из одного запроса и соль с паролем длиннее AUTH_MESSAGE_MAX
+        // (пароли до 121 символа) хэшируются отдельно, с тем же ответом
+        for (size_t i = 0; i < requests.size(); i++) {
+            AuthRequest single = {logins[i], salts[i], hashes[i]};
+            AuthRequest *r = &single;
+            checkAuthBatch(&r, 1, many);
+            CHECK_EQUAL(requests[i].accepted, single.accepted);
+        }
+    }
+    
+    // Тест 17: Двоичное рукопожатие: длина кадра, разбор и сравнение дайджеста
+    TEST(BinaryHandshake) {
+        const uint8_t salt[AUTH_SALT_SIZE] = {0x00, 0x3A, 0xFF, 0x10, 0x20, 0x30, 0x40, 0x50};
+        std::string data = std::string((const char*)salt, sizeof(salt)) + "Admin123";
+        uint8_t digest[AUTH_DIGEST_SIZE];
+        sha256((const uint8_t*)data.data(), data.size(), digest);
+        
+        std::vector<uint8_t> frame = {AUTH_BINARY, AUTH_VERSION, 5, 'a', 'd', 'm', 'i', 'n'};
+        frame.insert(frame.end(), salt, salt + sizeof(salt));
+        frame.insert(frame.end(), digest, digest + sizeof(digest));
+        CHECK_EQUAL(frame.size(), authFrameSize(frame.data()));
+        
+        AuthRequest request = parseAuthFrame(frame.data());
+        CHECK(request.binary);
+        CHECK(request.login == "admin");
+        CHECK_EQUAL(AUTH_SALT_SIZE, request.salt.size());
+        AuthRequest *r = &request;
+        checkAuthBatch(&r, 1, users);
+        CHECK(request.accepted);
+        
+        // Любой испорченный байт дайджеста или чужой логин отклоняются
+        frame.back() ^= 1;
+        request = parseAuthFrame(frame.data());
+        checkAuthBatch(&r, 1, users);
+        CHECK(!request.accepted);
+        frame.back() ^= 1;
+        frame[3] = 'b';
+        request = parseAuthFrame(frame.data());
+        checkAuthBatch(&r, 1, users);
+        CHECK(!request.accepted);
+        
+        // Другая версия или пустой логин не принимаются
+        const uint8_t v4[AUTH_BINARY_PREFIX] = {AUTH_BINARY, 4, 5};
+        const uint8_t empty[AUTH_BINARY_PREFIX] = {AUTH_BINARY, AUTH_VERSION, 0};
+        const uint8_t text[AUTH_BINARY_PREFIX] = {'u', 's', 'e'};
+        CHECK_EQUAL(0u, authFrameSize(v4));
+        CHECK_EQUAL(0u, authFrameSize(empty));
+        CHECK_EQUAL(0u, authFrameSize(text));
+    }
+    
+    // Тест 18: Билет возобновления: подделка, срок действия и смена ключей
+    TEST(ResumptionTickets) {
+        uint8_t ticket[TICKET_MAX];
+        std::string_view login;
+        
+        // Билеты выключены: не выдаются и не принимаются
+        TicketKeys off;
+        CHECK_EQUAL(0u, off.issue("admin", 1000, ticket));
+        
+        TicketKeys keys(10);
+        size_t len = keys.issue("admin", 1000, ticket);
+        CHECK_EQUAL(TICKET_HEADER + 5 + TICKET_MAC_SIZE, len);
+        CHECK(keys.verify(ticket, len, 1005, login));
+        CHECK(login == "admin");
+        CHECK(!off.verify(ticket, len, 1005, login));
+        
+        // Любой изменённый байт, включая логин и срок, отклоняется
+        bool all_rejected = true;
+        for (size_t i = 0; i < len; i++) {
+            ticket[i] ^= 1;
+            if (keys.verify(ticket, len, 1005, login)) all_rejected = false;
+            ticket[i] ^= 1;
+        }
+        CHECK(all_rejected);
+        CHECK(!keys.verify(ticket, len - 1, 1005, login));
+        
+        // Другой экземпляр сервера со своими ключами билет не примет
+        TicketKeys other(10);
+        CHECK(!other.verify(ticket, len, 1005, login));
+        
+        // Истёкший билет; в 1010 ключ сменился, но билет предыдущего
+        // ключа действует до своего срока
+        uint8_t late[TICKET_MAX];
+        size_t lateLen = keys.issue("user", 1009, late);
+        CHECK(!keys.verify(ticket, len, 1010, login));
+        CHECK(keys.verify(late, lateLen, 1012, login));
+        CHECK(login == "user");
+        len = keys.issue("admin", 1012, ticket);
+        CHECK(keys.verify(ticket, len, 1015, login));
+        CHECK(memcmp(late, ticket, 4) != 0);
+        
+        // После второй смены ключа прежний ключ забыт
+        CHECK(!keys.verify(late, lateLen, 1022, login));
+        CHECK(!keys.verify(ticket, len, 1022, login));
+        
+        // Длина кадра возобновления
+        const uint8_t resume[AUTH_BINARY_PREFIX] = {AUTH_BINARY, AUTH_TICKET, 46};
+        const uint8_t none[AUTH_BINARY_PREFIX] = {AUTH_BINARY, AUTH_TICKET, 0};
+        CHECK_EQUAL(AUTH_BINARY_PREFIX + 46, authFrameSize(resume));
+        CHECK_EQUAL(0u, authFrameSize(none));
+    }
 }
 
 int main() {
@@ -156,6 +156,98 @@ SUITE(CLITests) {
         cleanup_argv(argv);
         CHECK_EQUAL(0, result);
     }
+    
+    // Тест 11: Неверное число рабочих потоков
+    TEST_FIXTURE(Setup, TestInvalidWorkersZero) {
+        vector<string> args = {"-d", "test_users.txt", "--workers", "0"};
+        vector<char*> argv = create_argv(args);
+        int result = main_server(args.size() + 1, argv.data());
+        cleanup_argv(argv);
+        CHECK(result != 0);
+    }
+    
+    // Тест 12: Корректное число рабочих потоков и закрепление за ядрами
+    TEST_FIXTURE(Setup, TestValidWorkers) {
+        vector<string> args = {"-d", "test_users.txt", "-w", "4", "--pin-cpus"};
+        vector<char*> argv = create_argv(args);
+        int result = main_server(args.size() + 1, argv.data());
+        cleanup_argv(argv);
+        CHECK_EQUAL(0, result);
+    }
+    
+    // Тест 13: Неизвестный транспорт ввода-вывода
+    TEST_FIXTURE(Setup, TestInvalidIoBackend) {
+        vector<string> args = {"-d", "test_users.txt", "--io-backend", "kqueue"};
+        vector<char*> argv = create_argv(args);
+        int result = main_server(args.size() + 1, argv.data());
+        cleanup_argv(argv);
+        CHECK(result != 0);
+    }
+    
+    // Тест 14: Параллельная редукция с заданным числом потоков пула
+    TEST_FIXTURE(Setup, TestParallelReduction) {
+        vector<string> args = {"-d", "test_users.txt", "--parallel-threshold", "1048576", "--reduce-threads", "4"};
+        vector<char*> argv = create_argv(args);
+        int result = main_server(args.size() + 1, argv.data());
+        cleanup_argv(argv);
+        CHECK_EQUAL(0, result);
+    }
+    
+    // Тест 15: Отрицательное число потоков редукции
+    TEST_FIXTURE(Setup, TestInvalidReduceThreads) {
+        vector<string> args = {"-d", "test_users.txt", "--reduce-threads", "-1"};
+        vector<char*> argv = create_argv(args);
+        int result = main_server(args.size() + 1, argv.data());
+        cleanup_argv(argv);
+        CHECK(result != 0);
+    }
+    
+    // Тест 16: Конвейер из одного блока не может совмещать приём и вычисления
+    TEST_FIXTURE(Setup, TestInvalidStreamBuffers) {
+        vector<string> args = {"-d", "test_users.txt", "--parallel-threshold", "1", "--stream-buffers", "1"};
+        vector<char*> argv = create_argv(args);
+        int result = main_server(args.size() + 1, argv.data());
+        cleanup_argv(argv);
+        CHECK(result != 0);
+    }
+    
+    // Тест 17: Неверный таймаут простоя
+    TEST_FIXTURE(Setup, TestInvalidIdleTimeout) {
+        vector<string> args = {"-d", "test_users.txt", "--idle-timeout", "100000"};
+        vector<char*> argv = create_argv(args);
+        int result = main_server(args.size() + 1, argv.data());
+        cleanup_argv(argv);
+        CHECK(result != 0);
+    }
+    
+    // Тест 18: Путь Unix-сокета не помещается в sockaddr_un
+    TEST_FIXTURE(Setup, TestLongUnixSocketPath) {
+        vector<string> args = {"-d", "test_users.txt", "--unix-socket", "/tmp/" + string(200, 'x')};
+        vector<char*> argv = create_argv(args);
+        int result = main_server(args.size() + 1, argv.data());
+        cleanup_argv(argv);
+        CHECK(result != 0);
+    }
+    
+    // Тест 19: Неизвестный уровень журнала или поведение при переполнении
+    TEST_FIXTURE(Setup, TestInvalidLogLevel) {
+        for (const vector<string> &args : {vector<string>{"-d", "test_users.txt", "--log-level", "trace"},
+                                           vector<string>{"-d", "test_users.txt", "--log-overflow", "wait"}}) {
+            vector<char*> argv = create_argv(args);
+            int result = main_server(args.size() + 1, argv.data());
+            cleanup_argv(argv);
+            CHECK(result != 0);
+        }
+    }
+    
+    // Тест 20: Журнал без строк о каждом векторе, с ожиданием при переполнении
+    TEST_FIXTURE(Setup, TestLogLevelInfo) {
+        vector<string> args = {"-d", "test_users.txt", "--log-level", "info", "--log-overflow", "block"};
+        vector<char*> argv = create_argv(args);
+        int result = main_server(args.size() + 1, argv.data());
+        cleanup_argv(argv);
+        CHECK_EQUAL(0, result);
+    }
 }
 
 int main() {
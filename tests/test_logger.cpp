@@ -0,0 +1,150 @@
+/**
+ * @file test_logger.cpp
+ * @brief Тесты асинхронного журнала с использованием UnitTest++
+ */
+
+#include <UnitTest++/UnitTest++.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../logger.hpp"
+
+/// Строки файла журнала
+static std::vector<std::string> readLines(const std::string &file) {
+    std::vector<std::string> lines;
+    std::ifstream f(file);
+    for (std::string line; std::getline(f, line); ) lines.push_back(line);
+    return lines;
+}
+
+/// Текст строки журнала после отметки времени
+static std::string message(const std::string &line) {
+    size_t pos = line.find(" | ");
+    return pos == std::string::npos ? "" : line.substr(pos + 3);
+}
+
+SUITE(LoggerTests) {
+
+    struct Setup {
+        Setup() { remove("test_logger.log"); }
+        ~Setup() { remove("test_logger.log"); }
+    };
+
+    // Тест 1: Сообщения записываются по порядку с отметкой времени
+    TEST_FIXTURE(Setup, WritesLinesInOrder) {
+        {
+            Logger logger("test_logger.log");
+            CHECK(logger.opened());
+            logMsg("первое");
+            logMsg(LogLevel::Error, "второе");
+            logger.flush();
+            std::vector<std::string> lines = readLines("test_logger.log");
+            CHECK_EQUAL(2u, lines.size());
+            if (lines.size() == 2) {
+                CHECK_EQUAL("первое", message(lines[0]));
+                CHECK_EQUAL("второе", message(lines[1]));
+                // ГГГГ-ММ-ДД чч:мм:сс | ...
+                CHECK_EQUAL(19u, lines[0].find(" | "));
+            }
+            logMsg("третье");
+        }
+        // Деструктор дописывает всё отправленное
+        CHECK_EQUAL(3u, readLines("test_logger.log").size());
+
+        // Без журнала сообщения никуда не пишутся
+        logMsg("после закрытия");
+        CHECK(!logEnabled(LogLevel::Error));
+        CHECK_EQUAL(3u, readLines("test_logger.log").size());
+    }
+
+    // Тест 2: Уровень info выключает строки уровня debug
+    TEST_FIXTURE(Setup, LevelFiltersDebug) {
+        Logger logger("test_logger.log", LogLevel::Info);
+        CHECK(logEnabled(LogLevel::Info));
+        CHECK(!logEnabled(LogLevel::Debug));
+        logMsg(LogLevel::Debug, "Вектор 1: ...");
+        logMsg("Клиент подключен");
+        logger.flush();
+        std::vector<std::string> lines = readLines("test_logger.log");
+        CHECK_EQUAL(1u, lines.size());
+        if (!lines.empty()) CHECK_EQUAL("Клиент подключен", message(lines[0]));
+
+        LogLevel level;
+        CHECK(parseLogLevel("debug", level) && level == LogLevel::Debug);
+        CHECK(!parseLogLevel("trace", level));
+    }
+
+    // Тест 3: Длинное сообщение занимает несколько записей, слишком длинное обрезается
+    TEST_FIXTURE(Setup, LongMessages) {
+        std::string medium(1000, 'a'), huge(LOG_RECORD_SIZE * LOG_MESSAGE_RECORDS * 2, 'b');
+        medium.back() = 'z';
+        {
+            Logger logger("test_logger.log");
+            logMsg(medium);
+            logMsg(huge);
+            logMsg("");
+        }
+        std::vector<std::string> lines = readLines("test_logger.log");
+        CHECK_EQUAL(3u, lines.size());
+        if (lines.size() == 3) {
+            CHECK(message(lines[0]) == medium);
+            CHECK(message(lines[1]).size() < huge.size());
+            CHECK(message(lines[1]).size() > huge.size() / 4);
+            CHECK(message(lines[2]).empty());
+        }
+    }
+
+    // Тест 4: При ожидании места ни одно сообщение нескольких потоков не теряется
+    TEST_FIXTURE(Setup, BlockKeepsEverything) {
+        const int threads = 4, perThread = 5 * LOG_RING_RECORDS;
+        {
+            Logger logger("test_logger.log", LogLevel::Debug, LogOverflow::Block);
+            std::vector<std::thread> writers;
+            for (int t = 0; t < threads; t++) {
+                writers.emplace_back([t]() {
+                    for (int i = 0; i < perThread; i++) logMsg(std::to_string(t) + ":" + std::to_string(i));
+                });
+            }
+            for (auto &w : writers) w.join();
+        }
+        std::vector<std::string> lines = readLines("test_logger.log");
+        CHECK_EQUAL((size_t)threads * perThread, lines.size());
+
+        // Сообщения каждого потока идут по порядку
+        std::vector<int> next(threads, 0);
+        bool ordered = true;
+        for (const auto &line : lines) {
+            std::string text = message(line);
+            int t = std::stoi(text);
+            int i = std::stoi(text.substr(text.find(':') + 1));
+            if (i != next[t]++) ordered = false;
+        }
+        CHECK(ordered);
+    }
+
+    // Тест 5: Отброшенные сообщения подсчитываются в журнале
+    TEST_FIXTURE(Setup, DropIsReported) {
+        const int total = 20 * LOG_RING_RECORDS;
+        {
+            Logger logger("test_logger.log", LogLevel::Debug, LogOverflow::Drop);
+            std::thread writer([]() {
+                for (int i = 0; i < total; i++) logMsg("сообщение " + std::to_string(i));
+            });
+            writer.join();
+        }
+        size_t written = 0, dropped = 0;
+        for (const auto &line : readLines("test_logger.log")) {
+            std::string text = message(line);
+            const std::string report = "Журнал переполнен: пропущено сообщений: ";
+            if (text.compare(0, report.size(), report) == 0) dropped += std::stoul(text.substr(report.size()));
+            else written++;
+        }
+        CHECK_EQUAL((size_t)total, written + dropped);
+    }
+}
+
+int main() {
+    return UnitTest::RunAllTests();
+}
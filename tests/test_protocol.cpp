@@ -5,8 +5,15 @@
 
 #include <UnitTest++/UnitTest++.h>
 #include <string>
+#include <atomic>
 #include <cstring>
 #include <cstdint>
+#include <vector>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "../buffer.hpp"
+#include "../protocol.hpp"
+#include "../shm.hpp"
 
 SUITE(ProtocolTests) {
     // Тест 1: Формат сообщения аутентификации
@@ -109,6 +116,313 @@ SUITE(ProtocolTests) {
         CHECK_EQUAL(4, sizeof(max_size));
         CHECK_EQUAL(4000, sizeof(sample_data));
     }
+    
+    // Тест 11: Пакетное декодирование серии float
+    TEST(DecodeFloatRun) {
+        float values[] = {1.0f, -2.5f, 0.0f, 1e-20f, 123456.75f};
+        uint8_t bytes[sizeof(values)];
+        for (size_t i = 0; i < 5; i++) {
+            uint32_t bits;
+            memcpy(&bits, &values[i], 4);
+            for (int b = 0; b < 4; b++) bytes[i*4 + b] = (bits >> (8*b)) & 0xFF;
+        }
+        
+        float decoded[5];
+        decodeLittleEndianFloats(bytes, 5, decoded);
+        CHECK_ARRAY_EQUAL(values, decoded, 5);
+    }
+    
+    // Тест 12: Приёмный буфер забирает несколько полей за одно чтение
+    TEST(RecvBufferBulkFill) {
+        int sv[2];
+        CHECK_EQUAL(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+        
+        std::vector<uint8_t> msg(4000);
+        for (size_t i = 0; i < msg.size(); i++) msg[i] = i & 0xFF;
+        CHECK_EQUAL((ssize_t)msg.size(), write(sv[0], msg.data(), msg.size()));
+        
+        RecvBuffer in(1024);
+        CHECK_EQUAL(1024, in.fill(sv[1]));
+        CHECK_EQUAL(1024, in.size());
+        in.consume(1000);
+        CHECK_EQUAL(1000 & 0xFF, in.data()[0]);
+        
+        // Хвост переносится в начало, свободное место снова 1000 байт
+        CHECK_EQUAL(1000, in.fill(sv[1]));
+        CHECK_EQUAL(1024, in.size());
+        CHECK_EQUAL(1000 & 0xFF, in.data()[0]);
+        
+        close(sv[0]);
+        close(sv[1]);
+    }
+    
+    // Тест 13: Расширенный заголовок вектора
+    TEST(ExtendedVectorHeader) {
+        VectorHeader h;
+        const uint8_t full[] = {0x10, 0x27, 0x00, 0x00, 2, 0x01, 0x00, 0, 0x00, 0x00, 0x80, 0x3F, 0, 0, 0, 0, 0, 0xAA, 0xBB};
+        CHECK(parseVectorHeader(full, 5, h));
+        CHECK(h.extended);
+        CHECK_EQUAL(10000u, h.size);
+        CHECK(h.mode == AccumMode::Compensated);
+        
+        // Лишние байты пропускаются, отсутствующие поля - по умолчанию
+        CHECK(parseVectorHeader(full, sizeof(full), h));
+        CHECK(parseVectorHeader(full, 4, h));
+        CHECK(h.mode == AccumMode::Float);
+        
+        CHECK(!parseVectorHeader(full, 3, h));
+        const uint8_t badMode[] = {1, 0, 0, 0, 9};
+        CHECK(!parseVectorHeader(badMode, 5, h));
+    }
+    
+    // Тест 14: Результат расширенного вектора - double little-endian
+    TEST(DoubleResultEncoding) {
+        uint8_t bytes[8];
+        writeLittleEndianDouble(1.0, bytes);
+        const uint8_t expected[] = {0, 0, 0, 0, 0, 0, 0xF0, 0x3F};
+        CHECK_ARRAY_EQUAL(expected, bytes, 8);
+    }
+    
+    // Тест 15: Маска операций в расширенном заголовке
+    TEST(VectorOpsField) {
+        VectorHeader h;
+        const uint8_t noOps[] = {8, 0, 0, 0, 1};
+        CHECK(parseVectorHeader(noOps, 5, h));
+        CHECK_EQUAL(OP_SUMSQ, h.ops);
+        
+        const uint8_t ops[] = {8, 0, 0, 0, 1, 0xB0, 0x01};
+        CHECK(parseVectorHeader(ops, 7, h));
+        CHECK_EQUAL(OP_MEAN | OP_VARIANCE | OP_MAX | OP_DOT, h.ops);
+        CHECK(h.mode == AccumMode::Double);
+        // Неполное поле не читается
+        CHECK(parseVectorHeader(ops, 6, h));
+        CHECK_EQUAL(OP_SUMSQ, h.ops);
+        
+        const uint8_t empty[] = {8, 0, 0, 0, 0, 0, 0};
+        CHECK(!parseVectorHeader(empty, 7, h));
+        const uint8_t unknown[] = {8, 0, 0, 0, 0, 0x01, 0x80};
+        CHECK(!parseVectorHeader(unknown, 7, h));
+    }
+    
+    // Тест 16: Тип элементов и масштаб в расширенном заголовке
+    TEST(VectorElemTypeField) {
+        VectorHeader h;
+        const uint8_t bf16[] = {8, 0, 0, 0, 0, 0x01, 0x00, 3};
+        CHECK(parseVectorHeader(bf16, 8, h));
+        CHECK(h.dtype == ElemType::BF16);
+        CHECK_EQUAL(1.0f, h.scale);
+        
+        // Масштаб 0.5f = 0x3F000000
+        const uint8_t scaled[] = {8, 0, 0, 0, 0, 0x01, 0x00, 4, 0x00, 0x00, 0x00, 0x3F};
+        CHECK(parseVectorHeader(scaled, 12, h));
+        CHECK(h.dtype == ElemType::I8);
+        CHECK_EQUAL(0.5f, h.scale);
+        
+        const uint8_t badType[] = {8, 0, 0, 0, 0, 0x01, 0x00, 7};
+        CHECK(!parseVectorHeader(badType, 8, h));
+        const uint8_t nanScale[] = {8, 0, 0, 0, 0, 0x01, 0x00, 4, 0x00, 0x00, 0xC0, 0x7F};
+        CHECK(!parseVectorHeader(nanScale, 12, h));
+    }
+    
+    // Тест 17: Разреженное кодирование в расширенном заголовке
+    TEST(SparseHeaderField) {
+        VectorHeader h;
+        const uint8_t sparse[] = {100, 0, 0, 0, 0, 0x01, 0x00, 0, 0, 0, 0x80, 0x3F, 1, 3, 0, 0, 0};
+        CHECK(parseVectorHeader(sparse, 17, h));
+        CHECK(h.sparse);
+        CHECK_EQUAL(3u, h.nnz);
+        
+        const uint8_t dense[] = {100, 0, 0, 0, 0, 0x01, 0x00, 0, 0, 0, 0x80, 0x3F, 0};
+        CHECK(parseVectorHeader(dense, 13, h));
+        CHECK(!h.sparse);
+        // Без nnz, с nnz больше size и с неизвестным кодированием заголовок неверен
+        CHECK(!parseVectorHeader(sparse, 16, h));
+        const uint8_t tooMany[] = {2, 0, 0, 0, 0, 0x01, 0x00, 0, 0, 0, 0x80, 0x3F, 1, 3, 0, 0, 0};
+        CHECK(!parseVectorHeader(tooMany, 17, h));
+        const uint8_t badEncoding[] = {100, 0, 0, 0, 0, 0x01, 0x00, 0, 0, 0, 0x80, 0x3F, 2};
+        CHECK(!parseVectorHeader(badEncoding, 13, h));
+    }
+    
+    // Тест 18: Записи разреженного вектора, в том числе пришедшие по байту
+    TEST(SparseDecoderEntries) {
+        // Индексы 5, 6 и 300 (приращение 294 = 0xA6 0x02), значения int8
+        const uint8_t data[] = {5, 10, 1, 20, 0xA6, 0x02, 0xF0};
+        uint8_t x[4];
+        size_t used = 0, filled = 0;
+        SparseDecoder whole(301, 3, 1, false);
+        CHECK(whole.decode(data, sizeof(data), used, x, nullptr, filled, 4));
+        CHECK_EQUAL(sizeof(data), used);
+        CHECK_EQUAL(3u, filled);
+        CHECK_EQUAL(0u, whole.remaining());
+        const uint8_t expected[] = {10, 20, 0xF0};
+        CHECK_ARRAY_EQUAL(expected, x, 3);
+        
+        // По байту: незаконченная запись ждёт следующих байт
+        SparseDecoder bytewise(301, 3, 1, false);
+        std::vector<uint8_t> pending;
+        filled = 0;
+        for (uint8_t b : data) {
+            pending.push_back(b);
+            CHECK(bytewise.decode(pending.data(), pending.size(), used, x, nullptr, filled, 4));
+            pending.erase(pending.begin(), pending.begin() + used);
+        }
+        CHECK(pending.empty());
+        CHECK_EQUAL(3u, filled);
+        CHECK_ARRAY_EQUAL(expected, x, 3);
+        
+        // Блок заполнен: разбор останавливается на его границе
+        SparseDecoder limited(301, 3, 1, false);
+        filled = 0;
+        CHECK(limited.decode(data, sizeof(data), used, x, nullptr, filled, 2));
+        CHECK_EQUAL(4u, used);
+        CHECK_EQUAL(1u, limited.remaining());
+    }
+    
+    // Тест 19: Неверные записи разреженного вектора
+    TEST(SparseDecoderErrors) {
+        uint8_t x[4], y[4];
+        size_t used, filled;
+        // Повторный индекс
+        const uint8_t repeat[] = {1, 7, 0, 8};
+        SparseDecoder a(10, 2, 1, false);
+        filled = 0;
+        CHECK(!a.decode(repeat, 4, used, x, nullptr, filled, 4));
+        // Индекс за концом вектора
+        const uint8_t outside[] = {9, 7, 1, 8};
+        SparseDecoder b(10, 2, 1, false);
+        filled = 0;
+        CHECK(!b.decode(outside, 4, used, x, nullptr, filled, 4));
+        // varint длиннее пяти байт
+        const uint8_t overlong[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x00, 1};
+        SparseDecoder c(10, 1, 1, false);
+        filled = 0;
+        CHECK(!c.decode(overlong, 7, used, x, nullptr, filled, 4));
+        // Пары значений расходятся по двум блокам
+        const uint8_t pair[] = {3, 1, 2};
+        SparseDecoder d(10, 1, 1, true);
+        filled = 0;
+        CHECK(d.decode(pair, 3, used, x, y, filled, 4));
+        CHECK_EQUAL(1, x[0]);
+        CHECK_EQUAL(2, y[0]);
+    }
+    
+    // Тест 20: Заголовок пакета векторов
+    TEST(BatchHeader) {
+        uint32_t count = 0;
+        AccumMode mode = AccumMode::Float;
+        // hdrLen = 1 + 3 * 4: три вектора в режиме double
+        const uint8_t three[] = {13, 0, 0, 0, 1};
+        CHECK(parseBatchHeader(three, count, mode));
+        CHECK_EQUAL(3u, count);
+        CHECK(mode == AccumMode::Double);
+        
+        const uint8_t empty[] = {1, 0, 0, 0, 0};
+        CHECK(!parseBatchHeader(empty, count, mode));
+        const uint8_t ragged[] = {7, 0, 0, 0, 0};
+        CHECK(!parseBatchHeader(ragged, count, mode));
+        const uint8_t badMode[] = {5, 0, 0, 0, 9};
+        CHECK(!parseBatchHeader(badMode, count, mode));
+        // 65537 векторов: hdrLen = 1 + 4 * 65537 = 0x40005
+        const uint8_t tooMany[] = {0x05, 0x00, 0x04, 0x00, 0};
+        CHECK(!parseBatchHeader(tooMany, count, mode));
+    }
+    
+    // Тест 21: Записи кольца общей памяти переносятся в начало целиком
+    TEST(ShmRingWrap) {
+        alignas(8) uint8_t data[256] = {};
+        std::atomic<uint64_t> head{0}, tail{0};
+        ShmRing writer(data, sizeof(data), &head, &tail);
+        ShmRing reader(data, sizeof(data), &head, &tail);
+        
+        uint32_t tag, len;
+        const uint8_t *rec;
+        CHECK(reader.peek(tag, rec, len) == ShmRing::Status::Empty);
+        // Записи больше половины кольца не принимаются
+        CHECK(writer.reserve(128) == nullptr);
+        
+        // 100 байт данных занимают 112: третья запись уже не помещается
+        for (uint32_t i = 0; i < 3; i++) {
+            uint8_t *p = writer.reserve(100);
+            if (i == 2) {
+                CHECK(p == nullptr);
+                break;
+            }
+            memset(p, i + 1, 100);
+            writer.commit(i, 100);
+        }
+        CHECK(reader.peek(tag, rec, len) == ShmRing::Status::Ready);
+        CHECK_EQUAL(0u, tag);
+        CHECK_EQUAL(100u, len);
+        reader.pop();
+        
+        // До конца кольца 32 байта: запись уходит в начало за маркером переноса
+        uint8_t *p = writer.reserve(60);
+        CHECK(p == data + SHM_RECORD_HEADER);
+        memset(p, 9, 60);
+        writer.commit(7, 60);
+        
+        CHECK(reader.peek(tag, rec, len) == ShmRing::Status::Ready);
+        CHECK_EQUAL(1u, tag);
+        CHECK_EQUAL(2, rec[99]);
+        reader.pop();
+        CHECK(reader.peek(tag, rec, len) == ShmRing::Status::Ready);
+        CHECK_EQUAL(7u, tag);
+        CHECK_EQUAL(60u, len);
+        CHECK(rec == data + SHM_RECORD_HEADER);
+        CHECK_EQUAL(9, rec[59]);
+        reader.pop();
+        CHECK(!reader.readable());
+        CHECK_EQUAL(tail.load(), head.load());
+    }
+    
+    // Тест 22: Испорченные позиции и длины записей не выводят за кольцо
+    TEST(ShmRingCorrupt) {
+        alignas(8) uint8_t data[256] = {};
+        std::atomic<uint64_t> head{0}, tail{0};
+        ShmRing reader(data, sizeof(data), &head, &tail);
+        uint32_t tag, len;
+        const uint8_t *rec;
+        
+        // Позиция записи дальше размера кольца
+        tail = 512;
+        CHECK(reader.peek(tag, rec, len) == ShmRing::Status::Corrupt);
+        // Невыровненная позиция
+        tail = 12;
+        CHECK(reader.peek(tag, rec, len) == ShmRing::Status::Corrupt);
+        // Длина записи больше опубликованного
+        uint32_t big = 200;
+        memcpy(data, &big, 4);
+        tail = 16;
+        CHECK(reader.peek(tag, rec, len) == ShmRing::Status::Corrupt);
+        // Запись, выходящая за конец кольца
+        head = 192;
+        tail = 192 + 120;
+        ShmRing shifted(data, sizeof(data), &head, &tail);
+        uint32_t long_ = 100;
+        memcpy(data + 192, &long_, 4);
+        CHECK(shifted.peek(tag, rec, len) == ShmRing::Status::Corrupt);
+    }
+    
+    // Тест 23: Длины и числа векторов из диапазона меток отклоняются, а не разбираются как данные
+    TEST(LegacyValuesBelowMarkers) {
+        CHECK(vectorSizeValid(0));
+        CHECK(vectorSizeValid(LEGACY_MAX));
+        CHECK(vectorSizeValid(EXT_VECTOR));
+        CHECK(!vectorSizeValid(PROTOCOL_RESERVED));
+        CHECK(!vectorSizeValid(SESSION_CLOSE));
+        CHECK(!vectorSizeValid(JOB_FRAME));
+        
+        CHECK(vectorCountValid(1));
+        CHECK(vectorCountValid(LEGACY_MAX));
+        for (uint32_t marker : {BATCH_FRAME, SESSION_CLOSE, JOB_FRAME, TICKET_REQUEST})
+            CHECK(vectorCountValid(marker));
+        CHECK(!vectorCountValid(PROTOCOL_RESERVED));
+        CHECK(!vectorCountValid(TICKET_REQUEST - 1));
+        
+        // Все метки лежат выше любого допустимого значения старого протокола
+        for (uint32_t marker : {EXT_VECTOR, BATCH_FRAME, SESSION_CLOSE, JOB_FRAME, TICKET_REQUEST})
+            CHECK(marker >= PROTOCOL_RESERVED);
+    }
 }
 
 int main() {
@@ -5,8 +5,24 @@
 
 #include <UnitTest++/UnitTest++.h>
 #include <cstring>
+#include <string>
+#include <vector>
 #include "../sha256.hpp"
 
+/// Хэш заданной реализацией одним вызовом sha256Update(), в hex
+static std::string hashWith(const Sha256Backend &backend, const std::string &data) {
+    Sha256Context ctx;
+    sha256Init(ctx, backend);
+    sha256Update(ctx, (const uint8_t*)data.data(), data.size());
+    uint8_t hash[32];
+    sha256Final(ctx, hash);
+    char hex[65];
+    for (int i = 0; i < 32; i++) {
+        sprintf(hex + i*2, "%02X", hash[i]);
+    }
+    return hex;
+}
+
 SUITE(SHA256Tests) {
     // Тест 1: Пустая строка
     TEST(EmptyString) {
@@ -131,6 +147,158 @@ SUITE(SHA256Tests) {
         
         CHECK(!all_zero);
     }
+    
+    // Тест 9: Потоковое вычисление при любом разбиении данных на две части
+    TEST(StreamingAnySplit) {
+        // 56 байт: дополнение уходит во второй блок
+        const char* text = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+        const char* expected = "248D6A61D20638B8E5C026930C3E6039A33CE45964FF2167F6ECEDD419DB06C1";
+        size_t len = strlen(text);
+        
+        bool all_match = true;
+        for (size_t split = 0; split <= len; split++) {
+            Sha256Context ctx;
+            sha256Init(ctx);
+            sha256Update(ctx, (const uint8_t*)text, split);
+            sha256Update(ctx, (const uint8_t*)text + split, len - split);
+            uint8_t hash[32];
+            sha256Final(ctx, hash);
+            char hex[65];
+            for (int i = 0; i < 32; i++) {
+                sprintf(hex + i*2, "%02X", hash[i]);
+            }
+            if (std::string(expected) != hex) all_match = false;
+        }
+        CHECK(all_match);
+    }
+    
+    // Тест 10: Миллион символов 'a' кусками разной длины
+    TEST(StreamingMillionA) {
+        std::string chunk(1000, 'a');
+        Sha256Context ctx;
+        sha256Init(ctx);
+        size_t left = 1000000;
+        for (size_t step = 1; left > 0; step = step * 7 % 1000 + 1) {
+            size_t n = step < left ? step : left;
+            sha256Update(ctx, (const uint8_t*)chunk.data(), n);
+            left -= n;
+        }
+        uint8_t hash[32];
+        sha256Final(ctx, hash);
+        
+        const char* expected = "CDC76E5C9914FB9281A1C7E284D73E67F1809A48A497200E046D39CCC7112CD0";
+        char hex[65];
+        for (int i = 0; i < 32; i++) {
+            sprintf(hex + i*2, "%02X", hash[i]);
+        }
+        CHECK_EQUAL(std::string(expected), std::string(hex));
+    }
+    
+    // Тест 11: Каждая поддерживаемая процессором реализация даёт контрольные хэши
+    TEST(AllBackendsKnownVectors) {
+        const std::pair<std::string, const char*> vectors[] = {
+            {"", "E3B0C44298FC1C149AFBF4C8996FB92427AE41E4649B934CA495991B7852B855"},
+            {"abc", "BA7816BF8F01CFEA414140DE5DAE2223B00361A396177A9CB410FF61F20015AD"},
+            {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+             "248D6A61D20638B8E5C026930C3E6039A33CE45964FF2167F6ECEDD419DB06C1"},
+            {"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+             "CF5B16A778AF8380036CE59E7B0492370B249B11E8F07A51AFAC45037AFEE9D1"},
+            {std::string(1000000, 'a'), "CDC76E5C9914FB9281A1C7E284D73E67F1809A48A497200E046D39CCC7112CD0"},
+        };
+        int tested = 0;
+        for (const auto &backend : sha256Backends()) {
+            if (!backend.supported()) continue;
+            tested++;
+            for (const auto &[data, expected] : vectors) {
+                CHECK_EQUAL(std::string(expected), hashWith(backend, data));
+            }
+        }
+        CHECK(tested >= 1);
+    }
+    
+    // Тест 12: Реализации совпадают с переносимой на всех длинах до четырёх блоков
+    TEST(AllBackendsMatchScalar) {
+        const Sha256Backend &scalar = sha256Backends().back();
+        CHECK_EQUAL(std::string("scalar"), std::string(scalar.name));
+        std::string data;
+        uint32_t x = 12345;
+        for (int i = 0; i < 256; i++) {
+            x = x * 1103515245 + 12345;
+            data.push_back((char)(x >> 24));
+        }
+        bool all_match = true;
+        for (const auto &backend : sha256Backends()) {
+            if (!backend.supported()) continue;
+            for (size_t len = 0; len <= data.size(); len++) {
+                std::string part = data.substr(0, len);
+                if (hashWith(backend, part) != hashWith(scalar, part)) all_match = false;
+            }
+        }
+        CHECK(all_match);
+    }
+    
+    // Тест 13: Многобуферные реализации совпадают с хэшем по одному сообщению
+    TEST(ManyBackendsMatchSingle) {
+        // Сообщения разной длины: дорожки заканчиваются на разных блоках
+        std::vector<std::string> messages;
+        for (size_t i = 0; i < 37; i++) messages.push_back(std::string(i * 7 % 200, (char)('a' + i % 26)));
+        std::vector<const uint8_t*> data;
+        std::vector<size_t> lengths;
+        for (const auto &m : messages) {
+            data.push_back((const uint8_t*)m.data());
+            lengths.push_back(m.size());
+        }
+        std::vector<uint8_t> expected(32 * messages.size());
+        for (size_t i = 0; i < messages.size(); i++) sha256(data[i], lengths[i], &expected[32 * i]);
+        
+        bool all_match = true;
+        for (const auto &backend : sha256ManyBackends()) {
+            if (!backend.supported()) continue;
+            for (size_t count = 1; count <= backend.lanes; count++) {
+                for (size_t start = 0; start + count <= messages.size(); start += count) {
+                    uint8_t out[16][32];
+                    backend.hash(&data[start], &lengths[start], count, out);
+                    if (memcmp(out, &expected[32 * start], 32 * count) != 0) all_match = false;
+                }
+            }
+        }
+        CHECK(all_match);
+        
+        std::vector<uint8_t> out(32 * messages.size());
+        sha256Many(data.data(), lengths.data(), messages.size(), (uint8_t(*)[32])out.data());
+        CHECK(out == expected);
+    }
+    
+    // Тест 14: HMAC-SHA256 по векторам RFC 4231 (случаи 1, 2 и 6)
+    TEST(HmacRfc4231) {
+        struct Case { std::string key, data; const char *expected; };
+        const Case cases[] = {
+            {std::string(20, '\x0b'), "Hi There",
+             "B0344C61D8DB38535CA8AFCEAF0BF12B881DC200C9833DA726E9376C2E32CFF7"},
+            {"Jefe", "what do ya want for nothing?",
+             "5BDCC146BF60754E6A042426089575C75A003F089D2739839DEC58B964EC3843"},
+            // Ключ длиннее блока сначала хэшируется
+            {std::string(131, '\xaa'), "Test Using Larger Than Block-Size Key - Hash Key First",
+             "60E431591EE0B67F0D8A26AACBF5B77F8E0BC6213728C5140546040F0EE37F54"},
+        };
+        for (const Case &c : cases) {
+            HmacSha256Key key;
+            hmacSha256Init(key, (const uint8_t*)c.key.data(), c.key.size());
+            uint8_t mac[32];
+            hmacSha256(key, (const uint8_t*)c.data.data(), c.data.size(), mac);
+            char hex[65];
+            for (int i = 0; i < 32; i++) {
+                sprintf(hex + i*2, "%02X", mac[i]);
+            }
+            CHECK_EQUAL(std::string(c.expected), std::string(hex));
+        }
+        
+        // Сравнение без раннего выхода
+        const uint8_t a[4] = {1, 2, 3, 4}, b[4] = {1, 2, 3, 5};
+        CHECK(constantTimeEqual(a, a, 4));
+        CHECK(!constantTimeEqual(a, b, 4));
+        CHECK(constantTimeEqual(a, b, 3));
+    }
 }
 
 int main() {
@@ -7,7 +7,19 @@
 #include <vector>
 #include <cstring>
 #include <cmath>
+#include <string>
 #include <cstdint>  // Добавил этот include
+#include <algorithm>
+#include "../kernels.hpp"
+#include "../pool.hpp"
+#include "../reduction.hpp"
+#include "../ops.hpp"
+#include "../jobs.hpp"
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <atomic>
+#include <thread>
 
 float calculateSumOfSquares(const std::vector<float>& vec) {
     float sum = 0.0f;
@@ -41,6 +53,22 @@ float littleEndianToFloat(uint32_t val) {
     return f;
 }
 
+/// Кадр задания: размер и элементы float (или расширенный заголовок, если он задан)
+static std::vector<uint8_t> jobFrame(const std::vector<float> &v, const std::vector<uint8_t> &ext = {}) {
+    size_t head = ext.empty() ? 4 : 5 + ext.size();
+    std::vector<uint8_t> frame(head + 4 * v.size());
+    if (ext.empty()) {
+        uint32_t n = v.size();
+        memcpy(frame.data(), &n, 4);
+    } else {
+        memset(frame.data(), 0xFF, 4);
+        frame[4] = ext.size();
+        memcpy(frame.data() + 5, ext.data(), ext.size());
+    }
+    if (!v.empty()) memcpy(frame.data() + head, v.data(), 4 * v.size());
+    return frame;
+}
+
 SUITE(VectorTests) {
     // Тест 1: Простой вектор
     TEST(SimpleVector) {
@@ -134,6 +162,432 @@ SUITE(VectorTests) {
         float converted = littleEndianToFloat(le);
         CHECK_CLOSE(negative, converted, 0.0001f);
     }
+    
+    // Тест 13: Все поддерживаемые реализации ядра совпадают с эталоном
+    // на длинах, покрывающих основной цикл и все варианты хвоста
+    TEST(KernelVariantsMatchReference) {
+        std::vector<float> vec(1000);
+        for (size_t i = 0; i < vec.size(); i++) vec[i] = std::sin(i * 0.37f) * 3.0f;
+        
+        for (const auto &k : sumOfSquaresKernels()) {
+            if (!k.supported()) continue;
+            for (size_t n = 0; n <= vec.size(); n += (n < 130 ? 1 : 97)) {
+                double expected = 0.0;
+                for (size_t i = 0; i < n; i++) expected += (double)vec[i] * vec[i];
+                float result = k.fn(vec.data(), n);
+                CHECK_CLOSE(expected, result, 1e-5 * expected + 1e-6);
+            }
+        }
+    }
+    
+    // Тест 14: Диспетчер выбирает поддерживаемую реализацию
+    TEST(KernelDispatch) {
+        std::vector<float> vec = {1.0f, 2.0f, 3.0f, 4.0f};
+        CHECK_CLOSE(30.0f, sumOfSquares(vec.data(), vec.size()), 0.0001f);
+        
+        bool found = false;
+        for (const auto &k : sumOfSquaresKernels()) {
+            if (std::string(k.name) == sumOfSquaresImpl()) found = k.supported();
+        }
+        CHECK(found);
+    }
+    
+    // Тест 15: Блочная редукция совпадает с эталоном, в том числе
+    // для неполного последнего блока и при повторном использовании
+    TEST(ChunkedSumMatchesReference) {
+        WorkPool pool(2);
+        ChunkedSum chunked(pool);
+        for (size_t n : {0ul, 5ul, ChunkedSum::CHUNK, 7 * ChunkedSum::CHUNK + 123}) {
+            std::vector<float> vec(n);
+            double expected = 0.0;
+            for (size_t i = 0; i < n; i++) {
+                vec[i] = std::sin(i * 0.01f);
+                expected += (double)vec[i] * vec[i];
+            }
+            chunked.appendAll((const uint8_t*)vec.data(), n);
+            CHECK_CLOSE(expected, chunked.finish(), 1e-5 * expected + 1e-6);
+        }
+    }
+    
+    // Тест 16: Результат не зависит от числа потоков и от размера порций
+    TEST(ChunkedSumDeterministic) {
+        std::vector<float> vec(40 * ChunkedSum::CHUNK + 77);
+        for (size_t i = 0; i < vec.size(); i++) vec[i] = std::sin(i * 0.37f) * 3.0f;
+        const uint8_t *bytes = (const uint8_t*)vec.data();
+        
+        float first = 0.0f;
+        bool haveFirst = false;
+        for (unsigned threads : {1u, 2u, 4u, 8u}) {
+            WorkPool pool(threads);
+            ChunkedSum chunked(pool);
+            for (size_t piece : {1000ul, 4096ul, vec.size()}) {
+                for (size_t done = 0; done < vec.size(); done += piece)
+                    chunked.appendAll(bytes + done * 4, std::min(piece, vec.size() - done));
+                float sum = chunked.finish();
+                if (!haveFirst) { first = sum; haveFirst = true; }
+                CHECK_EQUAL(first, sum);
+            }
+        }
+    }
+    
+    // Тест 17: Двойная буферизация - при занятых блоках append() принимает
+    // не всё, а пул сообщает о готовности блока через eventfd
+    TEST(ChunkedSumAsyncWake) {
+        WorkPool pool(1);
+        ChunkedSum chunked(pool, 2);
+        CHECK_EQUAL(2u, chunked.window());
+        
+        // Единственный поток пула занят, пока блоки не заполнятся
+        std::atomic<bool> release{false};
+        pool.submit({[](void *arg) {
+            while (!static_cast<std::atomic<bool>*>(arg)->load()) std::this_thread::yield();
+        }, &release});
+        
+        std::vector<float> vec(3 * ChunkedSum::CHUNK, 0.5f);
+        const uint8_t *bytes = (const uint8_t*)vec.data();
+        size_t done = chunked.append(bytes, vec.size());
+        CHECK_EQUAL(2 * ChunkedSum::CHUNK, done);
+        
+        int efd = eventfd(0, EFD_CLOEXEC);
+        CHECK(chunked.waitAsync(efd));
+        release = true;
+        pollfd p = {efd, POLLIN, 0};
+        CHECK_EQUAL(1, poll(&p, 1, 5000));
+        close(efd);
+        
+        chunked.appendAll(bytes + done * 4, vec.size() - done);
+        CHECK_EQUAL(vec.size() * 0.25f, chunked.finish());
+    }
+    
+    // Тест 18: Ядра double и компенсированного накопления во всех реализациях
+    TEST(KernelDoubleVariantsMatchReference) {
+        std::vector<float> vec(1000);
+        for (size_t i = 0; i < vec.size(); i++) vec[i] = std::sin(i * 0.37f) * 3.0f;
+        
+        for (const auto &k : sumOfSquaresKernels()) {
+            if (!k.supported()) continue;
+            for (size_t n = 0; n <= vec.size(); n += (n < 70 ? 1 : 97)) {
+                long double expected = 0.0L;
+                for (size_t i = 0; i < n; i++) expected += (long double)vec[i] * vec[i];
+                CHECK_CLOSE((double)expected, k.fnDouble(vec.data(), n), 1e-12 * (double)expected);
+                double sum = 0.0, comp = 0.0;
+                k.fnCompensated(vec.data(), n, sum, comp);
+                CHECK_CLOSE((double)expected, sum + comp, 1e-15 * (double)expected);
+            }
+        }
+    }
+    
+    // Тест 19: Точные режимы накопления заметно точнее float на длинном векторе
+    TEST(AccumModesPrecision) {
+        std::vector<float> vec(1 << 22);
+        long double exact = 0.0L, comp = 0.0L;
+        for (size_t i = 0; i < vec.size(); i++) {
+            vec[i] = 1.0f + (i % 1000) * 1e-3f;
+            // Эталон - сумма Ноймайера в long double
+            long double y = (long double)vec[i] * vec[i], t = exact + y;
+            comp += std::fabs(exact) >= std::fabs(y) ? (exact - t) + y : (y - t) + exact;
+            exact = t;
+        }
+        exact += comp;
+        
+        double err[ACCUM_MODES];
+        for (unsigned m = 0; m < ACCUM_MODES; m++) {
+            double r = sumOfSquares((AccumMode)m, vec.data(), vec.size());
+            err[m] = std::fabs((double)(r - exact) / (double)exact);
+        }
+        CHECK(err[(int)AccumMode::Float] < 1e-3);
+        CHECK(err[(int)AccumMode::Double] < 1e-13);
+        CHECK(err[(int)AccumMode::Compensated] < 1e-16);
+        CHECK(err[(int)AccumMode::Pairwise] < 1e-6);
+        CHECK(err[(int)AccumMode::Pairwise] <= err[(int)AccumMode::Float]);
+    }
+    
+    // Тест 20: Совместная редукция всех реализаций совпадает с эталоном
+    TEST(FusedOpsMatchReference) {
+        std::vector<float> x(5000), y(5000);
+        for (size_t i = 0; i < x.size(); i++) {
+            x[i] = ((int)(i * 37 % 101) - 50) * 0.25f;
+            y[i] = ((int)(i * 53 % 89) - 44) * 0.5f;
+        }
+        for (const auto &set : fusedKernelSets()) {
+            if (!set.supported()) continue;
+            for (size_t n : {0, 1, 7, 16, 33, 1024, 1500, 5000}) {
+                long double sumsq = 0, sumabs = 0, sum = 0, dot = 0;
+                float lo = INFINITY, hi = -INFINITY, amax = 0;
+                for (size_t i = 0; i < n; i++) {
+                    sumsq += (long double)x[i] * x[i];
+                    sumabs += std::fabs(x[i]);
+                    sum += x[i];
+                    dot += (long double)x[i] * y[i];
+                    lo = std::min(lo, x[i]);
+                    hi = std::max(hi, x[i]);
+                    amax = std::max(amax, std::fabs(x[i]));
+                }
+                long double mean = n ? sum / n : 0, var = 0;
+                for (size_t i = 0; i < n; i++) var += (x[i] - mean) * (x[i] - mean);
+                
+                FusedReduction fused(OP_ALL, ElemType::F32, 1.0, &set);
+                for (size_t i = 0; i < n; i += SQUARE_BLOCK)
+                    fused.add(x.data() + i, y.data() + i, std::min(SQUARE_BLOCK, n - i));
+                double r[MAX_VECTOR_RESULTS];
+                CHECK_EQUAL(9u, fused.results(r));
+                CHECK_CLOSE((double)sumsq, r[0], 1e-12 * (double)sumsq);
+                CHECK_CLOSE((double)sumabs, r[1], 1e-12 * (double)sumabs);
+                CHECK_CLOSE(std::sqrt((double)sumsq), r[2], 1e-12 * std::sqrt((double)sumsq));
+                CHECK_EQUAL(amax, r[3]);
+                CHECK_CLOSE((double)dot, r[8], 1e-9);
+                if (n == 0) {
+                    CHECK(std::isnan(r[4]) && std::isnan(r[5]) && std::isnan(r[6]) && std::isnan(r[7]));
+                    continue;
+                }
+                CHECK_CLOSE((double)mean, r[4], 1e-12);
+                CHECK_CLOSE((double)(var / n), r[5], 1e-12 * (double)(var / n) + 1e-15);
+                CHECK_EQUAL(lo, r[6]);
+                CHECK_EQUAL(hi, r[7]);
+            }
+        }
+    }
+    
+    // Тест 21: Отдельные операции дают те же значения, что и в общем наборе
+    TEST(FusedOpsSubsets) {
+        std::vector<float> x(3000), y(3000);
+        for (size_t i = 0; i < x.size(); i++) {
+            x[i] = std::sin(i * 0.1f) * 10.0f;
+            y[i] = std::cos(i * 0.3f);
+        }
+        std::vector<double> all = reduceOps(OP_ALL, x.data(), y.data(), x.size());
+        for (unsigned bit = 0; bit < all.size(); bit++) {
+            std::vector<double> one = reduceOps(1 << bit, x.data(), y.data(), x.size());
+            CHECK_EQUAL(1u, one.size());
+            CHECK_EQUAL(all[bit], one[0]);
+        }
+        std::vector<double> pair = reduceOps(OP_MEAN | OP_MAX, x.data(), nullptr, x.size());
+        CHECK_EQUAL(2u, pair.size());
+        CHECK_EQUAL(all[4], pair[0]);
+        CHECK_EQUAL(all[7], pair[1]);
+    }
+    
+    // Тест 22: Дисперсия не теряет точности при большом среднем
+    TEST(FusedVarianceLargeMean) {
+        std::vector<float> x(1 << 16);
+        for (size_t i = 0; i < x.size(); i++) x[i] = 10000.0f + ((i % 2) ? 0.5f : -0.5f);
+        std::vector<double> r = reduceOps(OP_MEAN | OP_VARIANCE, x.data(), nullptr, x.size());
+        CHECK_CLOSE(10000.0, r[0], 1e-9);
+        CHECK_CLOSE(0.25, r[1], 1e-12);
+    }
+    
+    // Тест 23: Все типы элементов на всех реализациях, с масштабом
+    TEST(FusedElemTypesMatchReference) {
+        const size_t n = 1500;
+        std::vector<double> values(n);
+        for (size_t i = 0; i < n; i++) values[i] = ((int)(i * 37 % 129) - 64) * 0.25;
+        
+        // Сырые элементы каждого типа: для целых raw = value * 4, масштаб 0.25
+        std::vector<uint8_t> raw[ELEM_TYPES];
+        for (unsigned t = 0; t < ELEM_TYPES; t++) raw[t].resize(n * elemTypeSize((ElemType)t));
+        for (size_t i = 0; i < n; i++) {
+            float f = (float)values[i];
+            double d = values[i];
+            uint32_t fb;
+            memcpy(&fb, &f, 4);
+            uint16_t half = 0;
+            if (f != 0.0f) {
+                int exp = (int)((fb >> 23) & 0xFF) - 127 + 15;
+                half = ((fb >> 16) & 0x8000) | (exp << 10) | ((fb >> 13) & 0x3FF);
+            }
+            uint16_t bf = fb >> 16;
+            int8_t i8 = (int8_t)(d * 4);
+            int16_t i16 = (int16_t)(d * 4);
+            int32_t i32 = (int32_t)(d * 4);
+            memcpy(&raw[(int)ElemType::F32][i * 4], &f, 4);
+            memcpy(&raw[(int)ElemType::F64][i * 8], &d, 8);
+            memcpy(&raw[(int)ElemType::F16][i * 2], &half, 2);
+            memcpy(&raw[(int)ElemType::BF16][i * 2], &bf, 2);
+            memcpy(&raw[(int)ElemType::I8][i], &i8, 1);
+            memcpy(&raw[(int)ElemType::I16][i * 2], &i16, 2);
+            memcpy(&raw[(int)ElemType::I32][i * 4], &i32, 4);
+        }
+        
+        // Эталон при масштабе -1: знак меняет местами минимум и максимум
+        double sumsq = 0, sumabs = 0, sum = 0, dot = 0, lo = INFINITY, hi = -INFINITY, amax = 0;
+        for (double v : values) {
+            sumsq += v * v;
+            sumabs += std::fabs(v);
+            sum += v;
+            dot += v * v;
+            lo = std::min(lo, -v);
+            hi = std::max(hi, -v);
+            amax = std::max(amax, std::fabs(v));
+        }
+        double mean = -sum / n, var = 0;
+        for (double v : values) var += (-v - mean) * (-v - mean);
+        var /= n;
+        
+        for (const auto &set : fusedKernelSets()) {
+            if (!set.supported()) continue;
+            for (unsigned t = 0; t < ELEM_TYPES; t++) {
+                ElemType type = (ElemType)t;
+                bool integer = type == ElemType::I8 || type == ElemType::I16 || type == ElemType::I32;
+                FusedReduction fused(OP_ALL, type, integer ? -0.25 : -1.0, &set);
+                size_t w = elemTypeSize(type);
+                for (size_t i = 0; i < n; i += SQUARE_BLOCK) {
+                    size_t k = std::min(SQUARE_BLOCK, n - i);
+                    fused.add(raw[t].data() + i * w, raw[t].data() + i * w, k);
+                }
+                double r[MAX_VECTOR_RESULTS];
+                fused.results(r);
+                CHECK_CLOSE(sumsq, r[0], 1e-9);
+                CHECK_CLOSE(sumabs, r[1], 1e-9);
+                CHECK_CLOSE(std::sqrt(sumsq), r[2], 1e-9);
+                CHECK_EQUAL(amax, r[3]);
+                CHECK_CLOSE(mean, r[4], 1e-12);
+                CHECK_CLOSE(var, r[5], 1e-9);
+                CHECK_EQUAL(lo, r[6]);
+                CHECK_EQUAL(hi, r[7]);
+                CHECK_CLOSE(dot, r[8], 1e-9);
+            }
+        }
+    }
+    
+    // Тест 24: Особые значения половинной точности
+    TEST(HalfPrecisionSpecialValues) {
+        const uint16_t bits[] = {0x3C00, 0xC000, 0x0001, 0x7BFF, 0x8000, 0x3555};
+        const double expected[] = {1.0, -2.0, std::ldexp(1.0, -24), 65504.0, 0.0, 0.333251953125};
+        for (const auto &set : fusedKernelSets()) {
+            if (!set.supported()) continue;
+            // 16 копий, чтобы значение прошло и через векторную часть ядра
+            for (size_t k = 0; k < 6; k++) {
+                std::vector<uint16_t> v(16, bits[k]);
+                FusedReduction fused(OP_MIN | OP_MAX, ElemType::F16, 1.0, &set);
+                fused.add(v.data(), nullptr, v.size());
+                double r[2];
+                fused.results(r);
+                CHECK_EQUAL(expected[k], r[0]);
+                CHECK_EQUAL(expected[k], r[1]);
+            }
+            uint16_t inf[17];
+            std::fill(inf, inf + 17, 0x7C00);
+            FusedReduction fused(OP_MAX, ElemType::F16, 1.0, &set);
+            fused.add(inf, nullptr, 17);
+            double r;
+            fused.results(&r);
+            CHECK(std::isinf(r) && r > 0);
+        }
+    }
+    
+    // Тест 25: Разреженный вектор (ненулевые элементы и число нулей) совпадает с плотным
+    TEST(FusedZerosMatchDense) {
+        const size_t n = 5000;
+        std::vector<float> dense(n, 0.0f), nz;
+        for (size_t i = 0; i < n; i += 7) dense[i] = (float)((int)(i % 23) - 8) + 0.5f;
+        for (float v : dense) if (v != 0.0f) nz.push_back(v);
+        
+        FusedReduction full(OP_ALL & ~OP_DOT);
+        for (size_t i = 0; i < n; i += SQUARE_BLOCK) full.add(&dense[i], nullptr, std::min(SQUARE_BLOCK, n - i));
+        FusedReduction sparse(OP_ALL & ~OP_DOT);
+        for (size_t i = 0; i < nz.size(); i += SQUARE_BLOCK) sparse.add(&nz[i], nullptr, std::min(SQUARE_BLOCK, nz.size() - i));
+        sparse.addZeros(n - nz.size());
+        
+        double a[MAX_VECTOR_RESULTS], b[MAX_VECTOR_RESULTS];
+        unsigned count = full.results(a);
+        CHECK_EQUAL(count, sparse.results(b));
+        for (unsigned k = 0; k < count; k++) CHECK_CLOSE(a[k], b[k], 1e-9 * std::max(1.0, std::fabs(a[k])));
+        // Все элементы положительны: нули опускают минимум до 0
+        FusedReduction positive(OP_MIN | OP_MEAN);
+        const float ones[] = {1.0f, 3.0f};
+        positive.add(ones, nullptr, 2);
+        positive.addZeros(2);
+        positive.results(a);
+        CHECK_EQUAL(1.0, a[0]);
+        CHECK_EQUAL(0.0, a[1]);
+    }
+    
+    // Тест 26: Кадр задания считается так же, как вектор из потока
+    TEST(JobFrameMatchesStream) {
+        std::vector<float> v(3000);
+        for (size_t i = 0; i < v.size(); i++) v[i] = (float)(i % 11) - 5.0f;
+        
+        Job job;
+        job.frame = jobFrame(v);
+        computeJob(job);
+        CHECK_EQUAL(1u, job.resultCount);
+        CHECK_EQUAL(sumOfSquares(AccumMode::Float, v.data(), v.size()), job.results[0]);
+        
+        // Расширенный заголовок: среднее и максимум, size = 3000
+        const std::vector<uint8_t> ext = {0xB8, 0x0B, 0, 0, 1, 0x90, 0x00};
+        job.frame = jobFrame(v, ext);
+        computeJob(job);
+        CHECK_EQUAL(2u, job.resultCount);
+        CHECK(job.hdr.ops == (OP_MEAN | OP_MAX));
+        std::vector<double> expected = reduceOps(OP_MEAN | OP_MAX, v.data(), nullptr, v.size());
+        CHECK_EQUAL(expected[0], job.results[0]);
+        CHECK_EQUAL(5.0, job.results[1]);
+        
+        // Данных меньше или больше, чем заявлено, - вектор неверен
+        job.frame = jobFrame(v);
+        job.frame.pop_back();
+        computeJob(job);
+        CHECK_EQUAL(0u, job.resultCount);
+        job.frame = jobFrame(v);
+        job.frame.push_back(0);
+        computeJob(job);
+        CHECK_EQUAL(0u, job.resultCount);
+        job.frame.assign(3, 0);
+        computeJob(job);
+        CHECK_EQUAL(0u, job.resultCount);
+        
+        // Длина из диапазона меток (кроме EXT_VECTOR) не разбирается
+        job.frame = {0xFE, 0xFF, 0xFF, 0xFF, 0, 0, 0, 0};
+        computeJob(job);
+        CHECK_EQUAL(0u, job.resultCount);
+    }
+    
+    // Тест 27: Задания на пуле забираются по готовности, каждое со своим номером
+    TEST(JobQueueCollectsAll) {
+        WorkPool pool(2);
+        JobQueue queue(&pool, -1);
+        const uint32_t count = 20;
+        for (uint32_t id = 0; id < count; id++) {
+            std::vector<uint8_t> frame = jobFrame(std::vector<float>(id % 2 ? 100000 : 10, (float)id));
+            Job &job = queue.start(id, frame.size());
+            memcpy(job.frame.data(), frame.data(), frame.size());
+            queue.submit(job);
+        }
+        
+        std::vector<double> results(count, -1.0);
+        while (queue.pending() > 0) {
+            queue.waitOne();
+            queue.collect([&](const Job &job) {
+                CHECK_EQUAL(1u, job.resultCount);
+                results[job.id] = job.results[0];
+            });
+        }
+        for (uint32_t id = 0; id < count; id++) {
+            double n = id % 2 ? 100000 : 10;
+            CHECK_EQUAL(n * id * id, results[id]);
+        }
+        
+        // Окно заданий ограничено числом и объёмом кадров
+        for (size_t i = 0; i < JobQueue::MAX_JOBS; i++) {
+            CHECK(queue.hasRoom(4));
+            queue.start(i, 4);
+        }
+        CHECK(!queue.hasRoom(4));
+    }
+    
+    // Тест 28: Тип элементов вне таблицы ядер не используется
+    TEST(FusedRejectsUnknownType) {
+        const float x[4] = {1.0f, -2.0f, 3.0f, 4.0f};
+        for (unsigned type : {ELEM_TYPES, ELEM_TYPES + 1, 255u}) {
+            FusedReduction fused(OP_ALL, (ElemType)type);
+            CHECK(!fused.valid());
+            fused.add(x, x, 4);
+            double out[16];
+            CHECK_EQUAL(0u, fused.results(out));
+            CHECK_EQUAL(0u, fused.moments().count);
+        }
+        CHECK(FusedReduction(OP_ALL, (ElemType)(ELEM_TYPES - 1)).valid());
+    }
 }
 
 int main() {
@@ -0,0 +1,134 @@
+/**
+ * @file tickets.cpp
+ * @brief Реализация билетов возобновления сессии
+ */
+
+#include "tickets.hpp"
+#include <cerrno>
+#include <cstring>
+#include <random>
+#include <sys/random.h>
+
+using namespace std;
+
+static void put32(uint32_t v, uint8_t *p) {
+    for (int i = 0; i < 4; i++) p[i] = (v >> (8 * i)) & 0xFF;
+}
+
+static uint32_t get32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Заполняет буфер случайными байтами ядра (getrandom)
+ */
+static void randomBytes(uint8_t *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = getrandom(buf + got, len - got, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += n;
+    }
+    // Без getrandom (старое ядро) - random_device, который читает /dev/urandom
+    if (got < len) {
+        random_device rd;
+        for (; got < len; got++) buf[got] = rd() & 0xFF;
+    }
+}
+
+TicketKeys::TicketKeys(unsigned lifetime) : lifetime(lifetime) {
+    for (Slot &s : slots)
+        for (auto &w : s.words) w.store(0, memory_order_relaxed);
+}
+
+void TicketKeys::setLifetime(unsigned seconds) {
+    lifetime = seconds;
+}
+
+/**
+ * @brief Выпускает новый ключ, если срок текущего вышел
+ *
+ * @details Новый ключ пишется в ячейку ключа, предшествовавшего
+ * текущему: билеты на нём уже истекли. Пока ячейка записывается, её
+ * номер равен 0, и читатель (load()) повторную проверку не пройдёт.
+ */
+void TicketKeys::rotate(time_t now) const {
+    bool expected = false;
+    if (!rotating.compare_exchange_strong(expected, true, memory_order_acquire)) return;
+    if (now >= nextRotation.load(memory_order_relaxed)) {
+        uint32_t id = current.load(memory_order_relaxed) + 1;
+        if (id == 0) id = 2;        // 0 - признак пустой ячейки, чётность сохраняется
+
+        uint8_t secret[32];
+        randomBytes(secret, sizeof(secret));
+        HmacSha256Key key;
+        hmacSha256Init(key, secret, sizeof(secret));
+        memset(secret, 0, sizeof(secret));
+        uint64_t words[8];
+        static_assert(sizeof(words) == sizeof(HmacSha256Key), "ключ HMAC - 8 слов по 64 бита");
+        memcpy(words, &key, sizeof(words));
+
+        Slot &s = slots[id & 1];
+        s.id.store(0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+        for (int i = 0; i < 8; i++) s.words[i].store(words[i], memory_order_relaxed);
+        s.id.store(id, memory_order_release);
+        current.store(id, memory_order_release);
+        nextRotation.store(now + lifetime, memory_order_release);
+    }
+    rotating.store(false, memory_order_release);
+}
+
+/**
+ * @brief Читает ключ с номером id
+ * @return false если ячейка хранит другой ключ или как раз перезаписывается
+ */
+bool TicketKeys::load(uint32_t id, HmacSha256Key &key) const {
+    if (id == 0) return false;
+    const Slot &s = slots[id & 1];
+    if (s.id.load(memory_order_acquire) != id) return false;
+    uint64_t words[8];
+    for (int i = 0; i < 8; i++) words[i] = s.words[i].load(memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    if (s.id.load(memory_order_relaxed) != id) return false;
+    memcpy(&key, words, sizeof(key));
+    return true;
+}
+
+size_t TicketKeys::issue(string_view login, time_t now, uint8_t *out) const {
+    size_t len = TICKET_HEADER + login.size() + TICKET_MAC_SIZE;
+    if (!enabled() || login.empty() || len > TICKET_MAX) return 0;
+    if (now >= nextRotation.load(memory_order_acquire)) rotate(now);
+
+    uint32_t id = current.load(memory_order_acquire);
+    HmacSha256Key key;
+    if (!load(id, key)) return 0;
+    put32(id, out);
+    put32((uint32_t)(now + lifetime), out + 4);
+    out[8] = (uint8_t)login.size();
+    memcpy(out + TICKET_HEADER, login.data(), login.size());
+    hmacSha256(key, out, TICKET_HEADER + login.size(), out + TICKET_HEADER + login.size());
+    return len;
+}
+
+bool TicketKeys::verify(const uint8_t *ticket, size_t len, time_t now, string_view &login) const {
+    if (!enabled() || len < TICKET_HEADER + 1 + TICKET_MAC_SIZE) return false;
+    size_t loginLen = ticket[8];
+    if (len != TICKET_HEADER + loginLen + TICKET_MAC_SIZE) return false;
+    if (now >= nextRotation.load(memory_order_acquire)) rotate(now);
+
+    // Принимаются только текущий и предыдущий ключи
+    uint32_t id = get32(ticket);
+    uint32_t cur = current.load(memory_order_acquire);
+    if (id != cur && id != cur - 1) return false;
+    if ((int64_t)get32(ticket + 4) <= (int64_t)now) return false;
+
+    HmacSha256Key key;
+    if (!load(id, key)) return false;
+    uint8_t mac[TICKET_MAC_SIZE];
+    hmacSha256(key, ticket, TICKET_HEADER + loginLen, mac);
+    if (!constantTimeEqual(mac, ticket + TICKET_HEADER + loginLen, TICKET_MAC_SIZE)) return false;
+    login = string_view((const char*)ticket + TICKET_HEADER, loginLen);
+    return true;
+}
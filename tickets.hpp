@@ -0,0 +1,95 @@
+/**
+ * @file tickets.hpp
+ * @brief Билеты возобновления сессии, запечатанные HMAC-SHA256
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+#include <string_view>
+#include "sha256.hpp"
+
+/// Заголовок билета: номер ключа, срок действия и длина логина
+const size_t TICKET_HEADER = 9;
+
+/// Длина кода HMAC-SHA256 в конце билета
+const size_t TICKET_MAC_SIZE = 32;
+
+/// Наибольшая длина билета (длина в рукопожатии - один байт)
+const size_t TICKET_MAX = 255;
+
+/**
+ * @brief Ключи билетов возобновления с заменой по времени
+ *
+ * @details После входа по паролю клиент может запросить билет
+ * (TICKET_REQUEST) и при следующем подключении предъявить его вместо
+ * пароля. Билет непрозрачен для клиента:
+ *
+ *     uint32 keyId | uint32 expiry | uint8 loginLen | login | mac[32]
+ *
+ * mac - HMAC-SHA256 всех предыдущих байт на ключе keyId. Проверка - один
+ * HMAC, без поиска в базе пользователей и без SHA-256 пароля; удалённый
+ * из базы пользователь может войти по билету, пока тот не истёк.
+ *
+ * Ключи случайные и живут только в памяти. Каждые lifetime секунд
+ * выпускается новый ключ, а принимаются билеты текущего и предыдущего
+ * ключа: билет действует не дольше lifetime, и его ключ забывается
+ * не позже чем через 2 * lifetime. После перезапуска сервера все
+ * билеты недействительны.
+ *
+ * Ключ меняет тот поток, который первым заметил, что срок вышел.
+ * Читатели не блокируются: ячейка ключа защищена счётчиком, как seqlock
+ * (номер ключа сбрасывается на время записи), а содержимое хранится
+ * в атомарных словах.
+ */
+class TicketKeys {
+public:
+    /**
+     * @param lifetime Срок действия билета и ключа, секунд (0 - билеты выключены)
+     */
+    explicit TicketKeys(unsigned lifetime = 0);
+
+    TicketKeys(const TicketKeys &) = delete;
+    TicketKeys &operator=(const TicketKeys &) = delete;
+
+    /// Билеты выдаются и принимаются
+    bool enabled() const { return lifetime != 0; }
+
+    /**
+     * @brief Включает билеты с заданным сроком (до запуска потоков)
+     */
+    void setLifetime(unsigned seconds);
+
+    /**
+     * @brief Выпускает билет
+     * @param out Буфер не меньше TICKET_MAX байт
+     * @return Длина билета; 0 если билеты выключены или логин слишком длинный
+     */
+    size_t issue(std::string_view login, time_t now, uint8_t *out) const;
+
+    /**
+     * @brief Проверяет билет
+     * @param login [out] Логин из билета (ссылается на сам билет)
+     * @return true если код верен, ключ ещё действует и срок не истёк
+     */
+    bool verify(const uint8_t *ticket, size_t len, time_t now, std::string_view &login) const;
+
+private:
+    /// Ячейка ключа: номер и подготовленный ключ HMAC (16 слов по 32 бита)
+    struct Slot {
+        std::atomic<uint32_t> id{0};            ///< 0 - ячейка пуста или записывается
+        std::atomic<uint64_t> words[8];
+    };
+
+    void rotate(time_t now) const;
+    bool load(uint32_t id, HmacSha256Key &key) const;
+
+    // Ключи меняются по мере использования, поэтому изменяемы и у константного объекта
+    unsigned lifetime;
+    mutable Slot slots[2];                      ///< Ключ с номером id лежит в slots[id & 1]
+    mutable std::atomic<uint32_t> current{0};   ///< Номер текущего ключа
+    mutable std::atomic<int64_t> nextRotation{0};   ///< Время следующей смены ключа
+    mutable std::atomic<bool> rotating{false};  ///< Ключ сейчас меняется
+};
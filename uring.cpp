@@ -0,0 +1,380 @@
+/**
+ * @file uring.cpp
+ * @brief Реализация транспорта на io_uring
+ */
+
+#include "uring.hpp"
+#include "session.hpp"
+#include "server.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+using namespace std;
+
+/// Размер очереди отправки
+static const unsigned RING_ENTRIES = 4096;
+
+/// Тип операции хранится в младших битах user_data (указатели выровнены)
+enum : uint64_t { OP_ACCEPT = 0, OP_RECV = 1, OP_SEND = 2, OP_WAKE = 3, OP_TIMER = 4, OP_MASK = 7 };
+
+/**
+ * @brief Соединение, обслуживаемое через io_uring
+ */
+struct UringConn {
+    Session session;
+    bool recvBusy = false;          ///< Заявка recv в полёте
+    bool sendBusy = false;          ///< Заявка send в полёте
+    bool shut = false;              ///< Выполнен shutdown для прерывания заявок
+
+    UringConn(int sock, const ServerContext &ctx, int wakeFd, AuthBatch *auth) : session(sock, ctx, wakeFd, auth) {}
+};
+
+static_assert(alignof(UringConn) > OP_MASK, "тип операции не помещается в младшие биты указателя");
+
+static int uringSetup(unsigned entries, io_uring_params *p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int uringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+static int uringRegister(int fd, unsigned opcode, void *arg, unsigned nrArgs) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nrArgs);
+}
+
+UringLoop::UringLoop(int listenSock, const ServerContext &ctx)
+    : listenSock(listenSock), ctx(ctx) {
+}
+
+UringLoop::~UringLoop() {
+    if (timerFd >= 0) close(timerFd);
+    if (wakeFd >= 0) close(wakeFd);
+    if (sqes) munmap(sqes, sqesSize);
+    if (cqRing && cqRing != sqRing) munmap(cqRing, cqRingSize);
+    if (sqRing) munmap(sqRing, sqRingSize);
+    if (ringFd >= 0) close(ringFd);
+}
+
+bool UringLoop::supported() {
+    io_uring_params p = {};
+    int fd = uringSetup(8, &p);
+    if (fd < 0) return false;
+
+    size_t len = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+    io_uring_probe *probe = (io_uring_probe*)calloc(1, len);
+    bool ok = probe && uringRegister(fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (int op : {IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_READ}) {
+        ok = ok && op <= probe->last_op && (probe->ops[op].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    close(fd);
+    return ok;
+}
+
+/**
+ * @brief Создаёт кольцо и отображает SQ, CQ и массив SQE в память
+ */
+bool UringLoop::setup() {
+    io_uring_params p = {};
+#if defined(IORING_SETUP_COOP_TASKRUN) && defined(IORING_SETUP_SINGLE_ISSUER)
+    // Кольцом пользуется один поток: ядру не нужно прерывать его ради завершений
+    p.flags = IORING_SETUP_COOP_TASKRUN | IORING_SETUP_SINGLE_ISSUER;
+    ringFd = uringSetup(RING_ENTRIES, &p);
+    if (ringFd < 0 && errno == EINVAL) {
+        p = {};
+        ringFd = uringSetup(RING_ENTRIES, &p);
+    }
+#else
+    ringFd = uringSetup(RING_ENTRIES, &p);
+#endif
+    if (ringFd < 0) return false;
+
+    sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) sqRingSize = cqRingSize = max(sqRingSize, cqRingSize);
+
+    sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  ringFd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) { sqRing = nullptr; return false; }
+    if (single) {
+        cqRing = sqRing;
+    } else {
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) { cqRing = nullptr; return false; }
+    }
+    sqesSize = p.sq_entries * sizeof(io_uring_sqe);
+    void *s = mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ringFd, IORING_OFF_SQES);
+    if (s == MAP_FAILED) return false;
+    sqes = (io_uring_sqe*)s;
+
+    char *sq = (char*)sqRing;
+    sqHead = (unsigned*)(sq + p.sq_off.head);
+    sqTail = (unsigned*)(sq + p.sq_off.tail);
+    sqMask = (unsigned*)(sq + p.sq_off.ring_mask);
+    sqArray = (unsigned*)(sq + p.sq_off.array);
+    sqEntries = p.sq_entries;
+
+    char *cq = (char*)cqRing;
+    cqHead = (unsigned*)(cq + p.cq_off.head);
+    cqTail = (unsigned*)(cq + p.cq_off.tail);
+    cqMask = (unsigned*)(cq + p.cq_off.ring_mask);
+    cqes = (io_uring_cqe*)(cq + p.cq_off.cqes);
+    return true;
+}
+
+/**
+ * @brief Передаёт ядру накопленные заявки и ждёт waitNr завершений
+ * @return Результат io_uring_enter или -errno
+ */
+int UringLoop::submitAndWait(unsigned waitNr) {
+    int ret = uringEnter(ringFd, pending, waitNr, waitNr ? IORING_ENTER_GETEVENTS : 0);
+    if (ret < 0) return -errno;
+    pending -= min<unsigned>(pending, ret);
+    return ret;
+}
+
+/**
+ * @brief Выделяет обнулённую заявку в очереди отправки
+ *
+ * @details Без SQPOLL ядро читает очередь только внутри io_uring_enter
+ * этого же потока, поэтому хвост можно сдвинуть сразу, до заполнения SQE.
+ * Если очередь заполнена, накопленные заявки отправляются досрочно.
+ */
+io_uring_sqe *UringLoop::getSqe() {
+    unsigned tail = *sqTail;
+    if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) submitAndWait(0);
+
+    unsigned idx = tail & *sqMask;
+    io_uring_sqe *sqe = &sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[idx] = idx;
+    __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+    pending++;
+    return sqe;
+}
+
+void UringLoop::submitAccept() {
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenSock;
+    sqe->accept_flags = SOCK_CLOEXEC;
+#ifdef IORING_ACCEPT_MULTISHOT
+    if (multishotAccept) sqe->ioprio |= IORING_ACCEPT_MULTISHOT;
+#endif
+    sqe->user_data = OP_ACCEPT;
+}
+
+void UringLoop::submitRecv(UringConn *c) {
+    size_t room;
+    uint8_t *p = c->session.input().reserve(room, c->session.inputLimit());
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = c->session.fd();
+    sqe->addr = (uint64_t)(uintptr_t)p;
+    sqe->len = room;
+    sqe->user_data = (uint64_t)(uintptr_t)c | OP_RECV;
+    c->recvBusy = true;
+}
+
+void UringLoop::submitSend(UringConn *c) {
+    const char *data;
+    size_t len;
+    if (!c->session.nextOutput(data, len)) return;
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = c->session.fd();
+    sqe->addr = (uint64_t)(uintptr_t)data;
+    sqe->len = len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = (uint64_t)(uintptr_t)c | OP_SEND;
+    c->sendBusy = true;
+}
+
+void UringLoop::submitWakeRead() {
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeFd;
+    sqe->addr = (uint64_t)(uintptr_t)&wakeCount;
+    sqe->len = sizeof(wakeCount);
+    sqe->user_data = OP_WAKE;
+}
+
+void UringLoop::submitTimerRead() {
+    io_uring_sqe *sqe = getSqe();
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = timerFd;
+    sqe->addr = (uint64_t)(uintptr_t)&timerCount;
+    sqe->len = sizeof(timerCount);
+    sqe->user_data = OP_TIMER;
+}
+
+/**
+ * @brief Ставит следующие заявки соединения или закрывает его
+ */
+void UringLoop::advance(UringConn *c) {
+    Session &s = c->session;
+    if (!s.finished()) {
+        if (!c->sendBusy) submitSend(c);
+        if (!c->recvBusy && s.wantsInput()) submitRecv(c);
+        if (s.wantsWake() && find(computing.begin(), computing.end(), c) == computing.end())
+            computing.push_back(c);
+        if (s.wantsAuth() && find(authenticating.begin(), authenticating.end(), c) == authenticating.end())
+            authenticating.push_back(c);
+        if (!s.finished()) return;
+    }
+    if (!c->recvBusy && !c->sendBusy) {
+        if (!computing.empty())
+            computing.erase(remove(computing.begin(), computing.end(), c), computing.end());
+        if (!authenticating.empty())
+            authenticating.erase(remove(authenticating.begin(), authenticating.end(), c), authenticating.end());
+        conns.erase(c);
+        delete c;
+        return;
+    }
+    // Незавершённые заявки ещё ссылаются на буферы сессии: shutdown
+    // прерывает их, а удаление откладывается до их завершения
+    if (!c->shut) {
+        shutdown(s.fd(), SHUT_RDWR);
+        c->shut = true;
+    }
+}
+
+/**
+ * @brief Продвигает соединения, ждущие пула, после сигнала eventfd
+ */
+void UringLoop::resumeComputing() {
+    vector<UringConn*> waiting;
+    waiting.swap(computing);
+    for (UringConn *c : waiting) {
+        c->session.process();
+        advance(c);
+    }
+}
+
+/**
+ * @brief Проверяет пароли, собранные за итерацию, и продвигает эти соединения
+ */
+void UringLoop::checkLogins() {
+    auth.run(ctx.users);
+    vector<UringConn*> waiting;
+    waiting.swap(authenticating);
+    for (UringConn *c : waiting) {
+        c->session.process();
+        advance(c);
+    }
+}
+
+/**
+ * @brief Отмечает секунду простоя во всех соединениях и закрывает просроченные
+ */
+void UringLoop::expireIdle() {
+    // advance() удаляет соединения, поэтому сначала собираем просроченные
+    vector<UringConn*> idle;
+    for (UringConn *c : conns) {
+        if (!c->session.finished() && c->session.idleTick()) idle.push_back(c);
+    }
+    for (UringConn *c : idle) advance(c);
+}
+
+void UringLoop::handleCompletion(uint64_t userData, int res, uint32_t flags) {
+    uint64_t op = userData & OP_MASK;
+    if (op == OP_WAKE && !(userData & ~OP_MASK)) {
+        submitWakeRead();
+        resumeComputing();
+        return;
+    }
+    if (op == OP_TIMER) {
+        submitTimerRead();
+        expireIdle();
+        return;
+    }
+    if (op == OP_ACCEPT) {
+        if (res >= 0) {
+            UringConn *c = new UringConn(res, ctx, wakeFd, &auth);
+            conns.insert(c);
+            advance(c);
+        } else if (res == -EINVAL && multishotAccept) {
+            multishotAccept = false;
+        } else if (res == -EMFILE || res == -ENFILE) {
+            logMsg(LogLevel::Error, "Ошибка: исчерпан лимит дескрипторов");
+        }
+        if (!(flags & IORING_CQE_F_MORE)) submitAccept();
+        return;
+    }
+
+    UringConn *c = (UringConn*)(uintptr_t)(userData & ~OP_MASK);
+    Session &s = c->session;
+    if (op == OP_RECV) {
+        c->recvBusy = false;
+        if (res > 0) {
+            s.input().commit(res);
+            s.process();
+        } else if (res != -EINTR && res != -EAGAIN) {
+            s.readFailed(res == 0);
+        }
+    } else {
+        c->sendBusy = false;
+        if (res > 0) {
+            s.sent(res);
+        } else if (res != -EINTR && res != -EAGAIN) {
+            s.sendFailed();
+        }
+    }
+    advance(c);
+}
+
+bool UringLoop::open() {
+    wakeFd = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd < 0 || !setup()) {
+        perror("Ошибка io_uring");
+        return false;
+    }
+
+    if (ctx.idleTimeout) {
+        itimerspec tick = {{1, 0}, {1, 0}};
+        timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (timerFd < 0 || timerfd_settime(timerFd, 0, &tick, nullptr) < 0) {
+            perror("Ошибка таймера простоя");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UringLoop::run() {
+    submitAccept();
+    submitWakeRead();
+    if (timerFd >= 0) submitTimerRead();
+    while (true) {
+        int ret = submitAndWait(1);
+        if (ret < 0 && ret != -EINTR && ret != -EBUSY && ret != -EAGAIN) {
+            errno = -ret;
+            perror("Ошибка io_uring");
+            return false;
+        }
+
+        // Разбираем все готовые завершения; обработчики ставят новые
+        // заявки, которые уйдут ядру следующим io_uring_enter
+        unsigned head = *cqHead;
+        while (head != __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            io_uring_cqe cqe = cqes[head & *cqMask];
+            __atomic_store_n(cqHead, ++head, __ATOMIC_RELEASE);
+            handleCompletion(cqe.user_data, cqe.res, cqe.flags);
+        }
+        if (!authenticating.empty()) checkLogins();
+    }
+}
@@ -0,0 +1,106 @@
+/**
+ * @file uring.hpp
+ * @brief Транспорт на io_uring: приём соединений, чтение и запись пачками
+ */
+
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <unordered_set>
+#include <vector>
+#include "session.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct UringConn;
+
+/**
+ * @brief Цикл событий на io_uring, альтернатива реактору epoll
+ *
+ * @details Операции accept, recv и send ставятся в очередь отправки (SQ),
+ * и все накопленные за итерацию заявки передаются ядру одним вызовом
+ * io_uring_enter, который заодно ждёт завершений. Приём соединений
+ * выполняется многократной заявкой (multishot accept), если ядро её
+ * поддерживает. Протокол обслуживает тот же класс Session, что и в
+ * реакторе epoll; recv пишет прямо в приёмный буфер сессии. О готовых
+ * блоках параллельной редукции пул сообщает через eventfd, на котором
+ * всегда висит заявка read; так же читается секундный timerfd таймаута
+ * простоя. Пароли, пришедшие за одну итерацию, проверяются пачкой
+ * (AuthBatch) после разбора всех её завершений.
+ *
+ * Кольца создаются системными вызовами напрямую, без liburing.
+ */
+class UringLoop {
+public:
+    /**
+     * @param listenSock Слушающий сокет
+     * @param ctx Параметры сервера
+     */
+    UringLoop(int listenSock, const ServerContext &ctx);
+    ~UringLoop();
+
+    UringLoop(const UringLoop &) = delete;
+    UringLoop &operator=(const UringLoop &) = delete;
+
+    /**
+     * @brief Проверяет, что ядро поддерживает io_uring и нужные операции
+     */
+    static bool supported();
+
+    /**
+     * @brief Создаёт кольцо, eventfd пула и таймер простоя
+     * @return false если io_uring не запустился; слушающий сокет при этом
+     * не затронут и может перейти к реактору epoll
+     */
+    bool open();
+
+    /**
+     * @brief Запускает бесконечный цикл обработки завершений (после open())
+     * @return false при ошибке io_uring
+     */
+    bool run();
+
+private:
+    bool setup();
+    io_uring_sqe *getSqe();
+    int submitAndWait(unsigned waitNr);
+    void submitAccept();
+    void submitRecv(UringConn *c);
+    void submitSend(UringConn *c);
+    void submitWakeRead();
+    void submitTimerRead();
+    void resumeComputing();
+    void checkLogins();
+    void expireIdle();
+    void handleCompletion(uint64_t userData, int res, uint32_t flags);
+    void advance(UringConn *c);
+
+    int listenSock;
+    const ServerContext &ctx;
+
+    int ringFd = -1;
+    unsigned pending = 0;           ///< Заявки, записанные в SQ, но ещё не отправленные ядру
+    bool multishotAccept = true;
+
+    int wakeFd = -1;                ///< eventfd, который пул отмечает по готовности блоков
+    uint64_t wakeCount = 0;         ///< Буфер заявки read на wakeFd
+    std::vector<UringConn*> computing;  ///< Соединения, ждущие пула
+    AuthBatch auth;                 ///< Проверки пароля, собранные за итерацию
+    std::vector<UringConn*> authenticating; ///< Соединения, ждущие проверки пароля
+    int timerFd = -1;               ///< Секундный таймер простоя (-1 - таймаут выключен)
+    uint64_t timerCount = 0;        ///< Буфер заявки read на timerFd
+    std::unordered_set<UringConn*> conns;   ///< Все открытые соединения
+
+    // Отображённые в память кольца
+    void *sqRing = nullptr;
+    void *cqRing = nullptr;
+    size_t sqRingSize = 0;
+    size_t cqRingSize = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned sqEntries = 0;
+    unsigned *cqHead, *cqTail, *cqMask;
+    io_uring_cqe *cqes;
+};
@@ -0,0 +1,33 @@
+/**
+ * @file userdb.cpp
+ * @brief Компилятор базы пользователей: текст логин:пароль в двоичный образ
+ *
+ * @details Образ (см. UserStore::save()) сервер отображает в память при
+ * запуске вместо разбора текстового файла. Пример:
+ *     ./userdb users.txt users.db
+ *     ./server -d users.db
+ */
+
+#include <iostream>
+#include <string>
+#include "users.hpp"
+
+using namespace std;
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        cerr << "Использование: userdb <users.txt> <users.db>" << endl;
+        return 1;
+    }
+    UserStore users = loadUsers(argv[1]);
+    if (users.empty()) {
+        cerr << "Ошибка: в " << argv[1] << " нет пользователей" << endl;
+        return 1;
+    }
+    if (!users.save(argv[2])) {
+        cerr << "Ошибка записи " << argv[2] << endl;
+        return 1;
+    }
+    cout << "Пользователей: " << users.size() << ", образ: " << argv[2] << endl;
+    return 0;
+}
@@ -0,0 +1,392 @@
+/**
+ * @file users.cpp
+ * @brief Реализация базы пользователей
+ */
+
+#include "users.hpp"
+#include "sha256.hpp"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+/// Наименьший размер индекса
+static const size_t MIN_SLOTS = 16;
+
+/**
+ * @brief Заголовок двоичного образа базы
+ *
+ * @details За заголовком подряд лежат записи (count), индекс (slotCount
+ * ячеек uint32) и arena (arenaSize байт). Числа - в порядке байт узла.
+ */
+struct UserDbHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;         ///< Размер записи: защищает от образа другой сборки
+    uint64_t count;
+    uint64_t slotCount;
+    uint64_t arenaSize;
+    uint64_t reserved[3];
+};
+
+static_assert(sizeof(UserDbHeader) == 64, "заголовок образа должен занимать 64 байта");
+
+UserStore::UserStore(initializer_list<pair<string,string>> users) {
+    reserve(users.size());
+    for (const auto &[login, password] : users) add(login, password);
+}
+
+UserStore::~UserStore() {
+    unmap();
+}
+
+UserStore::UserStore(UserStore &&other) noexcept {
+    *this = move(other);
+}
+
+UserStore &UserStore::operator=(UserStore &&other) noexcept {
+    if (this == &other) return *this;
+    unmap();
+    arena = move(other.arena);
+    entries = move(other.entries);
+    slots = move(other.slots);
+    entryData = other.entryData;
+    slotData = other.slotData;
+    arenaData = other.arenaData;
+    count = other.count;
+    slotCount = other.slotCount;
+    arenaSize = other.arenaSize;
+    image = other.image;
+    imageSize = other.imageSize;
+    other.image = nullptr;
+    other.view();
+    if (!image) view();
+    return *this;
+}
+
+void UserStore::view() {
+    entryData = entries.data();
+    slotData = slots.data();
+    arenaData = arena.data();
+    count = entries.size();
+    slotCount = slots.size();
+    arenaSize = arena.size();
+}
+
+void UserStore::unmap() {
+    if (image) munmap(image, imageSize);
+    image = nullptr;
+    imageSize = 0;
+}
+
+uint64_t UserStore::hashLogin(string_view login) {
+    // FNV-1a и перемешивание: номер ячейки берётся из младших бит.
+    // Хэш записан в образ, поэтому менять его можно только с USERDB_VERSION
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : login) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+size_t UserStore::probe(string_view login, uint64_t hash) const {
+    size_t mask = slots.size() - 1;
+    for (size_t i = hash & mask; ; i = (i + 1) & mask) {
+        uint32_t slot = slots[i];
+        if (slot == 0) return i;
+        const Entry &e = entries[slot - 1];
+        if (e.hash == hash && string_view(arena.data() + e.loginOff, e.loginLen) == login) return i;
+    }
+}
+
+void UserStore::rehash(size_t capacity) {
+    slots.assign(capacity, 0);
+    size_t mask = capacity - 1;
+    for (size_t n = 0; n < entries.size(); n++) {
+        size_t i = entries[n].hash & mask;
+        while (slots[i]) i = (i + 1) & mask;
+        slots[i] = n + 1;
+    }
+}
+
+void UserStore::reserve(size_t n) {
+    if (image) return;
+    entries.reserve(n);
+    size_t capacity = MIN_SLOTS;
+    while (capacity < 2 * n) capacity *= 2;
+    if (capacity > slots.size()) rehash(capacity);
+    view();
+}
+
+bool UserStore::add(string_view login, string_view password) {
+    if (image) return false;
+    // Смещения в записях 32-битные
+    if (arena.size() + login.size() + password.size() > UINT32_MAX) return false;
+    if (slots.size() < 2 * (entries.size() + 1)) rehash(max(MIN_SLOTS, 2 * slots.size()));
+
+    uint64_t hash = hashLogin(login);
+    size_t i = probe(login, hash);
+    if (slots[i]) {
+        view();
+        return false;
+    }
+
+    Entry e;
+    e.hash = hash;
+    e.loginOff = arena.size();
+    e.loginLen = login.size();
+    arena.insert(arena.end(), login.begin(), login.end());
+    e.passOff = arena.size();
+    e.passLen = password.size();
+    arena.insert(arena.end(), password.begin(), password.end());
+    entries.push_back(e);
+    slots[i] = entries.size();
+    view();
+    return true;
+}
+
+bool UserStore::find(string_view login, string_view &password) const {
+    if (slotCount == 0) return false;
+    uint64_t hash = hashLogin(login);
+    size_t mask = slotCount - 1;
+    // Число проб ограничено: индекс из образа может быть заполнен целиком
+    for (size_t i = hash & mask, n = 0; n < slotCount; i = (i + 1) & mask, n++) {
+        uint32_t slot = slotData[i];
+        if (slot == 0 || slot > count) return false;
+        const Entry &e = entryData[slot - 1];
+        if (e.hash != hash) continue;
+        if ((uint64_t)e.loginOff + e.loginLen > arenaSize || (uint64_t)e.passOff + e.passLen > arenaSize) return false;
+        if (string_view(arenaData + e.loginOff, e.loginLen) != login) continue;
+        password = string_view(arenaData + e.passOff, e.passLen);
+        return true;
+    }
+    return false;
+}
+
+bool UserStore::save(const string &path) const {
+    UserDbHeader h = {};
+    memcpy(h.magic, USERDB_MAGIC, sizeof(h.magic));
+    h.version = USERDB_VERSION;
+    h.entrySize = sizeof(Entry);
+    h.count = count;
+    h.slotCount = slotCount;
+    h.arenaSize = arenaSize;
+
+    string tmp = path + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+              fwrite(entryData, sizeof(Entry), count, f) == count &&
+              fwrite(slotData, sizeof(uint32_t), slotCount, f) == slotCount &&
+              fwrite(arenaData, 1, arenaSize, f) == arenaSize;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+        unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool UserStore::open(const string &path) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    void *p = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(UserDbHeader))
+        p = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) return false;
+
+    // Проверяется только заголовок: размеры массивов должны точно составить файл
+    const UserDbHeader *h = static_cast<const UserDbHeader*>(p);
+    uint64_t size = st.st_size;
+    uint64_t body = size - sizeof(UserDbHeader);
+    bool ok = memcmp(h->magic, USERDB_MAGIC, sizeof(h->magic)) == 0 &&
+              h->version == USERDB_VERSION && h->entrySize == sizeof(Entry) &&
+              h->count <= body / sizeof(Entry) && h->slotCount <= body / sizeof(uint32_t) &&
+              h->slotCount >= MIN_SLOTS && (h->slotCount & (h->slotCount - 1)) == 0 &&
+              h->count < h->slotCount && h->count < UINT32_MAX &&
+              h->count * sizeof(Entry) + h->slotCount * sizeof(uint32_t) + h->arenaSize == body;
+    if (!ok) {
+        munmap(p, st.st_size);
+        return false;
+    }
+
+    unmap();
+    arena.clear();
+    entries.clear();
+    slots.clear();
+    image = p;
+    imageSize = st.st_size;
+    const char *base = static_cast<const char*>(p) + sizeof(UserDbHeader);
+    entryData = reinterpret_cast<const Entry*>(base);
+    slotData = reinterpret_cast<const uint32_t*>(base + h->count * sizeof(Entry));
+    arenaData = base + h->count * sizeof(Entry) + h->slotCount * sizeof(uint32_t);
+    count = h->count;
+    slotCount = h->slotCount;
+    arenaSize = h->arenaSize;
+    return true;
+}
+
+UserRegistry::UserRegistry() : current(new UserStore()) {
+    readers[0] = 0;
+    readers[1] = 0;
+}
+
+UserRegistry::~UserRegistry() {
+    delete current.load();
+}
+
+UserRegistry::Reader UserRegistry::read() const {
+    atomic<uint64_t> *counter = &readers[epoch.load() & 1];
+    counter->fetch_add(1);
+    // Последовательная согласованность: увеличение счётчика упорядочено
+    // с заменой указателя и проверкой счётчика в publish()
+    return Reader(counter, current.load());
+}
+
+void UserRegistry::publish(UserStore fresh) {
+    const UserStore *old = current.exchange(new UserStore(move(fresh)));
+    // Читатель мог прочитать эпоху до любого из сдвигов: ждём обе чётности
+    for (int round = 0; round < 2; round++) {
+        uint64_t e = epoch.fetch_add(1);
+        while (readers[e & 1].load() != 0) this_thread::sleep_for(chrono::microseconds(100));
+    }
+    delete old;
+}
+
+UserStore loadUsers(const string &file) {
+    UserStore users;
+    ifstream f(file, ios::binary);
+    char magic[sizeof(USERDB_MAGIC)] = {};
+    f.read(magic, sizeof(magic));
+    if (f.gcount() == sizeof(magic) && memcmp(magic, USERDB_MAGIC, sizeof(magic)) == 0) {
+        users.open(file);
+        return users;
+    }
+
+    f.clear();
+    f.seekg(0);
+    string line;
+    while (getline(f, line)) {
+        size_t p = line.find(':');
+        if (p != string::npos)
+            users.add(string_view(line).substr(0, p), string_view(line).substr(p + 1));
+    }
+    return users;
+}
+
+/**
+ * @brief Сравнивает дайджест с хэшем клиента
+ * @param hash 64 шестнадцатеричные цифры (заглавные) или, если binary,
+ * 32 байта дайджеста
+ */
+static bool digestMatches(const uint8_t digest[32], string_view hash, bool binary) {
+    if (binary) return constantTimeEqual(digest, (const uint8_t*)hash.data(), AUTH_DIGEST_SIZE);
+    static const char HEX[] = "0123456789ABCDEF";
+    uint8_t hex[64];
+    for (int i = 0; i < 32; i++) {
+        hex[i*2] = HEX[digest[i] >> 4];
+        hex[i*2+1] = HEX[digest[i] & 15];
+    }
+    return constantTimeEqual(hex, (const uint8_t*)hash.data(), 64);
+}
+
+size_t authFrameSize(const uint8_t *prefix) {
+    if (prefix[0] != AUTH_BINARY || prefix[2] == 0) return 0;
+    if (prefix[1] == AUTH_VERSION) return AUTH_BINARY_PREFIX + prefix[2] + AUTH_SALT_SIZE + AUTH_DIGEST_SIZE;
+    if (prefix[1] == AUTH_TICKET) return AUTH_BINARY_PREFIX + prefix[2];
+    return 0;
+}
+
+AuthRequest parseAuthFrame(const uint8_t *frame) {
+    size_t loginLen = frame[2];
+    const char *p = (const char*)frame + AUTH_BINARY_PREFIX;
+    AuthRequest r;
+    r.login = string_view(p, loginLen);
+    r.salt = string_view(p + loginLen, AUTH_SALT_SIZE);
+    r.hash = string_view(p + loginLen + AUTH_SALT_SIZE, AUTH_DIGEST_SIZE);
+    r.binary = true;
+    return r;
+}
+
+/**
+ * @brief SHA-256(соль + пароль) потоковым API, без склейки в строку
+ */
+static void saltedDigest(string_view salt, string_view password, uint8_t digest[32]) {
+    Sha256Context ctx;
+    sha256Init(ctx);
+    sha256Update(ctx, (const uint8_t*)salt.data(), salt.size());
+    sha256Update(ctx, (const uint8_t*)password.data(), password.size());
+    sha256Final(ctx, digest);
+}
+
+bool checkAuth(const string &login, const string &salt, const string &hash,
+               const UserStore &users) {
+    string_view p;
+    if (!users.find(login, p)) return false;
+    if (hash.size() != 64) return false;
+    uint8_t digest[32];
+    saltedDigest(salt, p, digest);
+    return digestMatches(digest, hash, false);
+}
+
+void checkAuthBatch(AuthRequest *const requests[], size_t count, const UserStore &users) {
+    // Многобуферному хэшу нужно каждое сообщение целиком: соль и пароль
+    // копируются в буфер на стеке, куча не используется
+    uint8_t arena[AUTH_BATCH_MAX][AUTH_MESSAGE_MAX];
+    for (size_t start = 0; start < count; start += AUTH_BATCH_MAX) {
+        size_t end = min(count, start + AUTH_BATCH_MAX);
+        AuthRequest *found[AUTH_BATCH_MAX];
+        string_view passwords[AUTH_BATCH_MAX];
+        size_t n = 0;
+        for (size_t i = start; i < end; i++) {
+            AuthRequest &r = *requests[i];
+            string_view p;
+            r.accepted = false;
+            if (!users.find(r.login, p) || r.hash.size() != (r.binary ? AUTH_DIGEST_SIZE : 64)) continue;
+            if (r.salt.size() + p.size() > AUTH_MESSAGE_MAX) {
+                // Не помещается в буфер пачки: хэшируется отдельно
+                uint8_t digest[32];
+                saltedDigest(r.salt, p, digest);
+                r.accepted = digestMatches(digest, r.hash, r.binary);
+                continue;
+            }
+            found[n] = &r;
+            passwords[n] = p;
+            n++;
+        }
+
+        // Один запрос (обычный вход не в пачке) - потоковым хэшем, без копирования
+        if (n == 1) {
+            uint8_t digest[32];
+            saltedDigest(found[0]->salt, passwords[0], digest);
+            found[0]->accepted = digestMatches(digest, found[0]->hash, found[0]->binary);
+            continue;
+        }
+
+        const uint8_t *data[AUTH_BATCH_MAX];
+        size_t lengths[AUTH_BATCH_MAX];
+        for (size_t i = 0; i < n; i++) {
+            memcpy(arena[i], found[i]->salt.data(), found[i]->salt.size());
+            memcpy(arena[i] + found[i]->salt.size(), passwords[i].data(), passwords[i].size());
+            data[i] = arena[i];
+            lengths[i] = found[i]->salt.size() + passwords[i].size();
+        }
+        uint8_t digests[AUTH_BATCH_MAX][32];
+        sha256Many(data, lengths, n, digests);
+        for (size_t i = 0; i < n; i++) found[i]->accepted = digestMatches(digests[i], found[i]->hash, found[i]->binary);
+    }
+}
@@ -0,0 +1,283 @@
+/**
+ * @file users.hpp
+ * @brief База пользователей с хэш-индексом по логину
+ */
+
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/// Сигнатура двоичного образа базы пользователей
+const char USERDB_MAGIC[8] = {'V', 'C', 'U', 'S', 'E', 'R', 'D', 'B'};
+
+/// Версия формата двоичного образа
+const uint32_t USERDB_VERSION = 1;
+
+/**
+ * @brief Пользователи и их пароли с поиском по логину за O(1)
+ *
+ * @details Логины и пароли лежат подряд в одном массиве arena, записи
+ * ссылаются на него смещениями. Индекс - таблица с открытой адресацией
+ * и линейным пробированием: номер записи + 1 (0 - пустая ячейка),
+ * таблица не меньше чем вдвое больше числа записей. В записи хранится
+ * хэш логина, так что строки сравниваются только при совпадении хэшей.
+ * Поиск не выделяет памяти.
+ *
+ * Если логин повторяется, действует первая запись, как и при прежнем
+ * линейном поиске по файлу.
+ *
+ * Те же три массива - записи, индекс и arena - составляют двоичный
+ * образ базы (save()), поэтому open() только отображает файл в память
+ * и проверяет заголовок: запуск не зависит от числа пользователей,
+ * а страницы образа общие для всех процессов, открывших файл. Смещения
+ * из образа проверяются при каждом поиске.
+ */
+class UserStore {
+public:
+    UserStore() = default;
+    ~UserStore();
+
+    /// База из пар (логин, пароль)
+    UserStore(std::initializer_list<std::pair<std::string,std::string>> users);
+
+    UserStore(UserStore &&other) noexcept;
+    UserStore &operator=(UserStore &&other) noexcept;
+    UserStore(const UserStore &) = delete;
+    UserStore &operator=(const UserStore &) = delete;
+
+    /**
+     * @brief Добавляет пользователя
+     * @return false если логин уже есть (запись не меняется) или база
+     * отображена из образа
+     */
+    bool add(std::string_view login, std::string_view password);
+
+    /**
+     * @brief Ищет пароль пользователя
+     * @param password [out] Пароль; действителен, пока база не меняется
+     * @return true если пользователь найден
+     */
+    bool find(std::string_view login, std::string_view &password) const;
+
+    /// Число пользователей
+    size_t size() const { return count; }
+
+    bool empty() const { return count == 0; }
+
+    /// База отображена из двоичного образа
+    bool mapped() const { return image != nullptr; }
+
+    /// Резервирует место под count пользователей
+    void reserve(size_t count);
+
+    /**
+     * @brief Записывает двоичный образ базы
+     *
+     * @details Образ пишется во временный файл рядом и переименовывается,
+     * так что читатели видят либо прежний файл, либо новый целиком.
+     * @return false при ошибке записи
+     */
+    bool save(const std::string &path) const;
+
+    /**
+     * @brief Отображает двоичный образ только для чтения
+     *
+     * @details Отображённый образ нельзя менять на месте: обращение
+     * к страницам укороченного файла завершает процесс по SIGBUS. Новый
+     * образ подменяется переименованием, как это делает save().
+     * @return false если файл не открывается или не является образом
+     */
+    bool open(const std::string &path);
+
+private:
+    struct Entry {
+        uint64_t hash;
+        uint32_t loginOff, loginLen;
+        uint32_t passOff, passLen;
+    };
+
+    static uint64_t hashLogin(std::string_view login);
+    size_t probe(std::string_view login, uint64_t hash) const;
+    void rehash(size_t capacity);
+    void view();
+    void unmap();
+
+    std::vector<char> arena;        ///< Логины и пароли подряд
+    std::vector<Entry> entries;     ///< Записи в порядке добавления
+    std::vector<uint32_t> slots;    ///< Индекс: номер записи + 1 (размер - степень двойки)
+
+    // Поиск идёт по этим указателям: на векторы выше или на отображённый образ
+    const Entry *entryData = nullptr;
+    const uint32_t *slotData = nullptr;
+    const char *arenaData = nullptr;
+    size_t count = 0;
+    size_t slotCount = 0;
+    size_t arenaSize = 0;
+
+    void *image = nullptr;          ///< Отображённый образ (nullptr - база в векторах)
+    size_t imageSize = 0;
+};
+
+/**
+ * @brief Текущая база пользователей с заменой на лету
+ *
+ * @details Сессии читают базу через read(): два атомарных счётчика и
+ * загрузка указателя, без блокировок и ожидания. Новая база строится
+ * вне горячего пути и публикуется publish() заменой указателя, как в RCU:
+ * читатель видит либо прежнюю базу, либо новую целиком. Прежняя
+ * удаляется после периода ожидания - когда все читатели, которые могли
+ * её получить, закончили.
+ *
+ * Читатели отмечаются в одном из двух счётчиков по чётности эпохи.
+ * Публикующий сначала заменяет указатель, затем дважды сдвигает эпоху
+ * и ждёт, пока счётчик прежней чётности обнулится. Читатель, вошедший
+ * после проверки своего счётчика, уже видит новый указатель, а новые
+ * читатели не мешают обнулению: они отмечаются в другом счётчике.
+ */
+class UserRegistry {
+public:
+    UserRegistry();
+    ~UserRegistry();
+
+    UserRegistry(const UserRegistry &) = delete;
+    UserRegistry &operator=(const UserRegistry &) = delete;
+
+    /**
+     * @brief Доступ читателя: база не удаляется, пока он существует
+     */
+    class Reader {
+    public:
+        ~Reader() { counter->fetch_sub(1); }
+
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+        const UserStore &operator*() const { return *store; }
+        const UserStore *operator->() const { return store; }
+
+    private:
+        friend class UserRegistry;
+        Reader(std::atomic<uint64_t> *counter, const UserStore *store) : counter(counter), store(store) {}
+
+        std::atomic<uint64_t> *counter;
+        const UserStore *store;
+    };
+
+    /// Текущая база (держать недолго: публикация ждёт всех читателей)
+    Reader read() const;
+
+    /**
+     * @brief Делает fresh текущей базой и удаляет прежнюю
+     *
+     * @details Возвращается после периода ожидания. Вызывается из одного
+     * потока (загрузка при запуске, затем поток перезагрузки).
+     */
+    void publish(UserStore fresh);
+
+private:
+    std::atomic<const UserStore*> current;
+    mutable std::atomic<uint64_t> epoch{0};
+    mutable std::atomic<uint64_t> readers[2];   ///< Читатели по чётности эпохи входа
+};
+
+/**
+ * @brief Загружает базу пользователей
+ *
+ * @details Двоичный образ (файл начинается с USERDB_MAGIC) отображается
+ * в память, иначе файл читается как текст: строки вида логин:пароль.
+ * @param file Путь к файлу базы
+ */
+UserStore loadUsers(const std::string &file);
+
+/**
+ * @brief Проверяет хэш SHA-256(соль + пароль) для указанного пользователя
+ * @return true если пользователь найден и хэш совпадает
+ */
+bool checkAuth(const std::string &login, const std::string &salt, const std::string &hash,
+               const UserStore &users);
+
+/**
+ * @brief Запрос проверки пароля для checkAuthBatch()
+ */
+struct AuthRequest {
+    std::string_view login;
+    std::string_view salt;
+    std::string_view hash;      ///< 64 шестнадцатеричные цифры или 32 байта дайджеста (binary)
+    bool binary = false;        ///< Двоичное рукопожатие: hash - сам дайджест
+    bool accepted = false;      ///< [out] Пользователь найден и хэш совпадает
+};
+
+/// Первый байт двоичного рукопожатия: текстовое сообщение с нуля не начинается
+const uint8_t AUTH_BINARY = 0;
+
+/// Версия двоичного рукопожатия (вход по паролю)
+const uint8_t AUTH_VERSION = 2;
+
+/// Вместо версии: двоичное рукопожатие с билетом возобновления (tickets.hpp)
+const uint8_t AUTH_TICKET = 3;
+
+/// Начало двоичного рукопожатия: признак, версия и длина логина
+const size_t AUTH_BINARY_PREFIX = 3;
+
+/// Длина соли в двоичном рукопожатии
+const size_t AUTH_SALT_SIZE = 8;
+
+/// Длина дайджеста SHA-256
+const size_t AUTH_DIGEST_SIZE = 32;
+
+/// Наибольшая длина двоичного рукопожатия
+const size_t AUTH_BINARY_MAX = AUTH_BINARY_PREFIX + 255 + AUTH_SALT_SIZE + AUTH_DIGEST_SIZE;
+
+/**
+ * @brief Длина двоичного рукопожатия по его началу
+ *
+ * @details Двоичное рукопожатие (протокол v2) заменяет текстовые форматы
+ * логин:соль:хэш без разбора и шестнадцатеричной записи:
+ *
+ *     uint8 0 | uint8 version (2) | uint8 loginLen | login | salt[8] | digest[32]
+ *
+ * digest - SHA-256(salt + пароль) от восьми байт соли как есть. Сервер
+ * отвечает "OK" или "ERR", как и на текстовые форматы. Возобновление
+ * сессии по билету, полученному в прошлой сессии:
+ *
+ *     uint8 0 | uint8 AUTH_TICKET (3) | uint8 ticketLen | ticket
+ *
+ * @param prefix AUTH_BINARY_PREFIX первых байт
+ * @return Длина всего кадра или 0, если версия не поддерживается, логин
+ * или билет пусты
+ */
+size_t authFrameSize(const uint8_t *prefix);
+
+/**
+ * @brief Запрос проверки из двоичного рукопожатия
+ *
+ * @details Логин, соль и дайджест ссылаются на сам кадр, ничего не копируется.
+ * @param frame Кадр AUTH_VERSION длиной authFrameSize()
+ */
+AuthRequest parseAuthFrame(const uint8_t *frame);
+
+/// Наибольшее число хэшей, которые checkAuthBatch() считает за один вызов sha256Many()
+const size_t AUTH_BATCH_MAX = 16;
+
+/// Наибольшая длина соли и пароля вместе, которую checkAuthBatch() хэширует пачкой
+const size_t AUTH_MESSAGE_MAX = 128;
+
+/**
+ * @brief Проверяет пачку запросов аутентификации
+ *
+ * @details То же, что checkAuth() для каждого запроса (и для двоичного
+ * рукопожатия - сравнение с дайджестом как есть), но хэши
+ * SHA-256(соль + пароль) найденных пользователей считаются вместе,
+ * многобуферной реализацией (sha256Many()), по AUTH_BATCH_MAX за раз.
+ * Так массовое переподключение клиентов проверяется быстрее, чем по
+ * одному. Сообщения пачки собираются в буфере на стеке; одиночный запрос
+ * и соль с паролем длиннее AUTH_MESSAGE_MAX хэшируются потоковым API,
+ * как в checkAuth(). Память в куче не выделяется.
+ */
+void checkAuthBatch(AuthRequest *const requests[], size_t count, const UserStore &users);